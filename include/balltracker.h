@@ -0,0 +1,258 @@
+/// @file balltracker.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Constant velocity Kalman filter tracking the ball relative to the robot.
+/// State is (bearing, distance, bearing rate, distance rate). Predicted every
+/// control cycle with the odometry motion since the last cycle, corrected by
+/// camera (or laser) detections which are gated by their Mahalanobis distance.
+///
+#ifndef BALLTRACKER_H
+#define BALLTRACKER_H
+
+#include <cmath>
+
+class BallTracker {
+public:
+  /// @param qBearing Bearing acceleration noise in rad/s^2
+  /// @param qDist Distance acceleration noise in m/s^2
+  /// @param rBearing Bearing measurement standard deviation in rad
+  /// @param rDist Distance measurement standard deviation in m
+  /// @param gateThres Squared Mahalanobis distance accepted by the gate,
+  /// default is the 99% quantile of chi-square with 2 degrees of freedom
+  BallTracker(double qBearing = 0.5, double qDist = 0.5,
+              double rBearing = 0.05, double rDist = 0.3,
+              double gateThres = 9.21)
+    : qB(qBearing*qBearing), qD(qDist*qDist),
+      rB(rBearing*rBearing), rD(rDist*rDist), gateT(gateThres)
+  {
+    reset();
+  }
+
+  /// Forget the ball.
+  void reset ( void )
+  {
+    isValid = false;
+    for (int i=0; i<N; i++) {
+      x[i] = 0.;
+      for (int j=0; j<N; j++) P[i][j] = 0.;
+    }
+  }
+
+  /// True as soon a detection has initialized the filter.
+  bool valid ( void ) const { return isValid; }
+
+  /// Propagate the estimate.
+  /// @param dt Time since the last prediction in seconds
+  /// @param dx Robot forward motion since the last prediction in meters
+  /// @param dy Robot left motion since the last prediction in meters
+  /// @param dyaw Robot rotation since the last prediction in radians
+  /// (All given in the robot frame of the last prediction.)
+  void predict ( double dt, double dx, double dy, double dyaw )
+  {
+    if (!isValid) return;
+
+    // Ego motion: move the ball into the new robot frame
+    const double cb = cos(x[B]), sb = sin(x[B]);
+    const double px = x[D]*cb - dx;
+    const double py = x[D]*sb - dy;
+    const double cy = cos(dyaw), sy = sin(dyaw);
+    const double qx =  cy*px + sy*py;
+    const double qy = -sy*px + cy*py;
+    double d2 = qx*qx + qy*qy;
+    if (d2 < 1e-6) d2 = 1e-6; // Ball under the robot, keep the Jacobian finite
+    const double d = sqrt(d2);
+
+    // Jacobian of the ego motion w.r.t. (bearing, distance)
+    // dq/db = R(-dyaw) * (-d*sin b, d*cos b), dq/dd = R(-dyaw) * (cos b, sin b)
+    const double qbx =  cy*(-x[D]*sb) + sy*(x[D]*cb);
+    const double qby = -sy*(-x[D]*sb) + cy*(x[D]*cb);
+    const double qdx =  cy*cb + sy*sb;
+    const double qdy = -sy*cb + cy*sb;
+    double F[N][N] = {{0.}};
+    F[B][B] = (-qy*qbx + qx*qby)/d2;
+    F[B][D] = (-qy*qdx + qx*qdy)/d2;
+    F[D][B] = ( qx*qbx + qy*qby)/d;
+    F[D][D] = ( qx*qdx + qy*qdy)/d;
+    F[VB][VB] = 1.;
+    F[VD][VD] = 1.;
+    // Constant velocity
+    F[B][VB] = dt;
+    F[D][VD] = dt;
+
+    x[B] = normalize(atan2(qy, qx) + x[VB]*dt);
+    x[D] = d + x[VD]*dt;
+    if (x[D] < 0.) x[D] = 0.;
+
+    // P = F P F' + Q
+    double FP[N][N];
+    for (int i=0; i<N; i++)
+      for (int j=0; j<N; j++) {
+        FP[i][j] = 0.;
+        for (int k=0; k<N; k++) FP[i][j] += F[i][k]*P[k][j];
+      }
+    for (int i=0; i<N; i++)
+      for (int j=0; j<N; j++) {
+        P[i][j] = 0.;
+        for (int k=0; k<N; k++) P[i][j] += FP[i][k]*F[j][k];
+      }
+    // White acceleration noise per axis
+    const double dt2 = dt*dt, dt3 = dt2*dt;
+    P[B][B]   += qB*dt3/3.; P[B][VB]  += qB*dt2/2.;
+    P[VB][B]  += qB*dt2/2.; P[VB][VB] += qB*dt;
+    P[D][D]   += qD*dt3/3.; P[D][VD]  += qD*dt2/2.;
+    P[VD][D]  += qD*dt2/2.; P[VD][VD] += qD*dt;
+  }
+
+  /// Squared Mahalanobis distance of a detection to the prediction.
+  double gate ( double bearing, double dist ) const
+  {
+    if (!isValid) return 0.;
+    double S[2][2], Si[2][2];
+    innovationCov(S);
+    if (!invert(S, Si)) return HUGE_VAL;
+    const double yb = normalize(bearing - x[B]);
+    const double yd = dist - x[D];
+    return yb*(Si[0][0]*yb + Si[0][1]*yd) + yd*(Si[1][0]*yb + Si[1][1]*yd);
+  }
+
+  /// Choose the target among the candidates of one detection.
+  /// Before initialization the most confident candidate is taken, afterwards
+  /// the gated one of highest likelihood, i.e. the smallest Mahalanobis
+  /// distance penalized by low confidence.
+  /// @param num Number of candidates
+  /// @param bearing,dist,conf Candidate bearings, distances and confidences
+  /// @return Index of the target, -1 if there is none.
+  int associate ( int num, const double * bearing, const double * dist,
+                  const double * conf ) const
+  {
+    int best = -1;
+    double bestCost = HUGE_VAL;
+    for (int i=0; i<num; i++) {
+      if (conf[i] <= 0.) continue;
+      double cost = -2.*log(conf[i]);
+      if (isValid) {
+        const double g = gate(bearing[i], dist[i]);
+        if (g > gateT) continue;
+        cost += g;
+      }
+      if (cost < bestCost) {
+        bestCost = cost;
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  /// Correct the estimate by a detection.
+  /// The first detection initializes the filter.
+  /// @return False if the detection was rejected by the gate.
+  bool update ( double bearing, double dist )
+  {
+    return update(bearing, dist, sqrt(rB), sqrt(rD));
+  }
+
+  /// Correct the estimate by a detection of another sensor.
+  /// @param rBearing Bearing measurement standard deviation in rad
+  /// @param rDist Distance measurement standard deviation in m
+  /// @return False if the detection was rejected by the gate.
+  bool update ( double bearing, double dist, double rBearing, double rDist )
+  {
+    if (!isValid) {
+      init(bearing, dist);
+      return true;
+    }
+    if (gate(bearing, dist) > gateT) return false;
+
+    double S[2][2], Si[2][2], K[N][2];
+    innovationCov(S);
+    S[0][0] += rBearing*rBearing - rB;
+    S[1][1] += rDist*rDist - rD;
+    if (!invert(S, Si)) return false;
+    // K = P H' S^-1, H selects bearing and distance
+    for (int i=0; i<N; i++) {
+      K[i][0] = P[i][B]*Si[0][0] + P[i][D]*Si[1][0];
+      K[i][1] = P[i][B]*Si[0][1] + P[i][D]*Si[1][1];
+    }
+    const double yb = normalize(bearing - x[B]);
+    const double yd = dist - x[D];
+    for (int i=0; i<N; i++) x[i] += K[i][0]*yb + K[i][1]*yd;
+    x[B] = normalize(x[B]);
+    if (x[D] < 0.) x[D] = 0.;
+    // P = (I - K H) P
+    double HP[2][N];
+    for (int j=0; j<N; j++) { HP[0][j] = P[B][j]; HP[1][j] = P[D][j]; }
+    for (int i=0; i<N; i++)
+      for (int j=0; j<N; j++)
+        P[i][j] -= K[i][0]*HP[0][j] + K[i][1]*HP[1][j];
+    return true;
+  }
+
+  /// Estimated bearing in radians, CCW positive, [-M_PI, M_PI]
+  double bearing ( void ) const { return x[B]; }
+  /// Estimated distance in meters
+  double dist ( void ) const { return x[D]; }
+  /// Estimated bearing rate in rad/s
+  double bearingRate ( void ) const { return x[VB]; }
+  /// Estimated distance rate in m/s
+  double distRate ( void ) const { return x[VD]; }
+  /// Bearing variance in rad^2
+  double bearingVar ( void ) const { return P[B][B]; }
+  /// Distance variance in m^2
+  double distVar ( void ) const { return P[D][D]; }
+  /// Full state covariance, index order bearing, distance, bearing rate,
+  /// distance rate.
+  double covariance ( int i, int j ) const { return P[i][j]; }
+  /// The gate's threshold on the squared Mahalanobis distance
+  double gateThreshold ( void ) const { return gateT; }
+
+private:
+  enum { B = 0, D, VB, VD, N };
+  double x[N];    ///< State
+  double P[N][N]; ///< State covariance
+  double qB, qD;  ///< Process noise spectral densities
+  double rB, rD;  ///< Measurement variances
+  double gateT;   ///< Gate threshold
+  bool   isValid;
+
+  void init ( double bearing, double dist )
+  {
+    reset();
+    x[B] = normalize(bearing);
+    x[D] = dist;
+    P[B][B] = rB;
+    P[D][D] = rD;
+    P[VB][VB] = 1.;  // Unknown rates, a ball rolls up to ~1 rad/s or m/s
+    P[VD][VD] = 1.;
+    isValid = true;
+  }
+
+  void innovationCov ( double S[2][2] ) const
+  {
+    S[0][0] = P[B][B] + rB; S[0][1] = P[B][D];
+    S[1][0] = P[D][B];      S[1][1] = P[D][D] + rD;
+  }
+
+  static bool invert ( const double S[2][2], double Si[2][2] )
+  {
+    const double det = S[0][0]*S[1][1] - S[0][1]*S[1][0];
+    if (fabs(det) < 1e-12) return false;
+    Si[0][0] =  S[1][1]/det; Si[0][1] = -S[0][1]/det;
+    Si[1][0] = -S[1][0]/det; Si[1][1] =  S[0][0]/det;
+    return true;
+  }
+
+  static double normalize ( double a )
+  {
+    while (a >  M_PI) a -= 2*M_PI;
+    while (a < -M_PI) a += 2*M_PI;
+    return a;
+  }
+};
+
+#endif
@@ -0,0 +1,64 @@
+/// @file blobball.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Ball measurement from the blobs of a (simulated) blobfinder camera.
+/// The bearing follows from the blob's column in the image, the range from its
+/// apparent width with a pinhole model. Stage additionally reports the range
+/// of each blob, which is taken instead when available.
+///
+#ifndef BLOBBALL_H
+#define BLOBBALL_H
+
+#include <cmath>
+
+class BlobBall {
+public:
+  /// @param fov Horizontal field of view in radians
+  /// @param size Ball diameter in meters
+  BlobBall(double fov, double size) : fov(fov), size(size) {}
+
+  /// Convert one blob.
+  /// @param width Image width in pixels
+  /// @param x Blob center column
+  /// @param left,right Blob bounding box columns
+  /// @param top,bottom Blob bounding box rows
+  /// @param area Blob area in pixels
+  /// @param range Range reported by the blobfinder in meters, 0 if none
+  /// @param bearing Bearing in radians, positive to the left
+  /// @param dist Distance in meters
+  /// @param conf Confidence 0..1, the fill ratio of the bounding box
+  /// @return False if the blob is degenerate
+  bool measure ( int width, int x, int left, int right, int top, int bottom,
+                 int area, double range,
+                 double * bearing, double * dist, double * conf ) const
+  {
+    const int w = right - left + 1;
+    const int h = bottom - top + 1;
+    if (width <= 0 || w <= 0 || h <= 0) return false;
+    // Focal length in pixels
+    const double f = (width/2.) / tan(fov/2.);
+    *bearing = atan2(width/2. - (x + 0.5), f); // Pixel center
+    if (range > 0.) {
+      *dist = range;
+    } else {
+      // Angular width of the blob: the view rays are tangent to the ball
+      const double a = atan2(right + 1 - width/2., f) - atan2(left - width/2., f);
+      *dist = size/2. / sin(a/2.);
+    }
+    *conf = (double)area / (w*h);
+    if (*conf > 1.) *conf = 1.;
+    return true;
+  }
+
+private:
+  double fov;  ///< Horizontal field of view in radians
+  double size; ///< Ball diameter in meters
+};
+
+#endif
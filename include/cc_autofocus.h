@@ -0,0 +1,201 @@
+#ifndef _CC_AUTOFOCUS_H_
+#define _CC_AUTOFOCUS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cc_framesource.h"
+#include "cc_sharpness.h"
+
+typedef enum
+{
+  AF_off=0,
+  AF_global, // interval search over the whole (or a local) focus range
+  AF_locIni, // search done, take the reference sharpness
+  AF_local // focused, watch for a sharpness drop
+} focusModeTy;
+
+typedef enum
+{
+  low=0,
+  mid,
+  high
+} focusITy;
+
+typedef struct
+{
+  int val; // focus value of the probe
+  uint64_t sum; // sharpness measured at val
+} focusTy;
+
+#define FOCUS_MIN 0
+#define FOCUS_MAX 447
+
+// Contrast based autofocus. Three probes low/mid/high at 1/4, 1/2 and 3/4 of
+// the interval are measured, the interval is halved around the sharpest one,
+// which stays a probe, so each further step costs two frames. Once the
+// interval is narrower than minRange the focus is set to the vertex of the
+// parabola through the last three probes. Afterwards a drop of the sharpness
+// below dropRatio of the reference restarts a search in the local range.
+class AutoFocus
+{
+  public:
+    AutoFocus() : focusCnt(0),focusMode(AF_off),settleLeft(0),current(0) {}
+
+    // settle: frames to skip after each focus change while the lens moves
+    // Returns the focus value to set first
+    int Init(int lo,int hi,int minRange=32,int settle=0,double dropRatio=0.5)
+    {
+      rangeLo=lo;
+      rangeHi=hi;
+      this->minRange=minRange;
+      this->settle=settle;
+      this->dropRatio=dropRatio;
+      return Search(lo,hi);
+    }
+
+    // Feed the sharpness of the frame taken at the focus returned last time,
+    // returns the focus to set for the next frame
+    int Step(uint64_t sharpness)
+    {
+      int i;
+      focusCnt++;
+      if (settleLeft>0)
+      {
+        settleLeft--;
+        return current;
+      }
+      switch (focusMode)
+      {
+        case AF_global:
+          focus[focusI].sum=sharpness;
+          measured[focusI]=true;
+          for (i=low;i<=high;i++)
+            if (!measured[i]) return Probe((focusITy)i);
+          Narrow();
+          return current;
+        case AF_locIni:
+          reference=sharpness;
+          focusMode=AF_local;
+          return current;
+        case AF_local:
+          if (sharpness>reference) reference=sharpness;
+          else if (sharpness<dropRatio*reference)
+          {
+            int r=(rangeHi-rangeLo)/8;
+            printf("-I- AF: on     - local\n");
+            return Search(current-r<rangeLo ? rangeLo : current-r,
+                current+r>rangeHi ? rangeHi : current+r);
+          }
+          return current;
+        default:
+          return current;
+      }
+    }
+
+    // Measure the frame in src and move its focus
+    int Update(FrameSource &src,const SharpnessMeter &meter)
+    {
+      int last=current;
+      int next=Step(meter.Measure(src.captureBuf));
+      if (next!=last) src.setFocus(next);
+      return next;
+    }
+
+    void Off() { focusMode=AF_off; }
+    focusModeTy Mode() const { return focusMode; }
+    // Focus value currently set
+    int Focus() const { return current; }
+    // Frames since the last search started
+    unsigned int Frames() const { return focusCnt; }
+
+  private:
+    focusTy focus[3];
+    bool measured[3];
+    unsigned int focusCnt;
+    focusModeTy focusMode;
+    focusITy focusI;
+    int focusLo,focusHi; // current search interval
+    int rangeLo,rangeHi; // focus range of the lens
+    int minRange;
+    int settle,settleLeft;
+    double dropRatio;
+    uint64_t reference; // sharpness when focused
+    int current;
+
+    int Search(int lo,int hi)
+    {
+      int focRange=hi-lo+1;
+      focusCnt=0;
+      focusMode=AF_global;
+      focusLo=lo;
+      focusHi=hi;
+      focus[low].val=lo+focRange/4;
+      focus[mid].val=lo+focRange/2;
+      focus[high].val=lo+focRange*3/4;
+      measured[low]=measured[mid]=measured[high]=false;
+      return Probe(mid);
+    }
+
+    int Probe(focusITy i)
+    {
+      focusI=i;
+      if (current!=focus[i].val || focusCnt==0) settleLeft=settle;
+      current=focus[i].val;
+      return current;
+    }
+
+    // All probes measured: halve the interval around the best one
+    void Narrow()
+    {
+      focusITy best=mid;
+      if (focus[low].sum>focus[best].sum) best=low;
+      if (focus[high].sum>focus[best].sum) best=high;
+
+      if (focus[high].val-focus[low].val<minRange)
+      {
+        Vertex(best);
+        return;
+      }
+      focusTy keep=focus[best];
+      if (best==low) focusHi=focus[mid].val;
+      else if (best==high) focusLo=focus[mid].val;
+      else
+      {
+        focusLo=focus[low].val;
+        focusHi=focus[high].val;
+      }
+      focus[mid]=keep;
+      focus[low].val=(focusLo+keep.val)/2;
+      focus[high].val=(keep.val+focusHi)/2;
+      measured[mid]=true;
+      measured[low]=measured[high]=false;
+      Probe(low);
+    }
+
+    // Interpolate the peak through the three probes
+    void Vertex(focusITy best)
+    {
+      double x0=focus[low].val,x1=focus[mid].val,x2=focus[high].val;
+      double y0=focus[low].sum,y1=focus[mid].sum,y2=focus[high].sum;
+      double d=(x0-x1)*(x0-x2)*(x1-x2);
+      double a=0.,b=0.;
+      int v=focus[best].val;
+      if (d!=0.)
+      {
+        a=(x2*(y1-y0)+x1*(y0-y2)+x0*(y2-y1))/d;
+        b=(x2*x2*(y0-y1)+x1*x1*(y2-y0)+x0*x0*(y1-y2))/d;
+      }
+      if (a<0) // a maximum
+      {
+        v=(int)(-b/(2*a)+0.5);
+        if (v<focus[low].val) v=focus[low].val;
+        if (v>focus[high].val) v=focus[high].val;
+      }
+      focusMode=AF_locIni;
+      if (v!=current) settleLeft=settle;
+      current=v;
+      printf("-I- AF: focused at %d after %u frames\n",current,focusCnt);
+    }
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <cv.h>
 #include <highgui.h>
 #include "ml.h"
+#include "cc_polarmap.h"
 
 #ifdef _IMAGE_TRANS
 #include "cc_imageclient.h"
@@ -16,22 +17,45 @@
 
 const double cc_pi=3.14159265;
 
+#define BALL_BATCH 8 // capacity of a detection batch
+
+// All ball candidates of a frame, sorted by descending confidence
 struct Ball
 {
   int num;
-  double* dist;
-  double* angle;
+  double dist[BALL_BATCH];
+  double angle[BALL_BATCH];
+  double conf[BALL_BATCH]; // detection confidence, 0..1
+};
+
+// Processing stages of DetectBall, used to index BallFinder::stageTime
+enum
+{
+  BF_CONVERT=0, // YUV422 to BGR to HSV
+  BF_THRESHOLD, // HSV color range
+  BF_SMOOTH, // median filter
+  BF_CONTOURS, // contour search
+  BF_HOUGH, // per blob hough transform and candidate check
+  BF_DISTANCE, // bearing and SVM distance of the batch
+  BF_STAGES
 };
 
 class BallFinder
 {
   public:
-    int Init(int width,int height)
+    // display: show the detection result in a window, disable for offline
+    // benchmarking without a X server
+    // panoWidth: width of the unwarped panorama made of each frame (see
+    // Panorama), 0 disables it
+    int Init(int width,int height,bool display=true,int panoWidth=0)
     {
-      lm=lp=0;
+      this->display=display;
+      ResetTiming();
 
       cx=705;
       cy=490;
+      inner_radius=95;
+      outer_radius=460;
       min_radius=3;
       this->width=width;
       this->height=height;
@@ -41,60 +65,58 @@ class BallFinder
       hsv=cvCreateImage(cvGetSize(srcImage),8,3);
       imageCircles=cvCreateImage(cvGetSize(srcImage),8,3);
       imageBlobs=cvCreateImage(cvGetSize(srcImage),8,1);
-      cvNamedWindow("openCVwindow",CV_WINDOW_AUTOSIZE);
+      polar.Init(width,height,cx,cy,inner_radius,outer_radius,panoWidth);
+      panoImage=NULL;
+      if (polar.HasPanorama()) panoImage=cvCreateImage(cvSize(polar.PanoWidth(),polar.PanoHeight()),8,3);
+      if (display) cvNamedWindow("openCVwindow",CV_WINDOW_AUTOSIZE);
 #ifdef _DEBUG
       cvNamedWindow("DEBUG1",CV_WINDOW_AUTOSIZE);
 #endif
 #ifdef _IMAGE_TRANS
       ic.Init();
 #endif
-      test_data=cvCreateMat(1,2,CV_32FC1);
+      test_data=cvCreateMat(BALL_BATCH,2,CV_32FC1);
       mysvm.load("./include/learning.svm");
       return 0;
     }
 
+    // Returns every candidate passing the checks, the batch is valid until
+    // the next call. Blobs with a hough circle are preferred over plain
+    // square blobs, both weighted by how square the blob is.
     Ball* DetectBall(unsigned char *img)
     {
       CvSeq* contour;
       CvMemStorage* storBlob=cvCreateMemStorage(0);
       CvRect rect;
-      Ball* bs;
-      int i,j;
-      int bx,by,br;
-      int mx,my,mr,ms,tx,ty;
-      double angle;
+      CvMat row;
+      Ball* bs=&batch;
+      int i;
+      int tx,ty,tr;
+      double square;
+      int64 tick=cvGetTickCount();
 
       YUV422toBGR(img,srcImage);
       cvCvtColor(srcImage,hsv,CV_BGR2HSV);
+      if (panoImage!=NULL) polar.Unwarp(srcImage,panoImage);
+      StageTick(BF_CONVERT,tick);
       cvInRangeS(hsv,cvScalar(140,140,30,0),cvScalar(171,256,256,0),fltImage);
+      StageTick(BF_THRESHOLD,tick);
 #ifdef _DEBUG
       cvShowImage("DEBUG1",fltImage);
 #endif
       cvSmooth(fltImage,smImage,CV_MEDIAN,3,3);
 //      cvSmooth(fltImage,smImage,CV_MEDIAN,9,9);
+      StageTick(BF_SMOOTH,tick);
       cvFindContours(smImage,storBlob,&contour,sizeof(CvContour),CV_RETR_EXTERNAL,CV_CHAIN_APPROX_SIMPLE);
+      StageTick(BF_CONTOURS,tick);
 
-      bx=by=br=0;
-      mx=my=mr=0;
-      ms=64;
+      bs->num=0;
 
       for(;contour!=0;contour=contour->h_next)
       {
         rect=((CvContour*)contour)->rect;
         if (rect.width<min_radius||rect.height<min_radius) continue;
-        if (abs(rect.width-rect.height)<3 && rect.width*rect.height>ms)
-        {
-          tx=rect.x+rect.width/2;
-          ty=rect.y+rect.height/2;
-          if (CircleInRange(tx,ty))
-          {
-            mx=tx;
-            my=ty;
-            ms=rect.width*rect.height;
-            mr=rect.width;
-            if (rect.height<mr) mr=rect.height;
-          }
-        }
+        square=1.-(double)abs(rect.width-rect.height)/(rect.width>rect.height?rect.width:rect.height);
         // create an image with only this segment
         cvZero(imageBlobs);
         cvDrawContours(imageBlobs,contour,CV_RGB(255,255,255),CV_RGB(255,255,255),-1,CV_FILLED,8);
@@ -103,52 +125,49 @@ class BallFinder
         // if a circle was found
         if (0<circles->total)
         {
-          // keep only the largest circle
+          // the strongest circle of this blob
           float* p=(float*)cvGetSeqElem(circles,0);
-          if (p[2]>br)
-          {
-            bx=p[0];
-            by=p[1];
-            br=p[2];
-          }
+          if (CircleInRange(p[0],p[1]) && p[2]>0)
+            AddCandidate(p[0],p[1],p[2],0.5+0.5*square);
         }
-        // draw this segment onto the output image with a random color
-      }
-      if (!CircleInRange(bx,by)) bx=by=br=0;
-      // Ball tracks recording
-      if (br>0)
-        BallTrackRecord(bx,by);
-      else
-      {
-        // Lost ball judge
-        bx=mx;
-        by=my;
-        br=mr;
-        j=0;
-        if (lm>=10)
+        // no circle, fall back to the blob if it is square enough. Whether it
+        // is the ball seen before is judged by the tracker's gate.
+        else if (abs(rect.width-rect.height)<3 && rect.width*rect.height>64)
         {
-          for (i=0;i<10;i++) j+=(bx-lx[i])*(bx-lx[i])+(by-ly[i])*(by-ly[i]);
-          //printf("\nCompare error=%d\n",j);
-          if (j>2000000) bx=by=br=0;
-          else j=0; // ok, here is just for convinient
+          tx=rect.x+rect.width/2;
+          ty=rect.y+rect.height/2;
+          tr=rect.width;
+          if (rect.height<tr) tr=rect.height;
+          if (CircleInRange(tx,ty)) AddCandidate(tx,ty,tr,0.5*square);
         }
-        if (j==0) BallTrackRecord(bx,by);
       }
+      StageTick(BF_HOUGH,tick);
 
-      bs=new Ball;
-      if (br>0)
+      // Fill the SVM features of the whole batch, then predict row by row
+      for (i=0;i<bs->num;i++)
       {
-        bs->num=1;
-        bs->dist=new double[bs->num];
-        bs->angle=new double[bs->num];
+        double r=polar.Radius(candX[i],candY[i]);
+        fptr_data=(float *)(test_data->data.ptr+i*test_data->step);
+        *fptr_data=r*r;
+        *(fptr_data+1)=candR[i];
+        bs->angle[i]=polar.Bearing(candX[i],candY[i]);
+      }
+      for (i=0;i<bs->num;i++)
+      {
+        cvGetRow(test_data,&row,i);
+        bs->dist[i]=mysvm.predict(&row);
+        //bs->dist[i]=((by-cy)*(by-cy)+(bx-cx)*(bx-cx))*0.00075;
+      }
 
+      if (bs->num>0)
+      {
 //        cvCircle(srcImage,cvPoint(cx,cy),90,CV_RGB(0,255,255),1); // Inner circle
 //        cvCircle(srcImage,cvPoint(cx,cy),470,CV_RGB(0,255,255),1); // Outer circle
 #ifdef _IMAGE_TRANS
         IplImage *transImg=cvCreateImage(cvSize(320,240),8,3);;
         int mx,my;
-        mx=bx-160;
-        my=by-120;
+        mx=candX[0]-160;
+        my=candY[0]-120;
         if (mx<0) mx=0;
         if (my<0) my=0;
         if (mx+320>=srcImage->width) mx=srcImage->width-320;
@@ -159,25 +178,34 @@ class BallFinder
         ic.sendimage(transImg->imageData,320*240);
         cvReleaseImage(&transImg);
 #endif
-        cvCircle(srcImage,cvPoint(bx,by),br,CV_RGB(255,0,0),3);
-        cvLine(srcImage,cvPoint(cx,cy),cvPoint(bx,by),CV_RGB(255,0,0),3);
-        angle=atan2(bx-cx,cy-by);
+      }
+      if (display)
+      {
+        for (i=0;i<bs->num;i++)
+        {
+          cvCircle(srcImage,cvPoint(candX[i],candY[i]),candR[i],CV_RGB(255,0,0),i==0?3:1);
+          cvLine(srcImage,cvPoint(cx,cy),cvPoint(candX[i],candY[i]),CV_RGB(255,0,0),i==0?3:1);
+        }
         //cvEllipse(srcImage,cvPoint(cx,cy),cvSize(20,20),angle/pi*360,270,270-angle/pi*360,CV_RGB(255,0,0),2);
-
-        bs->angle[0]=angle;
-
-        fptr_data=(float *)(test_data->data.ptr+0*test_data->step);
-        *fptr_data=(bx-cx)*(bx-cx)+(by-cy)*(by-cy);
-        *(fptr_data+1)=br;
-        bs->dist[0]=mysvm.predict(test_data);
-        //bs->dist[0]=((by-cy)*(by-cy)+(bx-cx)*(bx-cx))*0.00075;
       }
-      else bs->num=0;
-      cvShowImage("openCVwindow",srcImage);
+      StageTick(BF_DISTANCE,tick);
+      frames++;
+      if (display) cvShowImage("openCVwindow",srcImage);
       cvReleaseMemStorage(&storBlob);
       return bs;
     }
 
+    // Accumulated processing time per stage in ms since the last reset
+    double stageTime[BF_STAGES];
+    // Number of frames processed since the last reset
+    unsigned int frames;
+
+    void ResetTiming()
+    {
+      for (int i=0;i<BF_STAGES;i++) stageTime[i]=0.;
+      frames=0;
+    }
+
     int Over()
     {
 #ifdef _DEBUG
@@ -186,19 +214,36 @@ class BallFinder
 #ifdef _IMAGE_TRANS
       ic.Over();
 #endif
-      cvDestroyWindow("openCVwindow");
+      if (display) cvDestroyWindow("openCVwindow");
       cvReleaseImage(&fltImage);
       cvReleaseImage(&smImage);
       cvReleaseImage(&hsv);
       cvReleaseImage(&imageCircles);
       cvReleaseImage(&srcImage);
       cvReleaseImage(&imageBlobs);
+      if (panoImage!=NULL) cvReleaseImage(&panoImage);
+      polar.Over();
 
       cvReleaseMat(&test_data);
 
       return 0;
     }
 
+    // The unwarped panorama of the last frame (BGR), NULL if disabled
+    const IplImage* Panorama() const { return panoImage; }
+
+    // Polar lookup of the omni-image
+    const PolarMap& Polar() const { return polar; }
+
+    // The omni-image center and the mirror annulus balls are searched in
+    void Annulus(int *cx,int *cy,int *rmin,int *rmax) const
+    {
+      *cx=this->cx;
+      *cy=this->cy;
+      *rmin=inner_radius;
+      *rmax=outer_radius;
+    }
+
     bool IsContinue()
     {
       if (cvWaitKey(10)==1048603) return false;
@@ -214,40 +259,63 @@ class BallFinder
 #endif
     int width;
     int height;
+    bool display; // show the result window
     IplImage *srcImage;
     IplImage* fltImage;
     IplImage* smImage;
     IplImage* hsv;
     IplImage* imageCircles;
     IplImage* imageBlobs;
+    IplImage* panoImage; // unwarped panorama, NULL if disabled
+    PolarMap polar; // bearing/radius lookup and panorama remap
 
     int cx; // the x center of omni-image
     int cy; // the y center of omni-image
+    int inner_radius; // the mirror's inner border in the omni-image
+    int outer_radius; // the mirror's outer border in the omni-image
     int min_radius; // the ball smaller than this size will be ignored
 
-    int lx[10],ly[10]; // trace of the ball in last 10 points
-    int lp; // pointer to current overwrite position in *lx
-    int lm; // point num in *lx
+    Ball batch; // result of the last DetectBall
+    int candX[BALL_BATCH],candY[BALL_BATCH],candR[BALL_BATCH]; // batch in image coordinates
 
-    CvMat *test_data; // SVM Test data set
+    CvMat *test_data; // SVM Test data set, one row per candidate
     float *fptr_data; // SVM data pointer
     CvSVM mysvm; // SVM needed
 
-    void BallTrackRecord(int x,int y)
+    // Insert a candidate into the batch sorted by confidence, larger balls
+    // first on equal confidence. The weakest one drops out of a full batch.
+    void AddCandidate(int x,int y,int r,double conf)
+    {
+      int i=batch.num;
+      if (i==BALL_BATCH)
+      {
+        if (conf<batch.conf[i-1] || (conf==batch.conf[i-1] && r<=candR[i-1])) return;
+        i--;
+      }
+      else batch.num++;
+      for (;i>0 && (batch.conf[i-1]<conf || (batch.conf[i-1]==conf && candR[i-1]<r));i--)
+      {
+        batch.conf[i]=batch.conf[i-1];
+        candX[i]=candX[i-1];
+        candY[i]=candY[i-1];
+        candR[i]=candR[i-1];
+      }
+      batch.conf[i]=conf;
+      candX[i]=x;
+      candY[i]=y;
+      candR[i]=r;
+    }
+
+    void StageTick(int stage,int64 &tick)
     {
-      lx[lp]=x;
-      ly[lp]=y;
-      lp++;
-      if (lp>9) lp=0;
-      lm++;
-      if (lm>10) lp=10;
+      int64 t=cvGetTickCount();
+      stageTime[stage]+=(t-tick)/(cvGetTickFrequency()*1000.);
+      tick=t;
     }
 
     bool CircleInRange(int x,int y)
     {
-      int r=(x-cx)*(x-cx)+(y-cy)*(y-cy);
-      if (r>95*95 && r<460*460) return true;
-      return false;
+      return polar.InAnnulus(x,y);
     }
 
     void YUV422toBGR(unsigned char *src,IplImage *img)
@@ -3,34 +3,12 @@
 
 #include <libraw1394/raw1394.h>
 #include <libdc1394/dc1394_control.h>
+#include "cc_framesource.h"
+#include "cc_autofocus.h"
 
-typedef enum
-{
-  AF_off=0,
-  AF_global,
-  AF_locIni,
-  AF_local
-} focusModeTy;
-
-typedef enum
-{
-  low=0,
-  mid,
-  high
-} focusITy;
-
-typedef struct
-{
-  int val,sum;
-} focusTy;
-
-#define FOCUS_MIN 0
-#define FOCUS_MAX 447
-
-class Single1394
+class Single1394 : public FrameSource
 {
   public:
-    unsigned char* captureBuf;
     int initCam(int width,int height)
     {
       int fwNodeNum,fwCamNum;
@@ -111,23 +89,34 @@ class Single1394
       return 1;
     }
 
+    // Start the autofocus, sharpness is measured in the central half of the
+    // frame. The search runs along with the following captureImage calls.
     void initFocus()
     {
-      int focRange;
-      printf("-I- AF: on     - global");
-      focusCnt=0;
-      focusMode=AF_global;
-      focusI=low;
-      focusLo=FOCUS_MIN;
-      focusHi=FOCUS_MAX;
-      focRange=focusHi-focusLo+1;
-      focus[low].val=focRange/4;
-      focus[mid].val=focRange/2;
-      focus[high].val=focRange*3/4;
-      dc1394_set_focus(fwHandle, fwCamera.node, focus[high].val); // now the focus is set to MID
-      printf("\n");
+      focusMeter.InitRect(width,height,width/4,height/4,width*3/4,height*3/4,2);
+      startFocus();
+    }
+
+    // Start the autofocus measuring the mirror annulus
+    void initFocus(int cx,int cy,int rmin,int rmax)
+    {
+      focusMeter.InitAnnulus(width,height,cx,cy,rmin,rmax);
+      startFocus();
     }
 
+    // Measure the sharpness in a rectangle only, e.g. around the ball
+    void focusRoi(int x0,int y0,int x1,int y1)
+    {
+      focusMeter.InitRect(width,height,x0,y0,x1,y1);
+    }
+
+    int setFocus(int value)
+    {
+      return dc1394_set_focus(fwHandle,fwCamera.node,value)==DC1394_SUCCESS;
+    }
+
+    focusModeTy focusMode() const { return autoFocus.Mode(); }
+
     void cleanup()
     {
       free(captureBuf);
@@ -142,7 +131,9 @@ class Single1394
     {
       dc1394_dma_single_capture(&fwCamera);
       dc1394_dma_done_with_buffer(&fwCamera);
+      captureTime=now();
       memcpy(captureBuf,fwCamera.capture_buffer,imagelen);
+      if (autoFocus.Mode()!=AF_off) autoFocus.Update(*this,focusMeter);
       return 1;
     }
 
@@ -150,15 +141,15 @@ class Single1394
     raw1394handle_t fwHandle;
     dc1394_cameracapture fwCamera;
 
-    focusTy focus[3];
-    unsigned int focusCnt;
-    focusModeTy focusMode;
-    focusITy focusI;
-    int focusLo,focusHi;
+    AutoFocus autoFocus;
+    SharpnessMeter focusMeter; // autofocus region of interest
 
-    int width;
-    int height;
-    int imagelen;
+    void startFocus()
+    {
+      printf("-I- AF: on     - global\n");
+      // One frame for the lens to move, the DMA buffer holds the next one
+      setFocus(autoFocus.Init(FOCUS_MIN,FOCUS_MAX,32,1));
+    }
 };
 
 #endif
@@ -0,0 +1,78 @@
+#ifndef _CC_CHANGEDETECTOR_H_
+#define _CC_CHANGEDETECTOR_H_
+
+#include <stdlib.h>
+#include <vector>
+
+// Cheap scene change test on raw YUV422 frames (byte order V Y U Y).
+// Only the Y bytes of a subsampled grid inside the mirror annulus are
+// compared, the result of a full detection can be reused as long as no
+// sample changed by more than diffThres in at least minChanged samples.
+class ChangeDetector
+{
+  public:
+    // step: sample grid spacing in pixels
+    // diffThres: absolute Y difference counted as a changed sample
+    // minChanged: changed samples needed to report a scene change, should stay
+    // below the samples covered by the smallest ball (min_radius^2/step^2)
+    int Init(int width,int height,int cx,int cy,int rmin,int rmax,
+        int step=4,int diffThres=24,int minChanged=4)
+    {
+      int i,j,r;
+      this->diffThres=diffThres;
+      this->minChanged=minChanged;
+      offset.clear();
+      for (i=cy-rmax;i<=cy+rmax;i+=step)
+      {
+        if (i<0 || i>=height) continue;
+        for (j=cx-rmax;j<=cx+rmax;j+=step)
+        {
+          if (j<0 || j>=width) continue;
+          r=(j-cx)*(j-cx)+(i-cy)*(i-cy);
+          if (r<=rmin*rmin || r>=rmax*rmax) continue;
+          offset.push_back((i*width+j)*2+1); // Y byte of pixel (j,i)
+        }
+      }
+      ref.assign(offset.size(),0);
+      valid=false;
+      return offset.size();
+    }
+
+    // Compare img against the reference frame.
+    // Returns the number of changed samples, the image becomes the new
+    // reference if it is reported as changed (see Changed).
+    int Diff(const unsigned char *img) const
+    {
+      int n=0;
+      const int *o=&offset[0];
+      const unsigned char *r=&ref[0];
+      const int len=offset.size();
+      for (int i=0;i<len;i++)
+        if (abs((int)img[o[i]]-(int)r[i])>diffThres) n++;
+      return n;
+    }
+
+    // True if img differs from the reference, img is stored as the new
+    // reference then. The first frame after Init or Reset is always changed.
+    bool Changed(const unsigned char *img)
+    {
+      if (valid && Diff(img)<minChanged) return false;
+      for (unsigned int i=0;i<offset.size();i++) ref[i]=img[offset[i]];
+      valid=true;
+      return true;
+    }
+
+    // Force the next frame to be reported as changed
+    void Reset() { valid=false; }
+
+    int Samples() const { return offset.size(); }
+
+  private:
+    std::vector<int> offset; // byte offsets of the sampled Y values
+    std::vector<unsigned char> ref; // Y samples of the reference frame
+    int diffThres;
+    int minChanged;
+    bool valid; // ref holds a frame
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef _CC_FRAMEARCHIVE_H_
+#define _CC_FRAMEARCHIVE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include "cc_framesource.h"
+
+// Raw frame archive layout (host byte order):
+//   FrameArchiveHeader
+//   frameCount packed YUV422 frames of frameSize bytes each
+//   frameCount FrameArchiveIndex entries starting at indexOffset
+// The header is rewritten with the final count and index position on close,
+// so a recording which was not closed properly has frameCount==0.
+
+#define FRAMEARCHIVE_MAGIC "CCFRAME1"
+
+struct FrameArchiveHeader
+{
+  char magic[8];
+  uint32_t width;
+  uint32_t height;
+  uint32_t frameSize; // bytes per frame, width*height*2 for YUV422
+  uint32_t frameCount;
+  uint64_t indexOffset; // file offset of the first index entry
+};
+
+struct FrameArchiveIndex
+{
+  uint64_t offset; // file offset of the frame
+  double stamp; // capture time in seconds
+};
+
+// Writes captured frames into an archive
+class FrameRecorder
+{
+  public:
+    FrameRecorder() : fd(NULL) {}
+    ~FrameRecorder() { close(); }
+
+    int open(const char *path,int width,int height)
+    {
+      memset(&header,0,sizeof(header));
+      memcpy(header.magic,FRAMEARCHIVE_MAGIC,sizeof(header.magic));
+      header.width=width;
+      header.height=height;
+      header.frameSize=width*height*2;
+      index.clear();
+      if ((fd=fopen(path,"wb"))==NULL)
+      {
+        printf("-E- unable to create frame archive %s\n",path);
+        return 0;
+      }
+      // Placeholder, completed on close
+      if (fwrite(&header,sizeof(header),1,fd)!=1) return fail();
+      offset=sizeof(header);
+      return 1;
+    }
+
+    int write(const unsigned char *frame,double stamp)
+    {
+      FrameArchiveIndex entry;
+      if (fd==NULL) return 0;
+      if (fwrite(frame,header.frameSize,1,fd)!=1) return fail();
+      entry.offset=offset;
+      entry.stamp=stamp;
+      index.push_back(entry);
+      offset+=header.frameSize;
+      return 1;
+    }
+
+    int write(const FrameSource &src)
+    {
+      return write(src.captureBuf,src.captureTime);
+    }
+
+    int close()
+    {
+      if (fd==NULL) return 0;
+      header.frameCount=index.size();
+      header.indexOffset=offset;
+      if (!index.empty() && fwrite(&index[0],sizeof(FrameArchiveIndex),index.size(),fd)!=index.size()) return fail();
+      if (fseek(fd,0,SEEK_SET)!=0 || fwrite(&header,sizeof(header),1,fd)!=1) return fail();
+      fclose(fd);
+      fd=NULL;
+      return 1;
+    }
+
+    unsigned int count() const { return index.size(); }
+
+  private:
+    FILE *fd;
+    FrameArchiveHeader header;
+    std::vector<FrameArchiveIndex> index;
+    uint64_t offset;
+
+    int fail()
+    {
+      printf("-E- writing frame archive failed\n");
+      fclose(fd);
+      fd=NULL;
+      return 0;
+    }
+};
+
+// Replays an archive through the FrameSource interface. The file is mapped
+// into memory and captureBuf points straight into the mapping, so no frame is
+// copied. The mapping is private, writes into captureBuf never reach the file.
+class FrameArchive : public FrameSource
+{
+  public:
+    FrameArchive() : base(NULL),mapLen(0),current(0),loop(false) {}
+    ~FrameArchive() { cleanup(); }
+
+    int open(const char *path,bool loop=false)
+    {
+      int fd;
+      struct stat st;
+
+      this->loop=loop;
+      if ((fd=::open(path,O_RDONLY))<0)
+      {
+        printf("-E- unable to open frame archive %s\n",path);
+        return 0;
+      }
+      if (fstat(fd,&st)<0 || (size_t)st.st_size<sizeof(FrameArchiveHeader))
+      {
+        printf("-E- frame archive %s is truncated\n",path);
+        ::close(fd);
+        return 0;
+      }
+      mapLen=st.st_size;
+      base=(unsigned char *)mmap(NULL,mapLen,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+      ::close(fd);
+      if (base==MAP_FAILED)
+      {
+        printf("-E- unable to map frame archive %s\n",path);
+        base=NULL;
+        return 0;
+      }
+      header=(const FrameArchiveHeader *)base;
+      if (memcmp(header->magic,FRAMEARCHIVE_MAGIC,sizeof(header->magic))!=0 ||
+          header->frameSize!=header->width*header->height*2 ||
+          header->indexOffset+(uint64_t)header->frameCount*sizeof(FrameArchiveIndex)>mapLen)
+      {
+        printf("-E- %s is not a valid frame archive\n",path);
+        cleanup();
+        return 0;
+      }
+      index=(const FrameArchiveIndex *)(base+header->indexOffset);
+      width=header->width;
+      height=header->height;
+      imagelen=header->frameSize;
+      current=0;
+      madvise(base,mapLen,MADV_SEQUENTIAL);
+      return 1;
+    }
+
+    int captureImage()
+    {
+      if (base==NULL) return 0;
+      if (current>=header->frameCount)
+      {
+        if (!loop || header->frameCount==0) return 0;
+        current=0;
+      }
+      captureBuf=base+index[current].offset;
+      captureTime=index[current].stamp;
+      current++;
+      return 1;
+    }
+
+    void cleanup()
+    {
+      if (base!=NULL) munmap(base,mapLen);
+      base=NULL;
+      captureBuf=NULL;
+      mapLen=0;
+    }
+
+    // Jump to frame i, the next captureImage() returns it
+    void seek(unsigned int i) { current=i; }
+    unsigned int frameCount() const { return base ? header->frameCount : 0; }
+    // Number of the frame currently in captureBuf
+    unsigned int frameNum() const { return current-1; }
+
+  private:
+    unsigned char *base;
+    size_t mapLen;
+    const FrameArchiveHeader *header;
+    const FrameArchiveIndex *index;
+    unsigned int current;
+    bool loop;
+};
+
+#endif
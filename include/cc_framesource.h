@@ -0,0 +1,42 @@
+#ifndef _CC_FRAMESOURCE_H_
+#define _CC_FRAMESOURCE_H_
+
+#include <stddef.h>
+#include <sys/time.h>
+
+// Abstract source of packed YUV422 frames (byte order V Y U Y) as delivered
+// by the 1394 camera. BallFinder::DetectBall only needs captureBuf, so a live
+// camera and a recorded archive can be used interchangeably.
+class FrameSource
+{
+  public:
+    unsigned char* captureBuf; // the last captured frame
+    double captureTime; // time stamp of the last captured frame in seconds
+
+    FrameSource() : captureBuf(NULL),captureTime(0.),width(0),height(0),imagelen(0) {}
+    virtual ~FrameSource() {}
+
+    // Grab the next frame into captureBuf, returns 0 on failure or end of data
+    virtual int captureImage()=0;
+    virtual void cleanup()=0;
+    // Move the lens focus, returns 0 if the source has no focus control
+    virtual int setFocus(int value) { (void)value; return 0; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getImageLen() const { return imagelen; }
+
+  protected:
+    int width;
+    int height;
+    int imagelen;
+
+    static double now()
+    {
+      timeval t;
+      gettimeofday(&t,0);
+      return t.tv_sec+t.tv_usec/1e6;
+    }
+};
+
+#endif
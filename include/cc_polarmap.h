@@ -0,0 +1,137 @@
+#ifndef _CC_POLARMAP_H_
+#define _CC_POLARMAP_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <cxcore.h>
+#include <cv.h>
+
+#define POLAR_PI 3.14159265358979
+#define POLAR_BEARING_SCALE (32767./POLAR_PI) // int16 steps per radian
+#define POLAR_RADIUS_SCALE 16. // uint16 steps per pixel
+
+// Init time polar lookup of the omni-image annulus.
+// Bearing and radial distance of every pixel in the annulus' bounding box are
+// stored quantized, so the per detection geometry is a table read. Optionally
+// a remap into an unwarped panorama is precomputed as well: one column per
+// bearing step (first column looks to the image top, i.e. robot front),
+// one row per radial step from the outer border (top) to the inner one.
+class PolarMap
+{
+  public:
+    PolarMap() : mapx(NULL),mapy(NULL) {}
+    ~PolarMap() { Over(); }
+
+    // panoWidth: panorama columns over 2*pi, 0 disables the panorama
+    // panoHeight: panorama rows, 0 takes one row per pixel of radius
+    int Init(int width,int height,int cx,int cy,int rmin,int rmax,
+        int panoWidth=0,int panoHeight=0)
+    {
+      int i,j;
+      double dx,dy;
+
+      this->cx=cx;
+      this->cy=cy;
+      this->rmin=rmin;
+      this->rmax=rmax;
+      // Bounding box of the annulus clipped to the image
+      x0=cx-rmax; if (x0<0) x0=0;
+      y0=cy-rmax; if (y0<0) y0=0;
+      x1=cx+rmax; if (x1>width-1) x1=width-1;
+      y1=cy+rmax; if (y1>height-1) y1=height-1;
+      boxw=x1-x0+1;
+      boxh=y1-y0+1;
+      bearing.resize(boxw*boxh);
+      radius.resize(boxw*boxh);
+      for (i=y0;i<=y1;i++)
+      {
+        for (j=x0;j<=x1;j++)
+        {
+          dx=j-cx;
+          dy=cy-i;
+          bearing[(i-y0)*boxw+j-x0]=(int16_t)floor(atan2(dx,dy)*POLAR_BEARING_SCALE+0.5);
+          radius[(i-y0)*boxw+j-x0]=(uint16_t)floor(sqrt(dx*dx+dy*dy)*POLAR_RADIUS_SCALE+0.5);
+        }
+      }
+
+      Over();
+      if (panoWidth>0)
+      {
+        if (panoHeight<=0) panoHeight=rmax-rmin;
+        mapx=cvCreateMat(panoHeight,panoWidth,CV_32FC1);
+        mapy=cvCreateMat(panoHeight,panoWidth,CV_32FC1);
+        for (i=0;i<panoHeight;i++)
+        {
+          double r=rmax-(double)(rmax-rmin)*i/panoHeight;
+          float *px=(float *)(mapx->data.ptr+i*mapx->step);
+          float *py=(float *)(mapy->data.ptr+i*mapy->step);
+          for (j=0;j<panoWidth;j++)
+          {
+            double a=-POLAR_PI+2*POLAR_PI*j/panoWidth;
+            px[j]=cx+r*sin(a);
+            py[j]=cy-r*cos(a);
+          }
+        }
+      }
+      return 0;
+    }
+
+    void Over()
+    {
+      if (mapx!=NULL) cvReleaseMat(&mapx);
+      if (mapy!=NULL) cvReleaseMat(&mapy);
+      mapx=mapy=NULL;
+    }
+
+    // Bearing of pixel (x,y) in radians, 0 to the image top, positive to the
+    // right, the same as atan2(x-cx,cy-y)
+    double Bearing(int x,int y) const
+    {
+      if (!InBox(x,y)) return atan2((double)(x-cx),(double)(cy-y));
+      return bearing[(y-y0)*boxw+x-x0]/POLAR_BEARING_SCALE;
+    }
+
+    // Distance of pixel (x,y) to the omni-image center in pixels
+    double Radius(int x,int y) const
+    {
+      if (!InBox(x,y)) return sqrt((double)(x-cx)*(x-cx)+(y-cy)*(y-cy));
+      return radius[(y-y0)*boxw+x-x0]/POLAR_RADIUS_SCALE;
+    }
+
+    bool InAnnulus(int x,int y) const
+    {
+      if (!InBox(x,y)) return false;
+      int r=radius[(y-y0)*boxw+x-x0];
+      return r>rmin*POLAR_RADIUS_SCALE && r<rmax*POLAR_RADIUS_SCALE;
+    }
+
+    bool HasPanorama() const { return mapx!=NULL; }
+    int PanoWidth() const { return mapx ? mapx->cols : 0; }
+    int PanoHeight() const { return mapx ? mapx->rows : 0; }
+
+    // Unwarp an omni-image into a panorama of PanoWidth x PanoHeight with the
+    // same depth and channels
+    void Unwarp(const IplImage *omni,IplImage *pano) const
+    {
+      if (mapx!=NULL) cvRemap(omni,pano,mapx,mapy,CV_INTER_LINEAR+CV_WARP_FILL_OUTLIERS,cvScalarAll(0));
+    }
+
+    // Omni-image position of panorama pixel (col,row)
+    void PanoToOmni(int col,int row,int *x,int *y) const
+    {
+      *x=(int)(((float *)(mapx->data.ptr+row*mapx->step))[col]+0.5f);
+      *y=(int)(((float *)(mapy->data.ptr+row*mapy->step))[col]+0.5f);
+    }
+
+  private:
+    int cx,cy,rmin,rmax;
+    int x0,y0,x1,y1,boxw,boxh;
+    std::vector<int16_t> bearing; // quantized bearing over the bounding box
+    std::vector<uint16_t> radius; // quantized radius over the bounding box
+    CvMat *mapx,*mapy; // panorama remap, NULL if disabled
+
+    bool InBox(int x,int y) const { return x>=x0 && x<=x1 && y>=y0 && y<=y1; }
+};
+
+#endif
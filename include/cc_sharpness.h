@@ -0,0 +1,130 @@
+#ifndef _CC_SHARPNESS_H_
+#define _CC_SHARPNESS_H_
+
+#include <stdint.h>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Gradient energy focus measure on the Y channel of a YUV422 frame (byte
+// order V Y U Y): sum of squared horizontal and vertical Y differences over a
+// region of interest. The region is a list of row spans, built for the mirror
+// annulus or a rectangle (e.g. around the ball). Uses SSE2 for 8 pixels at
+// once when available.
+class SharpnessMeter
+{
+  public:
+    SharpnessMeter() : width(0),height(0) {}
+
+    // Annulus around (cx,cy), every rowStep'th row
+    void InitAnnulus(int width,int height,int cx,int cy,int rmin,int rmax,int rowStep=2)
+    {
+      int y,dy,ro,ri;
+      Reset(width,height);
+      for (y=cy-rmax;y<=cy+rmax;y+=rowStep)
+      {
+        dy=y-cy;
+        if (dy<0) dy=-dy;
+        ro=ISqrt(rmax*rmax-dy*dy);
+        if (dy<rmin)
+        {
+          ri=ISqrt(rmin*rmin-dy*dy);
+          AddSpan(y,cx-ro,cx-ri);
+          AddSpan(y,cx+ri,cx+ro);
+        }
+        else AddSpan(y,cx-ro,cx+ro);
+      }
+    }
+
+    // Rectangle [x0,x1)x[y0,y1), every rowStep'th row
+    void InitRect(int width,int height,int x0,int y0,int x1,int y1,int rowStep=1)
+    {
+      Reset(width,height);
+      for (int y=y0;y<y1;y+=rowStep) AddSpan(y,x0,x1);
+    }
+
+    int Pixels() const
+    {
+      int n=0;
+      for (unsigned int i=0;i<spans.size();i++) n+=spans[i].x1-spans[i].x0;
+      return n;
+    }
+
+    // Gradient energy of img inside the region
+    uint64_t Measure(const unsigned char *img) const
+    {
+      uint64_t sum=0;
+      const int stride=width*2;
+      for (unsigned int i=0;i<spans.size();i++)
+      {
+        const Span &s=spans[i];
+        const unsigned char *row=img+s.y*stride;
+        int x=s.x0;
+#ifdef __SSE2__
+        __m128i acc=_mm_setzero_si128();
+        // 8 pixels per step, the right neighbour of the last one is read too
+        for (;x+9<=s.x1;x+=8)
+        {
+          const unsigned char *p=row+x*2;
+          // Y is the odd byte of each 16 bit pair
+          __m128i c=_mm_srli_epi16(_mm_loadu_si128((const __m128i *)p),8);
+          __m128i r=_mm_srli_epi16(_mm_loadu_si128((const __m128i *)(p+2)),8);
+          __m128i d=_mm_srli_epi16(_mm_loadu_si128((const __m128i *)(p+stride)),8);
+          __m128i gx=_mm_sub_epi16(r,c);
+          __m128i gy=_mm_sub_epi16(d,c);
+          acc=_mm_add_epi32(acc,_mm_madd_epi16(gx,gx));
+          acc=_mm_add_epi32(acc,_mm_madd_epi16(gy,gy));
+        }
+        uint32_t lane[4];
+        _mm_storeu_si128((__m128i *)lane,acc);
+        sum+=(uint64_t)lane[0]+lane[1]+lane[2]+lane[3];
+#endif
+        for (;x<s.x1;x++)
+        {
+          int c=row[x*2+1];
+          int gx=(x+1<width ? row[x*2+3] : c)-c;
+          int gy=row[x*2+1+stride]-c;
+          sum+=gx*gx+gy*gy;
+        }
+      }
+      return sum;
+    }
+
+  private:
+    struct Span { int y,x0,x1; }; // pixels [x0,x1) of row y
+
+    int width,height;
+    std::vector<Span> spans;
+
+    void Reset(int width,int height)
+    {
+      this->width=width;
+      this->height=height;
+      spans.clear();
+    }
+
+    // Clip to the image, the row below has to exist for the vertical gradient
+    void AddSpan(int y,int x0,int x1)
+    {
+      Span s;
+      if (y<0 || y>=height-1) return;
+      if (x0<0) x0=0;
+      if (x1>width) x1=width;
+      if (x0>=x1) return;
+      s.y=y;
+      s.x0=x0;
+      s.x1=x1;
+      spans.push_back(s);
+    }
+
+    static int ISqrt(int v)
+    {
+      int r=0;
+      if (v<=0) return 0;
+      while ((r+1)*(r+1)<=v) r++;
+      return r;
+    }
+};
+
+#endif
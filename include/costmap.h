@@ -0,0 +1,192 @@
+/// @file costmap.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Configuration space of a map for path planning, the part of Player's
+/// wavefront driver that makes pnav_ex/stage wait seconds before playernav
+/// starts. Every cell gets a cost byte from its obstacle distance (see
+/// distancemap.h): obstacles are lethal, cells closer than the safety
+/// distance (wavefront's safety_dist) are inscribed, i.e. not to be entered
+/// either, and beyond it the cost decays exponentially to 0 over the
+/// inflation distance so paths keep off walls where there is room. Unknown
+/// cells have a cost of their own. The cost is looked up in a table by the
+/// distance in sixteenths of a cell and rows are split among threads.
+/// Cost maps are cached with the map (see mapcache.h), keyed by the
+/// distance transform's hash and the parameters, and can be exported as
+/// PGM for the mapfile driver and playernav.
+///
+#ifndef COSTMAP_H
+#define COSTMAP_H
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include "gridmap.h"
+#include "distancemap.h"
+#include "mapcache.h"
+#include "parallel.h"
+
+class CostMap {
+public:
+  static const unsigned char INSCRIBED = 253; ///< Closer than the safety distance
+  static const unsigned char LETHAL    = 254; ///< Obstacle
+  static const unsigned char UNKNOWN   = 255; ///< Unknown cell
+  static const unsigned char MAXCOST   = 252; ///< Cost at the safety distance
+
+  /// @param threads Threads sharing the rows
+  CostMap(int threads = 2)
+    : threads(threads), w(0), h(0), res(0.), originX(0.), originY(0.), cost(0) {}
+
+  /// Compute the costs of a map
+  /// @param dist Obstacle distances of the map
+  /// @param safety Distance to keep from obstacles in meters
+  /// @param inflation Distance beyond safety over which the cost decays
+  void build ( const GridMap & map, const DistanceMap & dist,
+               double safety = 0.5, double inflation = 0.5 )
+  {
+    cache.close();
+    setGeometry(map);
+    // Cost by distance in sixteenths of a cell
+    const double step = res/16.;
+    table.resize((int)ceil((safety + inflation)/step) + 1);
+    for (unsigned int i=0; i<table.size(); i++) table[i] = costOf(i*step, safety, inflation);
+    own.resize(w*h);
+    Rows r = { this, &map, dist.data() };
+    parallelLines(h, threads, rows, &r);
+    cost = &own[0];
+  }
+
+  /// Map the cached costs of a map, or compute and cache them
+  /// @param dir Cache directory, created if missing
+  /// @return True if the cache was used
+  bool load ( const GridMap & map, const DistanceMap & dist, const char * dir,
+              double safety = 0.5, double inflation = 0.5 )
+  {
+    const double param[2] = { safety, inflation };
+    const unsigned long long k = MapCache::fnv(dist.contentHash(), param, sizeof(param));
+    const std::string path = MapCache::file(dir, "cspace", k);
+    const MapCache::Header hd = MapCache::header("CSPACE", VERSION, map, 1, k);
+    if (cache.open(path.c_str(), hd)) {
+      setGeometry(map);
+      std::vector<unsigned char>().swap(own);
+      cost = static_cast<const unsigned char *>(cache.data());
+      return true;
+    }
+    build(map, dist, safety, inflation);
+    if (!MapCache::write(dir, path.c_str(), hd, cost))
+      fprintf(stderr, "Cannot write %s\n", path.c_str());
+    return false;
+  }
+
+  /// Cost at a distance from the closest obstacle
+  static unsigned char costOf ( double d, double safety, double inflation )
+  {
+    if (d <= 0.) return LETHAL;
+    return d < safety ? INSCRIBED : (unsigned char)(MAXCOST*exp(-3.*(d - safety)/inflation));
+  }
+
+  /// Cost of a cell
+  unsigned char at ( int cx, int cy ) const { return cost[cy*w + cx]; }
+  /// Cost at (x, y) in meters, lethal off the map
+  unsigned char at ( double x, double y ) const
+  {
+    const int cx = cellX(x), cy = cellY(y);
+    return inside(cx, cy) ? cost[cy*w + cx] : LETHAL;
+  }
+  /// True if a cell may be entered
+  bool passable ( int cx, int cy ) const { return cost[cy*w + cx] < INSCRIBED; }
+  /// Costs row by row from the lower left cell, 0 if none
+  const unsigned char * data ( void ) const { return cost; }
+
+  int cellX ( double x ) const { return (int)floor((x - originX)/res); }
+  int cellY ( double y ) const { return (int)floor((y - originY)/res); }
+  bool inside ( int cx, int cy ) const
+  {
+    return (unsigned)cx < (unsigned)w && (unsigned)cy < (unsigned)h;
+  }
+  int width ( void ) const { return w; }
+  int height ( void ) const { return h; }
+  double resolution ( void ) const { return res; }
+  double originx ( void ) const { return originX; }
+  double originy ( void ) const { return originY; }
+  /// True if the costs are mapped from a cache file
+  bool cached ( void ) const { return cache.mapped(); }
+
+  /// Write the C-space as binary PGM for the mapfile driver: cells not to
+  /// be entered black, unknown gray, the rest white, first row at the top
+  /// @return False if the file could not be written
+  bool writePgm ( const char * path ) const
+  {
+    FILE * fp = fopen(path, "wb");
+    if (!fp) return false;
+    fprintf(fp, "P5\n# C-space, %.3f m/pixel, origin %.3f %.3f\n%d %d\n255\n",
+        res, originX, originY, w, h);
+    std::vector<unsigned char> row(w);
+    bool ok = true;
+    for (int y=h-1; y>=0 && ok; y--) {
+      for (int x=0; x<w; x++) {
+        const unsigned char c = cost[y*w + x];
+        row[x] = c == UNKNOWN ? 128 : (c >= INSCRIBED ? 0 : 255);
+      }
+      ok = fwrite(&row[0], 1, w, fp) == (size_t)w;
+    }
+    return fclose(fp) == 0 && ok;
+  }
+
+private:
+  static const int VERSION = 1;
+
+  int threads;
+  int w, h;
+  double res, originX, originY;
+  std::vector<unsigned char> table; ///< Cost by distance
+  MapCache cache;                   ///< Cache file mapping
+  std::vector<unsigned char> own;   ///< Computed costs
+  const unsigned char * cost;       ///< Costs in use, own or mapped
+
+  /// Input of the row threads
+  struct Rows {
+    CostMap * self;
+    const GridMap * map;
+    const float * dist;
+  };
+
+  static void rows ( void * arg, int first, int last )
+  {
+    const Rows & r = *static_cast<Rows *>(arg);
+    CostMap & c = *r.self;
+    const float scale = (float)(16./c.res);
+    const int n = c.table.size();
+    for (int y=first; y<last; y++)
+      for (int x=0; x<c.w; x++) {
+        const int i = y*c.w + x;
+        const int st = r.map->state(x, y);
+        if (st != 0) {
+          const int k = (int)(r.dist[i]*scale);
+          c.own[i] = st > 0 ? LETHAL : (k < n ? c.table[k] : 0);
+        } else {
+          c.own[i] = UNKNOWN;
+        }
+      }
+  }
+
+  void setGeometry ( const GridMap & map )
+  {
+    w = map.width();
+    h = map.height();
+    res = map.resolution();
+    originX = map.originx();
+    originY = map.originy();
+  }
+
+  CostMap(const CostMap &);
+  CostMap & operator= (const CostMap &);
+};
+
+#endif
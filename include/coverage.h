@@ -0,0 +1,154 @@
+/// @file coverage.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Floor coverage of a run: the cells the laser observed within a useful
+/// range, cut shorter than the sensor range since far beams are too sparse
+/// to count as seen. Every beam is traced from the laser to its end point or
+/// the useful range, whichever is closer. A cell stores the number of the
+/// last scan that saw it, 0 if none, in a TileMap, so a scan counts a cell
+/// once however many beams pass it, and the map grows with the floor.
+/// A visit starts when a cell comes into view after it was out of view for
+/// some scans; the gap keeps cells at the edge of the beams, which flicker
+/// in and out of view, from counting. Visits of cells already covered are
+/// revisits, their share of all visits tells how much a behaviour drives
+/// over ground it has seen. The covered area is sampled over time, the
+/// time to reach a given area is looked up in the samples. Everything is
+/// updated per scan at the cost of the traced cells, so it runs every cycle
+/// online and equally over logs.
+///
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <cmath>
+#include <vector>
+#include "scanframe.h"
+#include "tilemap.h"
+
+/// Covered area at a time
+struct ts_CoverageSample {
+  double time; ///< Seconds since the first scan
+  double area; ///< Covered area in m^2
+};
+
+class Coverage {
+public:
+  /// @param res Cell size in meters
+  /// @param range Useful laser range in meters
+  /// @param interval Seconds between samples of the covered area
+  /// @param gap Scans a cell is out of view before it is visited again
+  Coverage(double res = 0.08, double range = 3., double interval = 1., int gap = 50)
+    : res(res), range(range), interval(interval), gap(gap) { clear(); }
+
+  void clear ( void )
+  {
+    cells.clear();
+    samples.clear();
+    scans = covered = visits = revisits = 0;
+    start = last = 0.;
+  }
+
+  /// Mark the cells a scan taken at the pose (x, y, yaw) observed
+  /// @param rangeMin Shorter ranges are invalid
+  /// @param time Time of the scan in seconds
+  void addScan ( const ScanFrame & scan, double rangeMin,
+                 double x, double y, double yaw, double time )
+  {
+    if (scans == 0) start = time;
+    last = time;
+    const int s = ++scans;
+    const double c = cos(yaw), sn = sin(yaw), m = scan.mountX();
+    const int lx = cellX(x + c*m), ly = cellY(y + sn*m);
+    const double * r = scan.ranges();
+    for (int i=0; i<scan.size(); i++) {
+      if (r[i] <= rangeMin) continue;
+      double bx = scan.x()[i], by = scan.y()[i];
+      if (r[i] > range) {
+        // Shorten the beam to the useful range
+        const double f = range/r[i];
+        bx = m + (bx - m)*f;
+        by *= f;
+      }
+      for (TileMap<int>::Ray ray(cells, lx, ly, cellX(x + c*bx - sn*by),
+            cellY(y + sn*bx + c*by)); ray.valid(); ray.next()) {
+        int & seen = *ray;
+        if (seen == s) continue;
+        if (!seen) {
+          visits++;
+          covered++;
+        } else if (s - seen > gap) {
+          visits++;
+          revisits++;
+        }
+        seen = s;
+      }
+    }
+    if (samples.empty() || time - start - samples.back().time >= interval) {
+      ts_CoverageSample sample = { time - start, area() };
+      samples.push_back(sample);
+    }
+  }
+
+  /// Scans added
+  int scanCount ( void ) const { return scans; }
+  /// Cells observed at least once
+  long coveredCells ( void ) const { return covered; }
+  /// Covered area in m^2
+  double area ( void ) const { return covered*res*res; }
+  /// Seconds from the first to the last scan
+  double duration ( void ) const { return last - start; }
+  /// Covered area per minute in m^2
+  double rate ( void ) const { return duration() > 0. ? area()*60./duration() : 0.; }
+  /// Cells coming into view so far, after the gap
+  long visitCount ( void ) const { return visits; }
+  /// Share of the visits to cells covered before, 0 to 1
+  double revisitRatio ( void ) const { return visits ? (double)revisits/visits : 0.; }
+  /// Covered area over time, one sample per interval
+  const std::vector<ts_CoverageSample> & history ( void ) const { return samples; }
+
+  /// Seconds from the first scan until an area was covered, at the sample
+  /// interval; negative if it is not yet
+  double timeTo ( double a ) const
+  {
+    if (area() < a) return -1.;
+    // Samples grow in area, find the first reaching a
+    unsigned int lo = 0, hi = samples.size();
+    while (lo < hi) {
+      const unsigned int mid = (lo + hi)/2;
+      if (samples[mid].area < a) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo < samples.size() ? samples[lo].time : duration();
+  }
+
+  int cellX ( double x ) const { return (int)floor(x/res); }
+  int cellY ( double y ) const { return (int)floor(y/res); }
+  /// True if the cell (cx, cy) was observed
+  bool isCovered ( int cx, int cy ) const { return cells.get(cx, cy) != 0; }
+  double resolution ( void ) const { return res; }
+  double usefulRange ( void ) const { return range; }
+  /// Memory of the cells and samples in bytes
+  size_t bytes ( void ) const
+  {
+    return cells.bytes() + samples.capacity()*sizeof(ts_CoverageSample);
+  }
+
+private:
+  double res, range, interval;
+  int    gap;
+  TileMap<int> cells;  ///< Last scan observing a cell, 0 if none
+  std::vector<ts_CoverageSample> samples;
+  int    scans;
+  long   covered, visits, revisits;
+  double start, last;  ///< Time of the first and the last scan
+
+  Coverage(const Coverage &);
+  Coverage & operator= (const Coverage &);
+};
+
+#endif
@@ -0,0 +1,201 @@
+/// @file distancemap.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Exact euclidean distance of every cell of a GridMap to the closest
+/// occupied one, in meters. The transform is Felzenszwalb and Huttenlocher's:
+/// the squared distance is the lower envelope of parabolas rooted at the
+/// obstacles, computed in linear time along every row and then along every
+/// column of the result. The lines of a pass are independent and split among
+/// threads; each pass writes its result transposed, so the second pass walks
+/// columns as rows.
+/// The distances can be cached (see mapcache.h) in a file named after a
+/// hash of the map's occupancy, size, resolution and origin; a cached
+/// transform is memory mapped instead of computed.
+///
+#ifndef DISTANCEMAP_H
+#define DISTANCEMAP_H
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include "gridmap.h"
+#include "mapcache.h"
+#include "parallel.h"
+
+class DistanceMap {
+public:
+  /// @param threads Threads sharing the lines of a pass
+  DistanceMap(int threads = 2)
+    : threads(threads), w(0), h(0), res(0.), originX(0.), originY(0.), key(0),
+      dist(0) {}
+
+  /// Transform a map
+  void compute ( const GridMap & map )
+  {
+    cache.close();
+    setGeometry(map);
+    key = hash(map);
+    const int n = w*h;
+    // Squared distances in cells, obstacles 0
+    std::vector<float> in(n);
+    for (int y=0; y<h; y++)
+      for (int x=0; x<w; x++) in[y*w + x] = map.state(x, y) > 0 ? 0.f : inf();
+    std::vector<float> t(n);
+    pass(&in[0], &t[0], h, w); // Rows, t holds columns
+    own.resize(n);
+    pass(&t[0], &own[0], w, h); // Columns, back to rows
+    const float far = (float)((w + h)*res);
+    for (int i=0; i<n; i++) own[i] = own[i] < inf() ? (float)(sqrt(own[i])*res) : far;
+    dist = &own[0];
+  }
+
+  /// Map the cached transform of a map, or compute and cache it
+  /// @param dir Cache directory, created if missing
+  /// @return True if the cache was used
+  bool load ( const GridMap & map, const char * dir )
+  {
+    const unsigned long long k = hash(map);
+    const std::string path = MapCache::file(dir, "edt", k);
+    const MapCache::Header hd = MapCache::header("EDTCACHE", VERSION, map, sizeof(float), k);
+    if (cache.open(path.c_str(), hd)) {
+      setGeometry(map);
+      key = k;
+      std::vector<float>().swap(own);
+      dist = static_cast<const float *>(cache.data());
+      return true;
+    }
+    compute(map);
+    if (!MapCache::write(dir, path.c_str(), hd, dist))
+      fprintf(stderr, "Cannot write %s\n", path.c_str());
+    return false;
+  }
+
+  /// Distance of a cell in meters
+  float at ( int cx, int cy ) const { return dist[cy*w + cx]; }
+  /// Distance at (x, y) in meters, 0 off the map
+  float at ( double x, double y ) const
+  {
+    const int cx = (int)floor((x - originX)/res), cy = (int)floor((y - originY)/res);
+    return (unsigned)cx < (unsigned)w && (unsigned)cy < (unsigned)h ? dist[cy*w + cx] : 0.f;
+  }
+  /// Distances row by row from the lower left cell, 0 if none
+  const float * data ( void ) const { return dist; }
+
+  int width ( void ) const { return w; }
+  int height ( void ) const { return h; }
+  double resolution ( void ) const { return res; }
+  double originx ( void ) const { return originX; }
+  double originy ( void ) const { return originY; }
+  /// Cache key of the transformed map
+  unsigned long long contentHash ( void ) const { return key; }
+  /// True if the distances are mapped from a cache file
+  bool cached ( void ) const { return cache.mapped(); }
+
+  /// FNV-1a hash of a map's geometry and occupancy
+  static unsigned long long hash ( const GridMap & map )
+  {
+    unsigned long long k = 14695981039346656037ULL;
+    const int w = map.width(), h = map.height();
+    const double geo[3] = { map.resolution(), map.originx(), map.originy() };
+    k = MapCache::fnv(k, &w, sizeof(w));
+    k = MapCache::fnv(k, &h, sizeof(h));
+    k = MapCache::fnv(k, geo, sizeof(geo));
+    std::vector<signed char> row(w);
+    for (int y=0; y<h; y++) {
+      for (int x=0; x<w; x++) row[x] = (signed char)map.state(x, y);
+      k = MapCache::fnv(k, &row[0], w);
+    }
+    return k;
+  }
+
+private:
+  static const int VERSION = 1;
+
+  int threads;
+  int w, h;
+  double res, originX, originY;
+  unsigned long long key;
+  MapCache cache;           ///< Cache file mapping
+  std::vector<float> own;   ///< Computed distances
+  const float * dist;       ///< Distances in use, own or mapped
+
+  /// Squared distance of no obstacle
+  static float inf ( void ) { return 1e20f; }
+
+  /// Lines of a pass
+  struct Pass {
+    const float * in;
+    float * out;
+    int lines, len;
+  };
+
+  void setGeometry ( const GridMap & map )
+  {
+    w = map.width();
+    h = map.height();
+    res = map.resolution();
+    originX = map.originx();
+    originY = map.originy();
+  }
+
+  /// Transform every line of in, out is transposed
+  void pass ( const float * in, float * out, int lines, int len )
+  {
+    Pass p = { in, out, lines, len };
+    parallelLines(lines, threads, passLines, &p);
+  }
+
+  static void passLines ( void * pass, int first, int last )
+  {
+    const Pass & p = *static_cast<Pass *>(pass);
+    std::vector<float> d(p.len), z(p.len + 1);
+    std::vector<int> v(p.len);
+    for (int l=first; l<last; l++) {
+      transform(p.in + l*p.len, p.len, &d[0], &v[0], &z[0]);
+      for (int i=0; i<p.len; i++) p.out[i*p.lines + l] = d[i];
+    }
+  }
+
+  /// 1D squared distance transform of sampled function f: the lower
+  /// envelope of the parabolas (q - i)^2 + f(i), inf() samples have none
+  static void transform ( const float * f, int n, float * d, int * v, float * z )
+  {
+    int k = -1;
+    for (int q=0; q<n; q++) {
+      if (f[q] >= inf()) continue;
+      // Drop parabolas hidden by the new one
+      float s = 0.f;
+      while (k >= 0) {
+        const int p = v[k];
+        s = ((f[q] + (float)q*q) - (f[p] + (float)p*p))/(2.f*(q - p));
+        if (s > z[k]) break;
+        k--;
+      }
+      k++;
+      v[k] = q;
+      z[k] = k == 0 ? -inf() : s;
+    }
+    if (k < 0) {
+      std::fill(d, d + n, inf());
+      return;
+    }
+    z[k + 1] = inf();
+    for (int q=0, j=0; q<n; q++) {
+      while (z[j + 1] < q) j++;
+      const float dq = (float)(q - v[j]);
+      d[q] = dq*dq + f[v[j]];
+    }
+  }
+
+  DistanceMap(const DistanceMap &);
+  DistanceMap & operator= (const DistanceMap &);
+};
+
+#endif
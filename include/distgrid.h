@@ -0,0 +1,106 @@
+/// @file distgrid.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Obstacle distance grid around the robot, robot coordinates.
+/// The obstacle points of a cycle are marked and a two pass chamfer distance
+/// transform gives every cell its distance to the closest one, so the
+/// clearance of any position is a table read. Distances are capped at
+/// maxDist, positions outside the grid read maxDist.
+///
+#ifndef DISTGRID_H
+#define DISTGRID_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "scanframe.h"
+
+class DistGrid {
+public:
+  /// @param size Side length in meters, the robot is at the center
+  /// @param res Cell size in meters
+  /// @param maxDist Distance cap in meters
+  DistGrid(double size = 6., double res = 0.05, double maxDist = 1.)
+    : n((int)(size/res + 0.5)), res(res), maxDist(maxDist), dist(n*n) { clear(); }
+
+  /// Remove all obstacles
+  void clear ( void ) { std::fill(dist.begin(), dist.end(), (float)maxDist); }
+
+  /// Mark an obstacle point
+  void addPoint ( double x, double y )
+  {
+    const int cx = cell(x), cy = cell(y);
+    if (cx >= 0 && cx < n && cy >= 0 && cy < n) dist[cy*n + cx] = 0.f;
+  }
+
+  /// Mark the end points of the valid ranges of a scan
+  void addScan ( const ScanFrame & scan, double rangeMin, double rangeMax )
+  {
+    const double * r = scan.ranges();
+    for (int i=0; i<scan.size(); i++)
+      if (r[i] > rangeMin && r[i] < rangeMax) addPoint(scan.x()[i], scan.y()[i]);
+  }
+
+  /// Compute the distances of all cells to the marked obstacles
+  void update ( void )
+  {
+    const float d1 = (float)res, d2 = (float)(res*M_SQRT2);
+    // Forward pass: left and upper neighbours
+    for (int y=0; y<n; y++) {
+      float * row = &dist[y*n];
+      const float * up = y > 0 ? row - n : 0;
+      for (int x=0; x<n; x++) {
+        float d = row[x];
+        if (x > 0) d = std::min(d, row[x-1] + d1);
+        if (up) {
+          d = std::min(d, up[x] + d1);
+          if (x > 0)   d = std::min(d, up[x-1] + d2);
+          if (x < n-1) d = std::min(d, up[x+1] + d2);
+        }
+        row[x] = d;
+      }
+    }
+    // Backward pass: right and lower neighbours
+    for (int y=n-1; y>=0; y--) {
+      float * row = &dist[y*n];
+      const float * down = y < n-1 ? row + n : 0;
+      for (int x=n-1; x>=0; x--) {
+        float d = row[x];
+        if (x < n-1) d = std::min(d, row[x+1] + d1);
+        if (down) {
+          d = std::min(d, down[x] + d1);
+          if (x < n-1) d = std::min(d, down[x+1] + d2);
+          if (x > 0)   d = std::min(d, down[x-1] + d2);
+        }
+        row[x] = std::min(d, (float)maxDist);
+      }
+    }
+  }
+
+  /// Obstacle distance at (x, y) in meters
+  float at ( double x, double y ) const
+  {
+    const int cx = cell(x), cy = cell(y);
+    if (cx < 0 || cx >= n || cy < 0 || cy >= n) return (float)maxDist;
+    return dist[cy*n + cx];
+  }
+
+  double maxDistance ( void ) const { return maxDist; }
+  double resolution ( void ) const { return res; }
+  int cells ( void ) const { return n; }
+
+private:
+  int n; ///< Cells per side
+  double res, maxDist;
+  std::vector<float> dist;
+
+  int cell ( double v ) const { return (int)floor(v/res) + n/2; }
+};
+
+#endif
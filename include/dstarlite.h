@@ -0,0 +1,441 @@
+/// @file dstarlite.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Incremental global path planner on a CostMap, D* Lite after Koenig and
+/// Likhachev (optimized version). The search runs backwards from the goal,
+/// so when the robot moves only the heuristic offset km grows, and when
+/// costs change only the cells whose cost to the goal is affected are
+/// expanded again, where Player's wavefront recomputes its whole potential.
+/// Cells are 8-connected; a move costs its length in cells times the cost
+/// of the cell entered: 1 in the open, growing with the inflation cost,
+/// high for inscribed cells (crossed only where there is no other way, as a
+/// start close to a wall or a narrow door), lethal cells have no moves.
+/// Unknown cells count as free by default, D* Lite's free space assumption.
+/// Costs are integers, a straight move of length 70 and a diagonal one of
+/// 99, so the octile heuristic and the keys are exact: with float keys
+/// rounding breaks the ties of equal first keys and leaves cells on the
+/// path inconsistent.
+/// Cells are a compact index into a grid padded by a lethal border, so
+/// neighbours need no bounds checks; the open list is a binary heap with the
+/// heap position stored per cell for key updates and removal.
+///
+#ifndef DSTARLITE_H
+#define DSTARLITE_H
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+#include "costmap.h"
+
+/// Work of the planner
+struct ts_PlanStats {
+  int    expanded;      ///< Cells expanded by the last replan
+  int    changed;       ///< Cells whose cost changed before the last replan
+  double usec;          ///< Time of the last replan in microseconds
+  int    replans;       ///< Replans since the goal was set
+  long   expandedTotal; ///< Cells expanded since the goal was set
+  double usecTotal;     ///< Replan time since the goal was set
+  double usecMax;       ///< Longest replan since the goal was set
+};
+
+class DStarLite {
+public:
+  DStarLite()
+    : w(0), h(0), pw(0), res(0.), originX(0.), originY(0.), start(-1), goal(-1),
+      km(0), changed(0)
+  {
+    setCosts(3., 50., true);
+    resetStats();
+  }
+
+  /// Costs of a move per cell length
+  /// @param weight Added cost of a cell of CostMap::MAXCOST
+  /// @param inscribed Cost of an inscribed cell
+  /// @param unknownFree Unknown cells cost 1 if true, have no moves otherwise
+  void setCosts ( double weight, double inscribed, bool unknownFree )
+  {
+    for (int d=0; d<2; d++) {
+      int l = STRAIGHT;
+      if (d) l = DIAGONAL;
+      for (int c=0; c<256; c++)
+        move[d][c] = (int)(l*(1. + weight*c/CostMap::MAXCOST) + 0.5);
+      move[d][CostMap::INSCRIBED] = (int)(l*std::max(1., inscribed) + 0.5);
+      move[d][CostMap::LETHAL]    = INF;
+      move[d][CostMap::UNKNOWN]   = INF;
+      if (unknownFree) move[d][CostMap::UNKNOWN] = l;
+    }
+  }
+
+  /// Take over the costs and geometry of a map, the plan is dropped
+  void setMap ( const CostMap & costs )
+  {
+    w = costs.width();
+    h = costs.height();
+    pw = w + 2;
+    res = costs.resolution();
+    originX = costs.originx();
+    originY = costs.originy();
+    cost.assign(pw*(h + 2), (unsigned char)CostMap::LETHAL);
+    for (int y=0; y<h; y++)
+      std::copy(costs.data() + y*w, costs.data() + (y + 1)*w, &cost[index(0, y)]);
+    const int off[8] = { 1, -1, pw, -pw, pw + 1, pw - 1, -pw + 1, -pw - 1 };
+    for (int k=0; k<8; k++) nb[k] = off[k];
+    node.resize(cost.size());
+    start = goal = -1;
+    reset();
+  }
+
+  /// Costs of the map changed, e.g. the online map took a scan. Only
+  /// changed cells are repaired; a map of another geometry is taken over.
+  /// @return Cells changed
+  int update ( const CostMap & costs )
+  {
+    if (costs.width() != w || costs.height() != h || costs.resolution() != res ||
+        costs.originx() != originX || costs.originy() != originY) {
+      const double gx = goal >= 0 ? cellCenterX(goal) : 0., gy = goal >= 0 ? cellCenterY(goal) : 0.;
+      const bool hadGoal = goal >= 0;
+      setMap(costs);
+      if (hadGoal) setGoal(gx, gy);
+      return w*h;
+    }
+    int n = 0;
+    const unsigned char * c = costs.data();
+    for (int y=0; y<h; y++) {
+      unsigned char * row = &cost[index(0, y)];
+      const unsigned char * in = c + y*w;
+      for (int x=0; x<w; x++)
+        if (row[x] != in[x]) {
+          setCost(x, y, in[x]);
+          n++;
+        }
+    }
+    return n;
+  }
+
+  /// Change the cost of a cell
+  void setCost ( int cx, int cy, unsigned char c )
+  {
+    if (!inside(cx, cy)) return;
+    const int u = index(cx, cy);
+    if (cost[u] == c) return;
+    cost[u] = c;
+    changed++;
+    if (goal < 0 || start < 0) return;
+    // The moves into and out of u changed
+    updateVertex(u);
+    for (int k=0; k<8; k++) updateVertex(u + nb[k]);
+  }
+
+  /// Set the goal, the search starts over
+  /// @param x,y Goal in meters
+  /// @return False if off the map
+  bool setGoal ( double x, double y )
+  {
+    const int cx = cellX(x), cy = cellY(y);
+    if (!inside(cx, cy)) return false;
+    reset();
+    goal = index(cx, cy);
+    node[goal].rhs = 0.f;
+    if (start >= 0) push(goal, key(goal));
+    resetStats();
+    return true;
+  }
+
+  /// Set the robot position
+  /// @param x,y Position in meters
+  /// @return False if off the map
+  bool setStart ( double x, double y )
+  {
+    const int cx = cellX(x), cy = cellY(y);
+    if (!inside(cx, cy)) return false;
+    const int s = index(cx, cy);
+    if (start < 0) {
+      start = s;
+      if (goal >= 0 && node[goal].heap < 0 && node[goal].g == INF) push(goal, key(goal));
+      return true;
+    }
+    // Keys in the heap stay lower bounds when km grows by the distance moved
+    km += heuristic(start, s);
+    start = s;
+    return true;
+  }
+
+  /// Bring the costs to the goal up to date as far as the path needs them
+  /// @return False if there is no path
+  bool replan ( void )
+  {
+    if (start < 0 || goal < 0) return false;
+    timeval t0, t1;
+    gettimeofday(&t0, 0);
+    int expanded = 0;
+    while (!heap.empty()) {
+      const Key ks = key(start);
+      const Node & s = node[start];
+      if (!(heap[0].k < ks) && s.rhs <= s.g) break;
+      const int u = heap[0].cell;
+      const Key kold = heap[0].k, knew = key(u);
+      Node & nu = node[u];
+      expanded++;
+      if (kold < knew) {
+        set(0, knew);
+      } else if (nu.g > nu.rhs) {
+        // Overconsistent: the cost to the goal fell, lower the predecessors
+        nu.g = nu.rhs;
+        remove(nu.heap);
+        if (!passable(u)) continue;
+        for (int k=0; k<8; k++) {
+          const int p = u + nb[k];
+          if (p == goal || !passable(p)) continue;
+          const int r = move[k >= 4][cost[u]] + nu.g;
+          if (r < node[p].rhs) {
+            node[p].rhs = r;
+            fix(p);
+          }
+        }
+      } else {
+        // Underconsistent: raise u, predecessors relying on it look again
+        const int gold = nu.g;
+        nu.g = INF;
+        if (u != goal) nu.rhs = bestSuccessor(u);
+        fix(u);
+        if (!passable(u)) continue;
+        for (int k=0; k<8; k++) {
+          const int p = u + nb[k];
+          if (p == goal || !passable(p)) continue;
+          if (node[p].rhs == move[k >= 4][cost[u]] + gold) {
+            node[p].rhs = bestSuccessor(p);
+            fix(p);
+          }
+        }
+      }
+    }
+    gettimeofday(&t1, 0);
+    last.expanded = expanded;
+    last.changed  = changed;
+    last.usec     = (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+    last.replans++;
+    last.expandedTotal += expanded;
+    last.usecTotal += last.usec;
+    last.usecMax = std::max(last.usecMax, last.usec);
+    changed = 0;
+    return node[start].rhs < INF;
+  }
+
+  /// Path of the last replan as cell centers from the start to the goal
+  /// @return False if there is no path
+  bool path ( std::vector<double> & x, std::vector<double> & y ) const
+  {
+    x.clear();
+    y.clear();
+    if (start < 0 || goal < 0 || node[start].rhs >= INF) return false;
+    int s = start;
+    for (int i=0; i<w*h; i++) {
+      x.push_back(cellCenterX(s));
+      y.push_back(cellCenterY(s));
+      if (s == goal) return true;
+      int best = -1, bc = INF;
+      for (int k=0; k<8; k++) {
+        const int n = s + nb[k];
+        const int c = move[k >= 4][cost[n]] + node[n].g;
+        if (c < bc) { bc = c; best = n; }
+      }
+      if (best < 0) return false;
+      s = best;
+    }
+    return false;
+  }
+
+  /// Cost of the path in cell lengths, negative if none
+  double pathCost ( void ) const
+  {
+    return start >= 0 && node[start].rhs < INF ? (double)node[start].rhs/STRAIGHT : -1.;
+  }
+  /// Statistics of the last replan and since the goal was set
+  const ts_PlanStats & stats ( void ) const { return last; }
+  /// Cost of a cell
+  unsigned char costAt ( int cx, int cy ) const { return cost[index(cx, cy)]; }
+
+  int cellX ( double x ) const { return (int)floor((x - originX)/res); }
+  int cellY ( double y ) const { return (int)floor((y - originY)/res); }
+  bool inside ( int cx, int cy ) const
+  {
+    return (unsigned)cx < (unsigned)w && (unsigned)cy < (unsigned)h;
+  }
+
+private:
+  /// Priority of a cell, compared lexicographically
+  struct Key {
+    int k1, k2;
+    bool operator< ( const Key & o ) const
+    {
+      return k1 < o.k1 || (k1 == o.k1 && k2 < o.k2);
+    }
+  };
+  struct Item {
+    Key k;
+    int cell;
+  };
+  /// Search state of a cell
+  struct Node {
+    int g, rhs;   ///< Cost to the goal and its one step lookahead
+    int heap;     ///< Position in the heap, -1 if not queued
+  };
+
+  int w, h, pw;   ///< Size in cells, padded row length
+  double res, originX, originY;
+  std::vector<unsigned char> cost; ///< Padded costs
+  std::vector<Node> node;          ///< Padded search state
+  std::vector<Item> heap;          ///< Open list
+  static const int STRAIGHT = 70;  ///< Cost of a straight move in the open
+  static const int DIAGONAL = 99;  ///< Cost of a diagonal move in the open
+  static const int INF = 0x3fffffff; ///< No path, twice fits an int
+
+  int nb[8];      ///< Index offsets of the neighbours, diagonal from 4 on
+  int move[2][256]; ///< Straight and diagonal move cost by the cost of the cell entered
+  int start, goal;
+  int km;         ///< Heuristic offset of the start moves
+  int changed;    ///< Cells changed since the last replan
+  ts_PlanStats last;
+
+  int index ( int cx, int cy ) const { return (cy + 1)*pw + cx + 1; }
+  double cellCenterX ( int i ) const { return originX + (i % pw - 1 + 0.5)*res; }
+  double cellCenterY ( int i ) const { return originY + (i / pw - 1 + 0.5)*res; }
+  bool passable ( int i ) const { return move[0][cost[i]] < INF; }
+
+  /// Octile distance in cells, consistent with the move costs
+  int heuristic ( int a, int b ) const
+  {
+    const int dx = std::abs(a % pw - b % pw), dy = std::abs(a / pw - b / pw);
+    return dx > dy ? STRAIGHT*dx + (DIAGONAL - STRAIGHT)*dy : STRAIGHT*dy + (DIAGONAL - STRAIGHT)*dx;
+  }
+
+  Key key ( int i ) const
+  {
+    const int m = std::min(node[i].g, node[i].rhs);
+    Key k = { m, m };
+    if (m < INF) k.k1 += heuristic(start, i) + km;
+    return k;
+  }
+
+  /// Cheapest move of i to a neighbour and on to the goal
+  int bestSuccessor ( int i ) const
+  {
+    if (!passable(i)) return INF;
+    int best = INF;
+    for (int k=0; k<8; k++) {
+      const int n = i + nb[k];
+      const int c = move[k >= 4][cost[n]] + node[n].g;
+      if (c < best) best = c;
+    }
+    return best;
+  }
+
+  void updateVertex ( int i )
+  {
+    if (i != goal) node[i].rhs = bestSuccessor(i);
+    fix(i);
+  }
+
+  /// Queue an inconsistent cell with its key, unqueue a consistent one
+  void fix ( int i )
+  {
+    Node & n = node[i];
+    if (n.g != n.rhs) {
+      if (n.heap >= 0) set(n.heap, key(i));
+      else push(i, key(i));
+    } else if (n.heap >= 0) {
+      remove(n.heap);
+    }
+  }
+
+  void reset ( void )
+  {
+    Node n = { INF, INF, -1 };
+    std::fill(node.begin(), node.end(), n);
+    heap.clear();
+    km = 0.f;
+    goal = -1;
+  }
+
+  void resetStats ( void )
+  {
+    last.expanded = last.changed = last.replans = 0;
+    last.expandedTotal = 0;
+    last.usec = last.usecTotal = last.usecMax = 0.;
+  }
+
+  // Binary heap on the keys {{{
+  void place ( int pos, const Item & it )
+  {
+    heap[pos] = it;
+    node[it.cell].heap = pos;
+  }
+
+  void up ( int pos )
+  {
+    const Item it = heap[pos];
+    while (pos > 0) {
+      const int p = (pos - 1)/2;
+      if (!(it.k < heap[p].k)) break;
+      place(pos, heap[p]);
+      pos = p;
+    }
+    place(pos, it);
+  }
+
+  void down ( int pos )
+  {
+    const Item it = heap[pos];
+    const int n = heap.size();
+    for (;;) {
+      int c = 2*pos + 1;
+      if (c >= n) break;
+      if (c + 1 < n && heap[c + 1].k < heap[c].k) c++;
+      if (!(heap[c].k < it.k)) break;
+      place(pos, heap[c]);
+      pos = c;
+    }
+    place(pos, it);
+  }
+
+  void push ( int cell, const Key & k )
+  {
+    const Item it = { k, cell };
+    heap.push_back(it);
+    up(heap.size() - 1);
+  }
+
+  void set ( int pos, const Key & k )
+  {
+    const bool lower = k < heap[pos].k;
+    heap[pos].k = k;
+    if (lower) up(pos);
+    else down(pos);
+  }
+
+  void remove ( int pos )
+  {
+    node[heap[pos].cell].heap = -1;
+    const Item back = heap.back();
+    heap.pop_back();
+    if (pos == (int)heap.size()) return;
+    const bool lower = back.k < heap[pos].k;
+    place(pos, back);
+    if (lower) up(pos);
+    else down(pos);
+  }
+  // }}}
+
+  DStarLite(const DStarLite &);
+  DStarLite & operator= (const DStarLite &);
+};
+
+#endif
@@ -0,0 +1,190 @@
+/// @file dwaplanner.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Dynamic window approach local planner.
+/// The (v, w) window reachable within one cycle from the current velocities
+/// is sampled and every candidate arc is forward simulated over the horizon.
+/// All candidates are stepped together as one batch (structure of arrays,
+/// four at a time with SSE), their clearance is read from a DistGrid. Each
+/// candidate is scored by its heading to the goal at the end of the arc,
+/// its clearance and its speed. The best candidates are finally checked with
+/// the exact swept Footprint.
+///
+#ifndef DWAPLANNER_H
+#define DWAPLANNER_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include "distgrid.h"
+#include "footprint.h"
+
+/// Dynamic window and scoring parameters
+struct ts_DwaConfig {
+  double vMax;      ///< Max speed in m/s
+  double wMax;      ///< Max turnrate in rad/s
+  double acc;       ///< Translational acceleration in m/s^2
+  double rotAcc;    ///< Rotational acceleration in rad/s^2
+  double dt;        ///< Control cycle in seconds
+  double horizon;   ///< Simulated time in seconds
+  int    steps;     ///< Simulation steps over the horizon
+  int    nv, nw;    ///< Samples of the window
+  double halfWidth; ///< Min clearance of the robot center in meters
+  double wHeading, wClear, wVel; ///< Score weights
+  int    checks;    ///< Best candidates checked with the footprint at most
+};
+
+class DwaPlanner {
+public:
+  DwaPlanner(const ts_DwaConfig & cfg) : cfg(cfg) {}
+
+  /// Plan the next velocities.
+  /// @param v,w Current velocities
+  /// @param goalX,goalY Goal in robot coordinates
+  /// @param vCap Speed limit of the current behaviour
+  /// @param grid Obstacle distances
+  /// @param fp Footprint with the obstacle points
+  /// @param vOut,wOut Planned velocities
+  /// @return False if no candidate is admissible
+  bool plan ( double v, double w, double goalX, double goalY, double vCap,
+              const DistGrid & grid, const Footprint & fp,
+              double * vOut, double * wOut )
+  {
+    sample(v, w, std::min(vCap, cfg.vMax));
+    simulate(grid);
+    score(goalX, goalY, grid.maxDistance());
+
+    // Best first, the footprint decides
+    order.clear();
+    for (int i=0; i<count; i++)
+      if (sc[i] > -1.f) order.push_back(i);
+    const int k = std::min((int)order.size(), cfg.checks);
+    std::partial_sort(order.begin(), order.begin() + k, order.end(), ByScore(sc));
+    for (int i=0; i<k; i++) {
+      const int c = order[i];
+      if (fp.free(cv[c], cw[c], cfg.horizon)) {
+        *vOut = cv[c];
+        *wOut = cw[c];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Number of candidates of the last plan
+  int candidates ( void ) const { return count; }
+
+private:
+  ts_DwaConfig cfg;
+  int count;
+  // Candidates, structure of arrays padded to a multiple of 4
+  std::vector<float> cv, cw;       ///< Velocities
+  std::vector<float> px, py;       ///< Position
+  std::vector<float> hc, hs;       ///< Heading unit vector
+  std::vector<float> rc, rs;       ///< Heading rotation per step
+  std::vector<float> mc, ms;       ///< Half step rotation
+  std::vector<float> chord;        ///< Distance per step
+  std::vector<float> clear;        ///< Min obstacle distance
+  std::vector<float> sc;           ///< Score, -1 if inadmissible
+  std::vector<int> order;
+
+  struct ByScore {
+    ByScore(const std::vector<float> & s) : s(s) {}
+    bool operator() ( int a, int b ) const { return s[a] > s[b]; }
+    const std::vector<float> & s;
+  };
+
+  void sample ( double v, double w, double vCap )
+  {
+    const double v0 = std::max(0., v - cfg.acc*cfg.dt);
+    const double v1 = std::min(vCap, v + cfg.acc*cfg.dt);
+    const double w0 = std::max(-cfg.wMax, w - cfg.rotAcc*cfg.dt);
+    const double w1 = std::min( cfg.wMax, w + cfg.rotAcc*cfg.dt);
+    const double h = cfg.horizon/cfg.steps;
+    count = cfg.nv*cfg.nw;
+    const int padded = (count + 3) & ~3;
+    cv.resize(padded); cw.resize(padded);
+    px.resize(padded); py.resize(padded);
+    hc.resize(padded); hs.resize(padded);
+    rc.resize(padded); rs.resize(padded);
+    mc.resize(padded); ms.resize(padded);
+    chord.resize(padded); clear.resize(padded); sc.resize(padded);
+    for (int i=0; i<padded; i++) {
+      const int iv = (i/cfg.nw) % cfg.nv, iw = i % cfg.nw;
+      const double vi = cfg.nv > 1 ? v0 + (v1 - v0)*iv/(cfg.nv - 1) : v1;
+      const double wi = cfg.nw > 1 ? w0 + (w1 - w0)*iw/(cfg.nw - 1) : w;
+      const double a = wi*h;
+      cv[i] = (float)std::max(0., vi);
+      cw[i] = (float)wi;
+      rc[i] = (float)cos(a);   rs[i] = (float)sin(a);
+      mc[i] = (float)cos(a/2); ms[i] = (float)sin(a/2);
+      // Chord of the arc step: 2 v/w sin(w h/2)
+      chord[i] = (float)(fabs(a) > 1e-9 ? cv[i]*h*sin(a/2)/(a/2) : cv[i]*h);
+      px[i] = py[i] = 0.f;
+      hc[i] = 1.f; hs[i] = 0.f;
+      clear[i] = 1e9f;
+    }
+  }
+
+  /// Step all candidates along their arcs and track their clearance
+  void simulate ( const DistGrid & grid )
+  {
+    const int padded = cv.size();
+    for (int k=0; k<cfg.steps; k++) {
+      int i = 0;
+#ifdef __SSE__
+      for (; i<padded; i+=4) {
+        const __m128 c = _mm_loadu_ps(&hc[i]), s = _mm_loadu_ps(&hs[i]);
+        const __m128 m1 = _mm_loadu_ps(&mc[i]), m2 = _mm_loadu_ps(&ms[i]);
+        const __m128 r1 = _mm_loadu_ps(&rc[i]), r2 = _mm_loadu_ps(&rs[i]);
+        const __m128 l = _mm_loadu_ps(&chord[i]);
+        // Chord along the mid step heading
+        const __m128 dx = _mm_mul_ps(l, _mm_sub_ps(_mm_mul_ps(c, m1), _mm_mul_ps(s, m2)));
+        const __m128 dy = _mm_mul_ps(l, _mm_add_ps(_mm_mul_ps(s, m1), _mm_mul_ps(c, m2)));
+        _mm_storeu_ps(&px[i], _mm_add_ps(_mm_loadu_ps(&px[i]), dx));
+        _mm_storeu_ps(&py[i], _mm_add_ps(_mm_loadu_ps(&py[i]), dy));
+        _mm_storeu_ps(&hc[i], _mm_sub_ps(_mm_mul_ps(c, r1), _mm_mul_ps(s, r2)));
+        _mm_storeu_ps(&hs[i], _mm_add_ps(_mm_mul_ps(s, r1), _mm_mul_ps(c, r2)));
+      }
+#endif
+      for (; i<padded; i++) {
+        const float c = hc[i], s = hs[i];
+        px[i] += chord[i]*(c*mc[i] - s*ms[i]);
+        py[i] += chord[i]*(s*mc[i] + c*ms[i]);
+        hc[i] = c*rc[i] - s*rs[i];
+        hs[i] = s*rc[i] + c*rs[i];
+      }
+      for (i=0; i<padded; i++) clear[i] = std::min(clear[i], grid.at(px[i], py[i]));
+    }
+  }
+
+  /// Score heading to the goal, clearance and speed
+  void score ( double goalX, double goalY, double maxDist )
+  {
+    const float hw = (float)cfg.halfWidth;
+    const float cw0 = (float)(cfg.wClear/(maxDist - cfg.halfWidth));
+    const float vw0 = (float)(cfg.wVel/cfg.vMax);
+    for (int i=0; i<count; i++) {
+      if (clear[i] <= hw) {
+        sc[i] = -1.f;
+        continue;
+      }
+      // Goal bearing relative to the end heading
+      const double gx = goalX - px[i], gy = goalY - py[i];
+      const double err = atan2(gy*hc[i] - gx*hs[i], gx*hc[i] + gy*hs[i]);
+      sc[i] = (float)(cfg.wHeading*(1. - fabs(err)/M_PI))
+            + cw0*(clear[i] - hw) + vw0*cv[i];
+    }
+  }
+};
+
+#endif
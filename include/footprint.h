@@ -0,0 +1,417 @@
+/// @file footprint.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Collision check of the robot's polygonal footprint against obstacle points
+/// (laser end points, sonar returns) in robot coordinates.
+/// For a candidate motion (v, w) the footprint is swept along its arc: at
+/// each time step the footprint's convex polygon is written as half planes
+/// in the start frame, a*x + b*y <= c, and tested against all points, four
+/// at once with SSE. The step is chosen so no footprint point moves further
+/// than the resolution, i.e. a collision shallower than it may slip through.
+/// Points out of reach are dropped when they are added, and per arc only the
+/// points within the ring swept by the footprint's enclosing circle are
+/// stepped through, so a check takes a few microseconds.
+/// For speed limiting the time to collision of every point is computed in
+/// closed form instead: relative to the robot a point moves on a circle
+/// around the center of the arc (a line when driving straight) and hits the
+/// footprint where that path first crosses a polygon edge. The crossings are
+/// compared by pseudo angle, four points at once with SSE; only the first one
+/// of a point needs an atan2.
+///
+#ifndef FOOTPRINT_H
+#define FOOTPRINT_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include "scanframe.h"
+
+class Footprint {
+public:
+  static const int MAXEDGES = 16; ///< Polygon corners at most
+
+  /// Rectangle footprint
+  /// @param length,width Size in meters
+  /// @param originX Offset of the footprint center from the center of
+  ///        rotation in meters (stage's origin)
+  Footprint(double length = 0.44, double width = 0.38, double originX = -0.04)
+  {
+    const double x[4] = { originX + length/2, originX - length/2,
+                          originX - length/2, originX + length/2 };
+    const double y[4] = { width/2, width/2, -width/2, -width/2 };
+    setPolygon(x, y, 4);
+  }
+
+  /// Set a convex polygon, corners counter clockwise, robot coordinates
+  void setPolygon ( const double * x, const double * y, int n )
+  {
+    if (n > MAXEDGES) n = MAXEDGES;
+    edges = n;
+    rmax = 0.;
+    for (int i=0; i<n; i++) {
+      const int j = (i + 1) % n;
+      // Outward normal of edge i->j
+      const double nx = y[j] - y[i], ny = x[i] - x[j];
+      const double len = hypot(nx, ny);
+      ex[i] = nx/len;
+      ey[i] = ny/len;
+      ec[i] = ex[i]*x[i] + ey[i]*y[i];
+      cx[i] = x[i];
+      cy[i] = y[i];
+      rmax = std::max(rmax, hypot(x[i], y[i]));
+    }
+  }
+
+  /// Radius of the circle around the center of rotation enclosing the footprint
+  double radius ( void ) const { return rmax; }
+
+  /// Drop all obstacle points
+  void clearPoints ( void ) { px.clear(); py.clear(); }
+
+  /// Add an obstacle point if it is within reach
+  /// @param reach Max distance of the point to the footprint in meters
+  void addPoint ( double x, double y, double reach )
+  {
+    if (x*x + y*y > (rmax + reach)*(rmax + reach)) return;
+    px.push_back((float)x);
+    py.push_back((float)y);
+  }
+
+  /// Add the end points of the valid ranges of a scan
+  void addScan ( const ScanFrame & scan, double rangeMin, double rangeMax,
+                 double reach )
+  {
+    const double * r = scan.ranges();
+    const double * x = scan.x();
+    const double * y = scan.y();
+    for (int i=0; i<scan.size(); i++)
+      if (r[i] > rangeMin && r[i] < rangeMax) addPoint(x[i], y[i], reach);
+  }
+
+  /// Number of obstacle points within reach
+  int points ( void ) const { return px.size(); }
+
+  /// True if the point lies inside the footprint at rest
+  bool inside ( double x, double y ) const
+  {
+    for (int e=0; e<edges; e++)
+      if (ex[e]*x + ey[e]*y > ec[e]) return false;
+    return true;
+  }
+
+  /// Sweep the footprint along the arc (v, w) starting at the robot pose.
+  /// @param v Speed in meters/sec
+  /// @param w Turnrate in rad/sec
+  /// @param horizon Time in seconds
+  /// @param res Max footprint motion per step in meters
+  /// @return Time of the first collision, horizon if there is none
+  double sweep ( double v, double w, double horizon, double res = 0.05 ) const
+  {
+    if (!near(v, w, horizon)) return horizon;
+    const double speed = fabs(v) + fabs(w)*rmax;
+    const int steps = speed > 0. ? (int)ceil(horizon*speed/res) : 0;
+    const double dt = steps > 0 ? horizon/steps : 0.;
+    for (int k=0; k<=steps; k++) {
+      const double t = k*dt;
+      double x, y, th;
+      arc(v, w, t, &x, &y, &th);
+      if (hit(x, y, th)) return t;
+    }
+    return horizon;
+  }
+
+  /// True if the arc (v, w) is free for the horizon
+  bool free ( double v, double w, double horizon, double res = 0.05 ) const
+  {
+    return sweep(v, w, horizon, res) >= horizon;
+  }
+
+  /// Time to collision of every obstacle point on the arc (v, w).
+  /// The times are kept per point, see collisionTimes().
+  /// @param v Speed in meters/sec
+  /// @param w Turnrate in rad/sec
+  /// @param horizon Max time in seconds
+  /// @param x,y Limiting point, unchanged if there is none
+  /// @return Min time to collision, horizon if there is none within it
+  double timeToCollision ( double v, double w, double horizon,
+                           double * x = 0, double * y = 0 ) const
+  {
+    const int n = px.size();
+    ttc.resize(n);
+    if (fabs(v) >= 1e3*fabs(w)) {
+      if (v == 0.) std::fill(ttc.begin(), ttc.end(), (float)horizon);
+      else ttcStraight(v, horizon);
+    } else {
+      ttcArc(v, w, horizon);
+    }
+    int best = -1;
+    float tmin = (float)horizon;
+    for (int i=0; i<n; i++) {
+      if (inside(px[i], py[i])) ttc[i] = 0.f;
+      if (ttc[i] < tmin) {
+        tmin = ttc[i];
+        best = i;
+      }
+    }
+    if (best >= 0) {
+      if (x) *x = px[best];
+      if (y) *y = py[best];
+    }
+    return tmin;
+  }
+
+  /// Times to collision per obstacle point of the last timeToCollision()
+  const float * collisionTimes ( void ) const { return ttc.empty() ? 0 : &ttc[0]; }
+
+  /// Pose after driving the arc (v, w) for t seconds
+  static void arc ( double v, double w, double t, double * x, double * y,
+                    double * th )
+  {
+    *th = w*t;
+    if (fabs(w) < 1e-6) {
+      *x = v*t;
+      *y = 0.;
+    } else {
+      *x = v/w*sin(*th);
+      *y = v/w*(1. - cos(*th));
+    }
+  }
+
+private:
+  int edges;
+  double ex[MAXEDGES], ey[MAXEDGES], ec[MAXEDGES]; ///< Half planes ex*x+ey*y<=ec
+  double cx[MAXEDGES], cy[MAXEDGES]; ///< Corners
+  double rmax;
+  std::vector<float> px, py; ///< Obstacle points
+  mutable std::vector<float> nx, ny; ///< Obstacle points near the current arc
+  mutable std::vector<float> ttc;    ///< Time to collision per obstacle point
+
+  /// Straight motion: points move along -x by v per second
+  void ttcStraight ( double v, double horizon ) const
+  {
+    const int n = px.size();
+    const float inv = (float)(1./v), h = (float)horizon;
+    int i = 0;
+#ifdef __SSE__
+    for (; i+4<=n; i+=4) {
+      const __m128 x4 = _mm_loadu_ps(&px[i]), y4 = _mm_loadu_ps(&py[i]);
+      __m128 t4 = _mm_set1_ps(h);
+      for (int e=0; e<edges; e++) {
+        const int f = (e + 1) % edges;
+        if (cy[f] == cy[e]) continue; // Parallel to the motion
+        // Crossing of the edge with the line through the point
+        const float k = (float)((cx[f] - cx[e])/(cy[f] - cy[e]));
+        const __m128 s = _mm_mul_ps(_mm_sub_ps(y4, _mm_set1_ps((float)cy[e])),
+                                    _mm_set1_ps((float)(1./(cy[f] - cy[e]))));
+        const __m128 xe = _mm_add_ps(_mm_set1_ps((float)cx[e]),
+            _mm_mul_ps(_mm_sub_ps(y4, _mm_set1_ps((float)cy[e])), _mm_set1_ps(k)));
+        const __m128 t = _mm_mul_ps(_mm_sub_ps(x4, xe), _mm_set1_ps(inv));
+        const __m128 ok = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(s, _mm_setzero_ps()),
+                                                _mm_cmple_ps(s, _mm_set1_ps(1.f))),
+                                     _mm_cmpge_ps(t, _mm_setzero_ps()));
+        t4 = _mm_min_ps(t4, _mm_or_ps(_mm_and_ps(ok, t), _mm_andnot_ps(ok, t4)));
+      }
+      _mm_storeu_ps(&ttc[i], t4);
+    }
+#endif
+    for (; i<n; i++) {
+      float t = h;
+      for (int e=0; e<edges; e++) {
+        const int f = (e + 1) % edges;
+        if (cy[f] == cy[e]) continue;
+        const double s = (py[i] - cy[e])/(cy[f] - cy[e]);
+        const double te = (px[i] - (cx[e] + s*(cx[f] - cx[e])))*inv;
+        if (s >= 0. && s <= 1. && te >= 0. && te < t) t = (float)te;
+      }
+      ttc[i] = t;
+    }
+  }
+
+  /// Monotonic in the angle of (x, y) over [0, 2pi), range [0, 4)
+  static float pseudoAngle ( float x, float y )
+  {
+    const float r = y/(fabsf(x) + fabsf(y) + 1e-20f);
+    return x < 0.f ? 2.f - r : (y < 0.f ? 4.f + r : r);
+  }
+
+  /// Arc: points rotate around the center (0, v/w) by -w per second. A point
+  /// q hits the footprint after the rotation from its first edge crossing r
+  /// on the circle through q, the angle of q*conj(r) (turning left) or
+  /// r*conj(q) (turning right).
+  void ttcArc ( double v, double w, double horizon ) const
+  {
+    const double R = v/w;
+    const float sg = w > 0. ? 1.f : -1.f;
+    const float h = (float)horizon, rate = (float)fabs(w);
+    // Edges relative to the center: a + s*d
+    float ax[MAXEDGES], ay[MAXEDGES], dx[MAXEDGES], dy[MAXEDGES];
+    float dd[MAXEDGES], ad[MAXEDGES], aa[MAXEDGES];
+    for (int e=0; e<edges; e++) {
+      const int f = (e + 1) % edges;
+      ax[e] = (float)cx[e];
+      ay[e] = (float)(cy[e] - R);
+      dx[e] = (float)(cx[f] - cx[e]);
+      dy[e] = (float)(cy[f] - cy[e]);
+      dd[e] = dx[e]*dx[e] + dy[e]*dy[e];
+      ad[e] = ax[e]*dx[e] + ay[e]*dy[e];
+      aa[e] = ax[e]*ax[e] + ay[e]*ay[e];
+    }
+    const int n = px.size();
+    int i = 0;
+#ifdef __SSE__
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+    const __m128 sign = _mm_set1_ps(-0.f);
+    for (; i+4<=n; i+=4) {
+      const __m128 qx = _mm_loadu_ps(&px[i]);
+      const __m128 qy = _mm_sub_ps(_mm_loadu_ps(&py[i]), _mm_set1_ps((float)R));
+      const __m128 rho2 = _mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy));
+      __m128 best = _mm_set1_ps(5.f), bx = zero, by = zero;
+      for (int e=0; e<edges; e++) {
+        const __m128 disc = _mm_sub_ps(_mm_set1_ps(ad[e]*ad[e]),
+            _mm_mul_ps(_mm_set1_ps(dd[e]), _mm_sub_ps(_mm_set1_ps(aa[e]), rho2)));
+        const __m128 real = _mm_cmpge_ps(disc, zero);
+        const __m128 sq = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+        for (int root=0; root<2; root++) {
+          const __m128 s = _mm_mul_ps(root ? _mm_sub_ps(_mm_set1_ps(-ad[e]), sq)
+                                           : _mm_add_ps(_mm_set1_ps(-ad[e]), sq),
+                                      _mm_set1_ps(1.f/dd[e]));
+          const __m128 ok = _mm_and_ps(real, _mm_and_ps(_mm_cmpge_ps(s, zero),
+                                                        _mm_cmple_ps(s, one)));
+          const __m128 rx = _mm_add_ps(_mm_set1_ps(ax[e]), _mm_mul_ps(s, _mm_set1_ps(dx[e])));
+          const __m128 ry = _mm_add_ps(_mm_set1_ps(ay[e]), _mm_mul_ps(s, _mm_set1_ps(dy[e])));
+          // Rotation from the crossing to the point
+          const __m128 ux = _mm_add_ps(_mm_mul_ps(qx, rx), _mm_mul_ps(qy, ry));
+          const __m128 uy = _mm_mul_ps(_mm_set1_ps(sg),
+              _mm_sub_ps(_mm_mul_ps(qy, rx), _mm_mul_ps(qx, ry)));
+          const __m128 ab = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign, ux),
+                                                  _mm_andnot_ps(sign, uy)),
+                                       _mm_set1_ps(1e-20f));
+          const __m128 r = _mm_div_ps(uy, ab);
+          const __m128 xneg = _mm_cmplt_ps(ux, zero), yneg = _mm_cmplt_ps(uy, zero);
+          __m128 pa = _mm_or_ps(_mm_and_ps(yneg, _mm_add_ps(_mm_set1_ps(4.f), r)),
+                                _mm_andnot_ps(yneg, r));
+          pa = _mm_or_ps(_mm_and_ps(xneg, _mm_sub_ps(_mm_set1_ps(2.f), r)),
+                         _mm_andnot_ps(xneg, pa));
+          const __m128 upd = _mm_and_ps(ok, _mm_cmplt_ps(pa, best));
+          best = _mm_or_ps(_mm_and_ps(upd, pa), _mm_andnot_ps(upd, best));
+          bx = _mm_or_ps(_mm_and_ps(upd, ux), _mm_andnot_ps(upd, bx));
+          by = _mm_or_ps(_mm_and_ps(upd, uy), _mm_andnot_ps(upd, by));
+        }
+      }
+      float b[4], ux[4], uy[4];
+      _mm_storeu_ps(b, best);
+      _mm_storeu_ps(ux, bx);
+      _mm_storeu_ps(uy, by);
+      for (int k=0; k<4; k++)
+        ttc[i+k] = b[k] < 5.f ? std::min(h, rotation(ux[k], uy[k])/rate) : h;
+    }
+#endif
+    for (; i<n; i++) {
+      const float qx = px[i], qy = (float)(py[i] - R);
+      const float rho2 = qx*qx + qy*qy;
+      float best = 5.f, bx = 0.f, by = 0.f;
+      for (int e=0; e<edges; e++) {
+        const float disc = ad[e]*ad[e] - dd[e]*(aa[e] - rho2);
+        if (disc < 0.f) continue;
+        const float sq = sqrtf(disc);
+        for (int root=0; root<2; root++) {
+          const float s = (-ad[e] + (root ? -sq : sq))/dd[e];
+          if (s < 0.f || s > 1.f) continue;
+          const float rx = ax[e] + s*dx[e], ry = ay[e] + s*dy[e];
+          const float ux = qx*rx + qy*ry, uy = sg*(qy*rx - qx*ry);
+          const float pa = pseudoAngle(ux, uy);
+          if (pa < best) {
+            best = pa;
+            bx = ux;
+            by = uy;
+          }
+        }
+      }
+      ttc[i] = best < 5.f ? std::min(h, rotation(bx, by)/rate) : h;
+    }
+  }
+
+  /// Angle of (x, y) in [0, 2pi)
+  static float rotation ( float x, float y )
+  {
+    const float a = atan2f(y, x);
+    return a < 0.f ? a + (float)(2.*M_PI) : a;
+  }
+
+  /// Collect the points the footprint can reach on the arc
+  /// @return False if there are none
+  bool near ( double v, double w, double horizon ) const
+  {
+    const int n = px.size();
+    nx.clear();
+    ny.clear();
+    if (fabs(v) >= 1e3*fabs(w)) {
+      // Straight: a band along x
+      const double x0 = std::min(0., v*horizon) - rmax;
+      const double x1 = std::max(0., v*horizon) + rmax;
+      for (int i=0; i<n; i++)
+        if (fabs(py[i]) <= rmax && px[i] >= x0 && px[i] <= x1) {
+          nx.push_back(px[i]);
+          ny.push_back(py[i]);
+        }
+    } else {
+      // Ring around the center of the arc (a circle when turning in place)
+      const double R = v/w;
+      const double lo = std::max(0., fabs(R) - rmax), hi = fabs(R) + rmax;
+      for (int i=0; i<n; i++) {
+        const double dx = px[i], dy = py[i] - R;
+        const double d2 = dx*dx + dy*dy;
+        if (d2 >= lo*lo && d2 <= hi*hi) {
+          nx.push_back(px[i]);
+          ny.push_back(py[i]);
+        }
+      }
+    }
+    return !nx.empty();
+  }
+
+  /// Any point inside the footprint at pose (x, y, th)?
+  bool hit ( double x, double y, double th ) const
+  {
+    const double c = cos(th), s = sin(th);
+    float a[MAXEDGES], b[MAXEDGES], k[MAXEDGES];
+    for (int e=0; e<edges; e++) {
+      // Edge normal rotated into the start frame, offset moved to the pose
+      a[e] = (float)(ex[e]*c - ey[e]*s);
+      b[e] = (float)(ex[e]*s + ey[e]*c);
+      k[e] = (float)(ec[e] + a[e]*x + b[e]*y);
+    }
+    const int n = nx.size();
+    int i = 0;
+#ifdef __SSE__
+    for (; i+4<=n; i+=4) {
+      const __m128 x4 = _mm_loadu_ps(&nx[i]);
+      const __m128 y4 = _mm_loadu_ps(&ny[i]);
+      __m128 in = _mm_cmpeq_ps(x4, x4); // All set
+      for (int e=0; e<edges; e++) {
+        const __m128 d = _mm_add_ps(_mm_mul_ps(x4, _mm_set1_ps(a[e])),
+                                    _mm_mul_ps(y4, _mm_set1_ps(b[e])));
+        in = _mm_and_ps(in, _mm_cmple_ps(d, _mm_set1_ps(k[e])));
+      }
+      if (_mm_movemask_ps(in)) return true;
+    }
+#endif
+    for (; i<n; i++) {
+      int e = 0;
+      while (e<edges && a[e]*nx[i] + b[e]*ny[i] <= k[e]) e++;
+      if (e == edges) return true;
+    }
+    return false;
+  }
+};
+
+#endif
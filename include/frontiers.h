@@ -0,0 +1,247 @@
+/// @file frontiers.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Frontiers of an online GridMap for exploration after Yamauchi: free cells
+/// next to unknown ones (4-neighbourhood), the border of what the laser has
+/// seen. They are kept incrementally: after a scan only the cells whose
+/// state it changed (GridMap::changedCells) and their neighbours are checked
+/// again. Frontier cells are a list with the list position stored per cell,
+/// so adding and removing is constant time.
+/// For a target the frontier cells are clustered (8-connected), small
+/// clusters dropped, and every cluster is represented by its cell closest to
+/// the centroid. One Dijkstra search from the robot over the C-space gives
+/// the path cost to the clusters; the target is the cluster of most frontier
+/// length per path length.
+///
+#ifndef FRONTIERS_H
+#define FRONTIERS_H
+
+#include <cmath>
+#include <vector>
+#include <queue>
+#include <functional>
+#include "gridmap.h"
+#include "costmap.h"
+
+/// Cluster of frontier cells
+struct ts_Frontier {
+  int    cx, cy; ///< Target cell, the cell closest to the centroid
+  double x, y;   ///< Target cell center in meters
+  int    size;   ///< Frontier cells
+  double cost;   ///< Path cost from the robot in meters, negative if unreachable
+  double score;  ///< Frontier length per path length
+};
+
+class Frontiers {
+public:
+  /// @param minSize Cells of the smallest cluster
+  Frontiers(int minSize = 8) : minSize(minSize), w(0), h(0), stamp(0) {}
+
+  /// Update the frontiers with the cells the latest scan changed, all
+  /// cells when the map is new
+  void update ( const GridMap & map )
+  {
+    if (map.width() != w || map.height() != h) {
+      rebuild(map);
+      return;
+    }
+    const std::vector<int> & changed = map.changedCells();
+    for (unsigned int i=0; i<changed.size(); i++) {
+      const int cx = changed[i] % w, cy = changed[i] / w;
+      check(map, cx, cy);
+      check(map, cx + 1, cy);
+      check(map, cx - 1, cy);
+      check(map, cx, cy + 1);
+      check(map, cx, cy - 1);
+    }
+  }
+
+  /// Find all frontiers of a map
+  void rebuild ( const GridMap & map )
+  {
+    w = map.width();
+    h = map.height();
+    pos.assign(w*h, -1);
+    cells.clear();
+    label.assign(w*h, 0);
+    stamp = 0;
+    for (int cy=0; cy<h; cy++)
+      for (int cx=0; cx<w; cx++) check(map, cx, cy);
+  }
+
+  /// Cluster the frontiers and rate the clusters from the robot position
+  /// @param costs C-space of the map
+  /// @param x,y Robot position in meters
+  /// @return Index of the best cluster in clusters(), -1 if none reachable
+  int select ( const CostMap & costs, double x, double y )
+  {
+    cluster();
+    if (groups.empty()) return -1;
+    pathCosts(costs, costs.cellX(x), costs.cellY(y));
+    int best = -1;
+    for (unsigned int i=0; i<groups.size(); i++) {
+      ts_Frontier & f = groups[i];
+      if (f.cost < 0.) continue;
+      f.score = f.size*costs.resolution()/(f.cost + costs.resolution());
+      if (best < 0 || f.score > groups[best].score) best = i;
+    }
+    return best;
+  }
+
+  /// Clusters of the last select()
+  const std::vector<ts_Frontier> & clusters ( void ) const { return groups; }
+  /// True if a cell is a frontier
+  bool isFrontier ( int cx, int cy ) const
+  {
+    return (unsigned)cx < (unsigned)w && (unsigned)cy < (unsigned)h && pos[cy*w + cx] >= 0;
+  }
+  /// Frontier cells
+  int size ( void ) const { return cells.size(); }
+
+private:
+  int minSize;
+  int w, h;
+  std::vector<int> pos;   ///< Position in cells, -1 if no frontier
+  std::vector<int> cells; ///< Frontier cells
+  std::vector<int> label; ///< Stamp of the search that visited a cell
+  int stamp;
+  std::vector<ts_Frontier> groups; ///< Clusters
+  std::vector<int> queue;          ///< Cells to visit
+  std::vector<float> dist;         ///< Path cost of the visited cells
+
+  static bool unknown ( const GridMap & map, int cx, int cy )
+  {
+    return map.inside(cx, cy) && map.state(cx, cy) == 0;
+  }
+
+  /// Add or remove a cell by its state and its neighbours'
+  void check ( const GridMap & map, int cx, int cy )
+  {
+    if (!map.inside(cx, cy)) return;
+    const bool f = map.state(cx, cy) < 0 &&
+      (unknown(map, cx + 1, cy) || unknown(map, cx - 1, cy) ||
+       unknown(map, cx, cy + 1) || unknown(map, cx, cy - 1));
+    const int i = cy*w + cx;
+    if (f && pos[i] < 0) {
+      pos[i] = cells.size();
+      cells.push_back(i);
+    } else if (!f && pos[i] >= 0) {
+      // Move the last cell into the gap
+      const int last = cells.back();
+      cells[pos[i]] = last;
+      pos[last] = pos[i];
+      cells.pop_back();
+      pos[i] = -1;
+    }
+  }
+
+  /// Next search stamp, labels are cleared when it wraps
+  int nextStamp ( void )
+  {
+    if (++stamp == 0x7fffffff) {
+      std::fill(label.begin(), label.end(), 0);
+      stamp = 1;
+    }
+    return stamp;
+  }
+
+  /// 8-connected clusters of the frontier cells
+  void cluster ( void )
+  {
+    groups.clear();
+    const int s = nextStamp();
+    for (unsigned int k=0; k<cells.size(); k++) {
+      if (label[cells[k]] == s) continue;
+      label[cells[k]] = s;
+      queue.assign(1, cells[k]);
+      double sx = 0., sy = 0.;
+      for (unsigned int q=0; q<queue.size(); q++) {
+        const int cx = queue[q] % w, cy = queue[q] / w;
+        sx += cx;
+        sy += cy;
+        for (int dy=-1; dy<=1; dy++)
+          for (int dx=-1; dx<=1; dx++) {
+            const int nx = cx + dx, ny = cy + dy;
+            if (!isFrontier(nx, ny) || label[ny*w + nx] == s) continue;
+            label[ny*w + nx] = s;
+            queue.push_back(ny*w + nx);
+          }
+      }
+      const int n = queue.size();
+      if (n < minSize) continue;
+      sx /= n;
+      sy /= n;
+      ts_Frontier f;
+      f.cx = f.cy = 0;
+      double best = -1.;
+      for (int q=0; q<n; q++) {
+        const int cx = queue[q] % w, cy = queue[q] / w;
+        const double d = (cx - sx)*(cx - sx) + (cy - sy)*(cy - sy);
+        if (best < 0. || d < best) { best = d; f.cx = cx; f.cy = cy; }
+      }
+      f.x = f.y = 0.;
+      f.size = n;
+      f.cost = -1.;
+      f.score = 0.;
+      groups.push_back(f);
+    }
+  }
+
+  /// Dijkstra from (sx, sy) over the known cells. A move costs its length
+  /// times 1 plus 3 at the highest inflation cost, 50 into inscribed cells;
+  /// lethal and unknown cells are not entered.
+  void pathCosts ( const CostMap & costs, int sx, int sy )
+  {
+    const double res = costs.resolution();
+    for (unsigned int i=0; i<groups.size(); i++) {
+      groups[i].x = costs.originx() + (groups[i].cx + 0.5)*res;
+      groups[i].y = costs.originy() + (groups[i].cy + 0.5)*res;
+    }
+    if (!costs.inside(sx, sy)) return;
+    float step[256];
+    for (int c=0; c<256; c++) step[c] = (float)(1. + 3.*c/CostMap::MAXCOST);
+    step[CostMap::INSCRIBED] = 50.f;
+    dist.resize(w*h);
+    const int s = nextStamp(); // Cells labelled s have a cost in dist
+    typedef std::pair<float, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+    dist[sy*w + sx] = 0.f;
+    label[sy*w + sx] = s;
+    open.push(Entry(0.f, sy*w + sx));
+    while (!open.empty()) {
+      const Entry e = open.top();
+      open.pop();
+      const int i = e.second;
+      if (e.first > dist[i]) continue;
+      const int cx = i % w, cy = i / w;
+      for (int dy=-1; dy<=1; dy++)
+        for (int dx=-1; dx<=1; dx++) {
+          const int nx = cx + dx, ny = cy + dy;
+          if ((dx == 0 && dy == 0) || !costs.inside(nx, ny)) continue;
+          const unsigned char c = costs.at(nx, ny);
+          if (c == CostMap::LETHAL || c == CostMap::UNKNOWN) continue;
+          const float d = e.first + (dx && dy ? (float)M_SQRT2 : 1.f)*step[c];
+          const int n = ny*w + nx;
+          if (label[n] == s && d >= dist[n]) continue;
+          label[n] = s;
+          dist[n] = d;
+          open.push(Entry(d, n));
+        }
+    }
+    for (unsigned int i=0; i<groups.size(); i++) {
+      const int n = groups[i].cy*w + groups[i].cx;
+      groups[i].cost = label[n] == s ? dist[n]*res : -1.;
+    }
+  }
+
+  Frontiers(const Frontiers &);
+  Frontiers & operator= (const Frontiers &);
+};
+
+#endif
@@ -0,0 +1,268 @@
+/// @file gridmap.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Occupancy grid map built online from laser scans at known poses.
+/// Every beam is traced with integer line traversal from the laser to its
+/// end point, lowering the log odds of the cells passed and raising the one
+/// hit. Log odds are shorts in hundredths, stored in a TileMap of 64x64
+/// cell tiles (8 KB) allocated when first seen, so a large floor costs
+/// memory only where it was explored.
+/// The cells whose state (occupied, free, unknown) a scan changed are kept
+/// until the next scan, so map users can update incrementally, and the
+/// known cells are counted.
+/// Maps are written as 8 bit gray PNG in the convention of Player's mapfile
+/// driver (see pnav_ex/*_navloc.cfg): occupied black, free white, unknown
+/// gray, first row at the top. Map images (PNG or binary PGM) are read with
+/// the driver's thresholds.
+///
+#ifndef GRIDMAP_H
+#define GRIDMAP_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <vector>
+#include <algorithm>
+#include <png.h>
+#include "scanframe.h"
+#include "tilemap.h"
+
+class GridMap {
+public:
+  static const short LOGMAX   = 500;         ///< Log odds clamp
+  static const short HIT      = 85;          ///< Log odds of a hit, p = 0.7
+  static const short MISS     = -40;         ///< Log odds of a pass, p = 0.4
+  static const short OCCUPIED = 100;         ///< Log odds above: occupied
+  static const short FREE     = -100;        ///< Log odds below: free
+
+  /// @param width,height Size in meters
+  /// @param res Cell size in meters
+  /// @param originX,originY Position of the lower left corner in meters
+  GridMap(double width = 16., double height = 16., double res = 0.08,
+          double originX = -8., double originY = -8.)
+    : w((int)ceil(width/res - 1e-9)), h((int)ceil(height/res - 1e-9)),
+      res(res), originX(originX), originY(originY), known(0) {}
+
+  void clear ( void )
+  {
+    cells.clear();
+    changed.clear();
+    known = 0;
+  }
+
+  /// Integrate a scan taken at the robot pose (x, y, yaw).
+  /// Max ranges only clear up to rangeMax.
+  void addScan ( const ScanFrame & scan, double rangeMin, double rangeMax,
+                 double x, double y, double yaw )
+  {
+    changed.clear();
+    const double c = cos(yaw), s = sin(yaw);
+    const int lx = cellX(x + c*scan.mountX()), ly = cellY(y + s*scan.mountX());
+    if (!inside(lx, ly)) return;
+    const double * r = scan.ranges();
+    for (int i=0; i<scan.size(); i++) {
+      if (r[i] <= rangeMin) continue;
+      double bx = scan.x()[i], by = scan.y()[i];
+      const bool hit = r[i] < rangeMax;
+      if (!hit) {
+        const double a = scan.angle(i);
+        bx = scan.mountX() + rangeMax*cos(a);
+        by = rangeMax*sin(a);
+      }
+      trace(lx, ly, cellX(x + c*bx - s*by), cellY(y + s*bx + c*by), hit);
+    }
+  }
+
+  /// Occupancy of a cell: 1 occupied, -1 free, 0 unknown (Player's map
+  /// convention)
+  int state ( int cx, int cy ) const
+  {
+    return state(cells.get(cx, cy));
+  }
+  short logOdds ( int cx, int cy ) const { return cells.get(cx, cy); }
+
+  int cellX ( double x ) const { return (int)floor((x - originX)/res); }
+  int cellY ( double y ) const { return (int)floor((y - originY)/res); }
+  bool inside ( int cx, int cy ) const
+  {
+    return (unsigned)cx < (unsigned)w && (unsigned)cy < (unsigned)h;
+  }
+
+  int width ( void ) const { return w; }
+  int height ( void ) const { return h; }
+  double resolution ( void ) const { return res; }
+  double originx ( void ) const { return originX; }
+  double originy ( void ) const { return originY; }
+  /// Memory of the cells in bytes
+  size_t bytes ( void ) const { return cells.bytes(); }
+  /// Log odds storage
+  const TileMap<short> & storage ( void ) const { return cells; }
+  /// Cells (cy*width + cx) whose state the last scan changed
+  const std::vector<int> & changedCells ( void ) const { return changed; }
+  /// Cells known to be occupied or free
+  int knownCells ( void ) const { return known; }
+  /// Area known to be occupied or free in square meters
+  double knownArea ( void ) const { return known*res*res; }
+
+  /// Replace the map by a map image as the mapfile driver reads it: pixels
+  /// with an occupancy (255 - gray)/255 above 0.95 occupied, below 0.1 free,
+  /// others unknown.
+  /// @param path PNG or binary PGM file
+  /// @param res Pixel size in meters
+  /// @param originX,originY Position of the lower left corner in meters
+  /// @return False if the file could not be read
+  bool readImage ( const char * path, double res, double originX, double originY )
+  {
+    std::vector<unsigned char> gray;
+    int iw = 0, ih = 0;
+    FILE * fp = fopen(path, "rb");
+    if (!fp) return false;
+    unsigned char magic[8] = { 0 };
+    const bool ok = fread(magic, 1, 8, fp) == 8 && (png_sig_cmp(magic, 0, 8) == 0
+        ? readPng(fp, gray, &iw, &ih) : (rewind(fp), readPgm(fp, gray, &iw, &ih)));
+    fclose(fp);
+    if (!ok) return false;
+    w = iw;
+    h = ih;
+    this->res = res;
+    this->originX = originX;
+    this->originY = originY;
+    clear();
+    for (int y=0; y<h; y++)
+      for (int x=0; x<w; x++) {
+        const double occ = (255 - gray[(h - 1 - y)*w + x])/255.;
+        if (occ > 0.95) cells.at(x, y) = LOGMAX;
+        else if (occ < 0.1) cells.at(x, y) = -LOGMAX;
+        else continue;
+        known++;
+      }
+    return true;
+  }
+
+  /// Write the map as PNG for the mapfile driver
+  /// @return False if the file could not be written
+  bool writePng ( const char * path ) const
+  {
+    FILE * fp = fopen(path, "wb");
+    if (!fp) return false;
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+    png_infop info = png ? png_create_info_struct(png) : 0;
+    if (!info || setjmp(png_jmpbuf(png))) {
+      png_destroy_write_struct(&png, info ? &info : 0);
+      fclose(fp);
+      return false;
+    }
+    png_init_io(png, fp);
+    png_set_IHDR(png, info, w, h, 8, PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+        PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    // Unknown everywhere but the allocated tiles
+    std::vector<png_byte> image(w*h, 128);
+    const int tile = TileMap<short>::TILE;
+    for (TileMap<short>::Tiles t(cells); t.valid(); t.next())
+      for (int y=0; y<tile; y++) {
+        const int cy = t.y()*tile + y;
+        if (cy < 0 || cy >= h) continue;
+        for (int x=0; x<tile; x++) {
+          const int cx = t.x()*tile + x;
+          if (cx < 0 || cx >= w) continue;
+          const int st = state((*t)[y*tile + x]);
+          image[(h - 1 - cy)*w + cx] = st > 0 ? 0 : (st < 0 ? 255 : 128);
+        }
+      }
+    for (int y=0; y<h; y++) png_write_row(png, &image[y*w]);
+    png_write_end(png, info);
+    png_destroy_write_struct(&png, &info);
+    return fclose(fp) == 0;
+  }
+
+private:
+  int w, h; ///< Size in cells
+  double res, originX, originY;
+  TileMap<short> cells; ///< Log odds
+  std::vector<int> changed; ///< Cells whose state the last scan changed
+  int known;                ///< Cells not unknown
+
+  static int state ( short l ) { return l > OCCUPIED ? 1 : (l < FREE ? -1 : 0); }
+
+  /// 8 bit gray pixels of a PNG, the signature already read
+  static bool readPng ( FILE * fp, std::vector<unsigned char> & gray, int * iw, int * ih )
+  {
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+    png_infop info = png ? png_create_info_struct(png) : 0;
+    if (!info || setjmp(png_jmpbuf(png))) {
+      png_destroy_read_struct(&png, info ? &info : 0, 0);
+      return false;
+    }
+    png_init_io(png, fp);
+    png_set_sig_bytes(png, 8);
+    png_read_info(png, info);
+    const int type = png_get_color_type(png, info);
+    if (type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
+    if (type == PNG_COLOR_TYPE_GRAY) png_set_expand_gray_1_2_4_to_8(png);
+    if (type & PNG_COLOR_MASK_COLOR) png_set_rgb_to_gray_fixed(png, 1, -1, -1);
+    if (type & PNG_COLOR_MASK_ALPHA) png_set_strip_alpha(png);
+    png_set_strip_16(png);
+    png_read_update_info(png, info);
+    *iw = png_get_image_width(png, info);
+    *ih = png_get_image_height(png, info);
+    gray.resize(*iw * *ih);
+    for (int y=0; y<*ih; y++) png_read_row(png, &gray[y * *iw], 0);
+    png_read_end(png, 0);
+    png_destroy_read_struct(&png, &info, 0);
+    return true;
+  }
+
+  /// 8 bit gray pixels of a binary PGM
+  static bool readPgm ( FILE * fp, std::vector<unsigned char> & gray, int * iw, int * ih )
+  {
+    char magic[3] = { 0 };
+    int maxval = 0;
+    if (fscanf(fp, "%2s", magic) != 1 || strcmp(magic, "P5")) return false;
+    int * fields[3] = { iw, ih, &maxval };
+    for (int f=0; f<3; f++) {
+      int c;
+      while ((c = fgetc(fp)) == '#' || isspace(c))
+        if (c == '#') while ((c = fgetc(fp)) != '\n' && c != EOF) {}
+      ungetc(c, fp);
+      if (fscanf(fp, "%d", fields[f]) != 1) return false;
+    }
+    fgetc(fp); // Single white space before the pixels
+    if (*iw <= 0 || *ih <= 0 || maxval <= 0 || maxval > 255) return false;
+    gray.resize(*iw * *ih);
+    if (fread(&gray[0], 1, gray.size(), fp) != gray.size()) return false;
+    for (unsigned int i=0; i<gray.size(); i++) gray[i] = gray[i]*255/maxval;
+    return true;
+  }
+
+  /// Add log odds to the cell (cx, cy) stored in c
+  void add ( int cx, int cy, short & c, short odds )
+  {
+    const int before = state(c);
+    const int l = c + odds;
+    c = (short)(l > LOGMAX ? LOGMAX : (l < -LOGMAX ? -LOGMAX : l));
+    const int after = state(c);
+    if (after == before) return;
+    changed.push_back(cy*w + cx);
+    if (before == 0) known++;
+    else if (after == 0) known--;
+  }
+
+  /// Lower the cells from (x0, y0) to before (x1, y1), raise (x1, y1) if hit
+  void trace ( int x0, int y0, int x1, int y1, bool hit )
+  {
+    for (TileMap<short>::Ray r(cells, x0, y0, x1, y1); r.valid(); r.next()) {
+      if (!inside(r.x(), r.y())) return;
+      add(r.x(), r.y(), *r, r.last() && hit ? HIT : MISS);
+    }
+  }
+};
+
+#endif
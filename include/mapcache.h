@@ -0,0 +1,140 @@
+/// @file mapcache.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Files caching data derived from a map (distance transform, C-space),
+/// named after a hash of the map's content and the derivation parameters.
+/// A file is a 64 byte header (kind, version, geometry, key) followed by
+/// one value per cell, row by row. Reading memory maps the file read only,
+/// so a cached map is in use without being read or copied and its pages
+/// are shared by all processes using it. Files are written to a temporary
+/// name and renamed, so a reader never maps a partial one.
+///
+#ifndef MAPCACHE_H
+#define MAPCACHE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gridmap.h"
+
+class MapCache {
+public:
+  /// File header
+  struct Header {
+    char kind[8];       ///< What the file holds, e.g. "EDTCACHE"
+    int version, w, h;
+    int cellSize;       ///< Bytes per cell
+    double res, originX, originY;
+    unsigned long long key; ///< Hash of the map and the parameters
+    char reserved[64 - 8 - 4*4 - 3*8 - 8];
+  };
+
+  MapCache() : p(0), size(0) {}
+  ~MapCache() { close(); }
+
+  /// Header of a file for a map
+  static Header header ( const char * kind, int version, const GridMap & map,
+                         int cellSize, unsigned long long key )
+  {
+    Header hd;
+    memset(&hd, 0, sizeof(hd));
+    memcpy(hd.kind, kind, std::min(strlen(kind), sizeof(hd.kind)));
+    hd.version = version;
+    hd.w = map.width();
+    hd.h = map.height();
+    hd.cellSize = cellSize;
+    hd.res = map.resolution();
+    hd.originX = map.originx();
+    hd.originY = map.originy();
+    hd.key = key;
+    return hd;
+  }
+
+  /// Cache file name of a kind and key
+  static std::string file ( const char * dir, const char * prefix, unsigned long long key )
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "/%s-%016llx.bin", prefix, key);
+    return std::string(dir) + name;
+  }
+
+  /// Map a file if its header equals the expected one
+  bool open ( const char * path, const Header & expect )
+  {
+    close();
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    void * m = MAP_FAILED;
+    const size_t bytes = sizeof(Header) + (size_t)expect.w*expect.h*expect.cellSize;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == bytes)
+      m = mmap(0, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) return false;
+    if (memcmp(m, &expect, sizeof(Header)) != 0) {
+      munmap(m, bytes);
+      return false;
+    }
+    p = m;
+    size = bytes;
+    return true;
+  }
+
+  void close ( void )
+  {
+    if (p) munmap(p, size);
+    p = 0;
+    size = 0;
+  }
+
+  /// True if a file is mapped
+  bool mapped ( void ) const { return p != 0; }
+  /// Cell values of the mapped file
+  const void * data ( void ) const { return static_cast<const char *>(p) + sizeof(Header); }
+
+  /// Write a file, creating the directory if missing
+  static bool write ( const char * dir, const char * path, const Header & hd,
+                      const void * data )
+  {
+    mkdir(dir, 0755);
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    FILE * fp = fopen(tmp, "wb");
+    if (!fp) return false;
+    const size_t cells = (size_t)hd.w*hd.h;
+    bool ok = fwrite(&hd, sizeof(hd), 1, fp) == 1 &&
+      fwrite(data, hd.cellSize, cells, fp) == cells;
+    ok = fclose(fp) == 0 && ok;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) remove(tmp);
+    return ok;
+  }
+
+  /// FNV-1a hash step
+  static unsigned long long fnv ( unsigned long long k, const void * data, size_t n )
+  {
+    const unsigned char * b = static_cast<const unsigned char *>(data);
+    for (size_t i=0; i<n; i++) k = (k ^ b[i])*1099511628211ULL;
+    return k;
+  }
+
+private:
+  void * p;     ///< Mapping, 0 if none
+  size_t size;
+
+  MapCache(const MapCache &);
+  MapCache & operator= (const MapCache &);
+};
+
+#endif
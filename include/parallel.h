@@ -0,0 +1,54 @@
+/// @file parallel.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Runs independent lines of a grid (rows, columns) on several threads.
+/// The lines are split in equal contiguous ranges, one per thread; the
+/// calling thread takes the first range and any range a thread could not be
+/// started for.
+///
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+
+/// Line range of one thread
+struct ts_LineJob {
+  void (*fn)(void *, int, int);
+  void * arg;
+  int first, last;
+};
+
+inline void * lineJobRun ( void * job )
+{
+  const ts_LineJob & j = *static_cast<ts_LineJob *>(job);
+  j.fn(j.arg, j.first, j.last);
+  return 0;
+}
+
+/// Call fn(arg, first, last) for ranges covering [0, lines)
+inline void parallelLines ( int lines, int threads, void (*fn)(void *, int, int), void * arg )
+{
+  const int nt = std::max(1, std::min(threads, lines));
+  std::vector<ts_LineJob> jobs(nt);
+  std::vector<pthread_t> tid(nt);
+  for (int t=0; t<nt; t++) {
+    ts_LineJob j = { fn, arg, lines*t/nt, lines*(t + 1)/nt };
+    jobs[t] = j;
+  }
+  int started = 0;
+  for (int t=1; t<nt; t++, started++)
+    if (pthread_create(&tid[t], 0, lineJobRun, &jobs[t]) != 0) break;
+  lineJobRun(&jobs[0]);
+  for (int t=started + 1; t<nt; t++) lineJobRun(&jobs[t]);
+  for (int t=1; t<=started; t++) pthread_join(tid[t], 0);
+}
+
+#endif
@@ -0,0 +1,380 @@
+/// @file particlefilter.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Monte Carlo localization in a static map, the job of Player's amcl driver
+/// (see pnav_ex/pnav_navloc.cfg) done in process and sized for tens of
+/// thousands of particles at the laser rate.
+/// Particles are kept as structure of arrays (x, y, yaw, weight in separate
+/// float vectors) so the measurement update runs over four particles at once
+/// with SSE2. The beam model is a likelihood field: the log likelihood of a
+/// beam end point is precomputed per map cell from the distance to the
+/// closest obstacle, so a beam costs a transform and one table lookup. Only
+/// a subsample of the beams is used. The field has a border of one cell
+/// which takes the end points off the map. Neighbouring beams are not
+/// independent, so a scan's log likelihood is scaled down to that of a few
+/// independent beams; without it the weights of a global start collapse on
+/// the first update.
+/// Motion is sampled from the odometry model (initial turn, translation,
+/// final turn, each with noise growing with the motion). Resampling is low
+/// variance (systematic); the number of particles drawn adapts by KLD
+/// sampling to the number of 0.5 m x 0.5 m x 10 deg bins the posterior
+/// occupies, so a converged filter runs with the minimum count.
+///
+#ifndef PARTICLEFILTER_H
+#define PARTICLEFILTER_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "scanframe.h"
+#include "distancemap.h"
+
+class ParticleFilter {
+public:
+  /// @param minParticles,maxParticles Particle count range of KLD sampling
+  /// @param beams Beams used per update at most, evenly subsampled
+  /// @param sigma Likelihood field std. deviation in meters
+  /// @param zHit,zRand Weights of the hit and the random measurement
+  ParticleFilter(int minParticles = 500, int maxParticles = 50000, int beams = 60,
+                 double sigma = 0.2, double zHit = 0.95, double zRand = 0.05)
+    : minN(minParticles), maxN(maxParticles), beams(beams), sigma(sigma),
+      zHit(zHit), zRand(zRand), n(0), fw(0), fh(0), seed(88172645463325252ULL),
+      spare(0.), hasSpare(false)
+  {
+    setNoise(0.2, 0.2, 0.2, 0.2);
+    setKld(0.05, 2.33, 0.5, 10.*M_PI/180.);
+    setIndependentBeams(15);
+    px.resize(maxN); py.resize(maxN); pyaw.resize(maxN); pw.resize(maxN);
+    pc.resize(maxN); ps.resize(maxN); lw.resize(maxN);
+  }
+
+  /// Odometry noise as in amcl: rotation from rotation, rotation from
+  /// translation, translation from translation, translation from rotation
+  void setNoise ( double a1, double a2, double a3, double a4 )
+  {
+    alpha[0] = a1; alpha[1] = a2; alpha[2] = a3; alpha[3] = a4;
+  }
+
+  /// KLD sampling as in amcl
+  /// @param err Bound of the KL divergence to the posterior
+  /// @param z Upper standard normal quantile of the bound's probability
+  /// @param xy,yaw Bin size in meters and radians
+  void setKld ( double err, double z, double xy, double yaw )
+  {
+    kldErr = err; kldZ = z; binXY = xy; binYaw = yaw;
+  }
+
+  /// Number of independent beams a scan counts as
+  void setIndependentBeams ( int k ) { independent = k; }
+
+  /// Precompute the likelihood field of a map
+  void setMap ( const GridMap & map )
+  {
+    DistanceMap dist;
+    dist.compute(map);
+    setMap(map, dist);
+  }
+
+  /// Precompute the likelihood field of a map from its obstacle distances,
+  /// e.g. a cached transform
+  void setMap ( const GridMap & map, const DistanceMap & dist )
+  {
+    res = map.resolution();
+    originX = map.originx();
+    originY = map.originy();
+    fw = map.width() + 2;
+    fh = map.height() + 2;
+    const float * d = dist.data();
+    const double k = 1./(2.*sigma*sigma);
+    lmin = (float)log(zRand);
+    field.assign(fw*fh, lmin);
+    for (int y=0; y<map.height(); y++)
+      for (int x=0; x<map.width(); x++) {
+        const double dd = d[y*map.width() + x];
+        field[(y + 1)*fw + x + 1] = (float)log(zHit*exp(-k*dd*dd) + zRand);
+      }
+    freeCells.clear();
+    for (int y=0; y<map.height(); y++)
+      for (int x=0; x<map.width(); x++)
+        if (map.state(x, y) < 0) freeCells.push_back(y*map.width() + x);
+    mapW = map.width();
+  }
+
+  /// Start with maxParticles gaussian around a pose
+  void init ( double x, double y, double yaw, double sxy, double syaw )
+  {
+    n = maxN;
+    for (int i=0; i<n; i++) {
+      px[i] = (float)(x + sxy*gauss());
+      py[i] = (float)(y + sxy*gauss());
+      pyaw[i] = (float)normalize(yaw + syaw*gauss());
+      pw[i] = 1.f/n;
+    }
+  }
+
+  /// Start with maxParticles spread over the free cells of the map
+  void initGlobal ( void )
+  {
+    if (freeCells.empty()) return;
+    n = maxN;
+    const int cells = freeCells.size();
+    for (int i=0; i<n; i++) {
+      const int c = freeCells[std::min((int)(uniform()*cells), cells - 1)];
+      px[i] = (float)(originX + (c % mapW + uniform())*res);
+      py[i] = (float)(originY + (c / mapW + uniform())*res);
+      pyaw[i] = (float)((2.*uniform() - 1.)*M_PI);
+      pw[i] = 1.f/n;
+    }
+  }
+
+  /// Move the particles by the odometry change from (x0, y0, yaw0) to
+  /// (x1, y1, yaw1)
+  void predict ( double x0, double y0, double yaw0, double x1, double y1, double yaw1 )
+  {
+    const double dx = x1 - x0, dy = y1 - y0;
+    const double trans = sqrt(dx*dx + dy*dy);
+    // The initial turn is meaningless when turning on the spot
+    const double rot1 = trans < 0.01 ? 0. : normalize(atan2(dy, dx) - yaw0);
+    const double rot2 = normalize(yaw1 - yaw0 - rot1);
+    // Driving backwards is no half turn
+    const double r1 = std::min(fabs(rot1), fabs(normalize(rot1 - M_PI)));
+    const double r2 = std::min(fabs(rot2), fabs(normalize(rot2 - M_PI)));
+    const double sr1 = sqrt(alpha[0]*r1*r1 + alpha[1]*trans*trans);
+    const double st  = sqrt(alpha[2]*trans*trans + alpha[3]*(r1*r1 + r2*r2));
+    const double sr2 = sqrt(alpha[0]*r2*r2 + alpha[1]*trans*trans);
+    for (int i=0; i<n; i++) {
+      const double a = pyaw[i] + rot1 - sr1*gauss();
+      const double t = trans - st*gauss();
+      px[i] += (float)(t*cos(a));
+      py[i] += (float)(t*sin(a));
+      pyaw[i] = (float)wrap(a + rot2 - sr2*gauss());
+    }
+  }
+
+  /// Weight the particles by a scan, beams at rangeMax or beyond are skipped
+  void correct ( const ScanFrame & scan, double rangeMin, double rangeMax )
+  {
+    if (n == 0 || field.empty()) return;
+    // Subsampled end points in the robot frame
+    bx.clear();
+    by.clear();
+    const double * r = scan.ranges();
+    int valid = 0;
+    for (int i=0; i<scan.size(); i++) valid += r[i] > rangeMin && r[i] < rangeMax;
+    if (valid == 0) return;
+    const int stride = (valid + beams - 1)/beams;
+    for (int i=0, k=0; i<scan.size(); i++) {
+      if (!(r[i] > rangeMin && r[i] < rangeMax)) continue;
+      if (k++ % stride) continue;
+      bx.push_back((float)scan.x()[i]);
+      by.push_back((float)scan.y()[i]);
+    }
+    for (int i=0; i<n; i++) {
+      pc[i] = cosf(pyaw[i]);
+      ps[i] = sinf(pyaw[i]);
+    }
+    const int nb = bx.size();
+    const float inv = (float)(1./res);
+    // Cell coordinates with the border: (x - origin)/res + 1
+    const float ox = (float)(1. - originX/res), oy = (float)(1. - originY/res);
+    const float mx = (float)(fw - 1), my = (float)(fh - 1);
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 inv4 = _mm_set1_ps(inv), ox4 = _mm_set1_ps(ox), oy4 = _mm_set1_ps(oy);
+    const __m128 zero = _mm_setzero_ps(), mx4 = _mm_set1_ps(mx), my4 = _mm_set1_ps(my);
+    const __m128 fw4 = _mm_set1_ps((float)fw);
+    for (; i+4<=n; i+=4) {
+      // Particle poses in cells
+      const __m128 x4 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&px[i]), inv4), ox4);
+      const __m128 y4 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&py[i]), inv4), oy4);
+      const __m128 c4 = _mm_mul_ps(_mm_loadu_ps(&pc[i]), inv4);
+      const __m128 s4 = _mm_mul_ps(_mm_loadu_ps(&ps[i]), inv4);
+      __m128 sum = zero;
+      for (int b=0; b<nb; b++) {
+        const __m128 ex = _mm_set1_ps(bx[b]), ey = _mm_set1_ps(by[b]);
+        __m128 gx = _mm_add_ps(x4, _mm_sub_ps(_mm_mul_ps(c4, ex), _mm_mul_ps(s4, ey)));
+        __m128 gy = _mm_add_ps(y4, _mm_add_ps(_mm_mul_ps(s4, ex), _mm_mul_ps(c4, ey)));
+        // Off the map ends in the border
+        gx = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(gx, zero), mx4)));
+        gy = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(gy, zero), my4)));
+        int idx[4];
+        _mm_storeu_si128((__m128i *)idx,
+            _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(gy, fw4), gx)));
+        sum = _mm_add_ps(sum, _mm_setr_ps(field[idx[0]], field[idx[1]],
+                                           field[idx[2]], field[idx[3]]));
+      }
+      _mm_storeu_ps(&lw[i], sum);
+    }
+#endif
+    for (; i<n; i++) {
+      const float x = px[i]*inv + ox, y = py[i]*inv + oy;
+      const float c = pc[i]*inv, s = ps[i]*inv;
+      float sum = 0.f;
+      for (int b=0; b<nb; b++) {
+        const float gx = x + c*bx[b] - s*by[b], gy = y + s*bx[b] + c*by[b];
+        const int cx = (int)std::min(std::max(gx, 0.f), mx);
+        const int cy = (int)std::min(std::max(gy, 0.f), my);
+        sum += field[cy*fw + cx];
+      }
+      lw[i] = sum;
+    }
+    // Relative to the best particle, so the exponentials don't underflow all
+    const float top = *std::max_element(lw.begin(), lw.begin() + n);
+    const float scale = (float)std::min(1., (double)independent/nb);
+    double total = 0.;
+    for (int k=0; k<n; k++) total += pw[k] *= expf((lw[k] - top)*scale);
+    if (total <= 0.) total = n, std::fill(pw.begin(), pw.begin() + n, 1.f);
+    const float norm = (float)(1./total);
+    for (int k=0; k<n; k++) pw[k] *= norm;
+  }
+
+  /// Low variance resampling of the KLD bound's particle count
+  void resample ( void )
+  {
+    if (n == 0) return;
+    // Bins occupied by a systematic draw of the maximum count
+    std::vector<int> pick;
+    systematic(maxN, pick);
+    keys.clear();
+    for (unsigned int k=0; k<pick.size(); k++)
+      if (k == 0 || pick[k] != pick[k-1]) keys.push_back(binKey(pick[k]));
+    std::sort(keys.begin(), keys.end());
+    const int bins = std::unique(keys.begin(), keys.end()) - keys.begin();
+    const int m = std::max(minN, std::min(maxN, kldCount(bins)));
+    systematic(m, pick);
+    nx.resize(m); ny.resize(m); nyaw.resize(m);
+    for (int k=0; k<m; k++) {
+      nx[k] = px[pick[k]];
+      ny[k] = py[pick[k]];
+      nyaw[k] = pyaw[pick[k]];
+    }
+    n = m;
+    std::copy(nx.begin(), nx.end(), px.begin());
+    std::copy(ny.begin(), ny.end(), py.begin());
+    std::copy(nyaw.begin(), nyaw.end(), pyaw.begin());
+    std::fill(pw.begin(), pw.begin() + n, 1.f/n);
+  }
+
+  /// Weighted mean pose
+  /// @return Std. deviation of the position in meters
+  double estimate ( double * x, double * y, double * yaw ) const
+  {
+    double sx = 0., sy = 0., sc = 0., ss = 0., sxx = 0., syy = 0., total = 0.;
+    for (int i=0; i<n; i++) {
+      const double w = pw[i];
+      sx += w*px[i]; sy += w*py[i];
+      sxx += w*px[i]*px[i]; syy += w*py[i]*py[i];
+      sc += w*cos(pyaw[i]); ss += w*sin(pyaw[i]);
+      total += w;
+    }
+    if (total <= 0.) return -1.;
+    *x = sx/total;
+    *y = sy/total;
+    *yaw = atan2(ss, sc);
+    return sqrt(std::max(0., sxx/total - *x * *x + syy/total - *y * *y));
+  }
+
+  /// Number of particles
+  int size ( void ) const { return n; }
+  const float * x ( void ) const { return &px[0]; }
+  const float * y ( void ) const { return &py[0]; }
+  const float * yaw ( void ) const { return &pyaw[0]; }
+  const float * weight ( void ) const { return &pw[0]; }
+
+private:
+  int minN, maxN, beams, independent;
+  double sigma, zHit, zRand;
+  double alpha[4];
+  double kldErr, kldZ, binXY, binYaw;
+  int n;                        ///< Particle count
+  std::vector<float> px, py, pyaw, pw; ///< Particles, weights sum up to 1
+  std::vector<float> pc, ps, lw; ///< Heading cos/sin and log likelihood
+  std::vector<float> nx, ny, nyaw; ///< Resampled particles
+  std::vector<float> bx, by;    ///< Beam end points of the update
+  std::vector<long long> keys;  ///< KLD bins
+  // Likelihood field, one cell of border around the map
+  int fw, fh, mapW;
+  double res, originX, originY;
+  float lmin;                   ///< Log likelihood off the map
+  std::vector<float> field;
+  std::vector<int> freeCells;   ///< Free map cells for global initialization
+  // Random numbers, xorshift
+  unsigned long long seed;
+  double spare;
+  bool hasSpare;
+
+  double uniform ( void )
+  {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (seed >> 11)*(1./9007199254740992.);
+  }
+
+  /// Standard normal, Box-Muller
+  double gauss ( void )
+  {
+    if (hasSpare) {
+      hasSpare = false;
+      return spare;
+    }
+    double u, v, s;
+    do {
+      u = 2.*uniform() - 1.;
+      v = 2.*uniform() - 1.;
+      s = u*u + v*v;
+    } while (s >= 1. || s == 0.);
+    const double f = sqrt(-2.*log(s)/s);
+    spare = v*f;
+    hasSpare = true;
+    return u*f;
+  }
+
+  static double normalize ( double a ) { return atan2(sin(a), cos(a)); }
+  /// Normalize an angle off by less than a turn
+  static double wrap ( double a )
+  {
+    return a > M_PI ? a - 2.*M_PI : (a < -M_PI ? a + 2.*M_PI : a);
+  }
+
+  /// Indices of m particles drawn by weight with a single random offset,
+  /// in ascending order
+  void systematic ( int m, std::vector<int> & pick )
+  {
+    pick.resize(m);
+    const double step = 1./m;
+    double u = uniform()*step, c = pw[0];
+    for (int k=0, i=0; k<m; k++, u+=step) {
+      while (u > c && i < n - 1) c += pw[++i];
+      pick[k] = i;
+    }
+  }
+
+  long long binKey ( int i ) const
+  {
+    const long long bx = (long long)floor(px[i]/binXY) & 0xfffff;
+    const long long by = (long long)floor(py[i]/binXY) & 0xfffff;
+    const long long bt = (long long)floor(pyaw[i]/binYaw) & 0xfffff;
+    return (bx << 40) | (by << 20) | bt;
+  }
+
+  /// Particles bounding the KL divergence for k occupied bins (Fox 2003)
+  int kldCount ( int k )
+  {
+    if (k <= 1) return 0;
+    const double a = 2./(9.*(k - 1));
+    const double b = 1. - a + sqrt(a)*kldZ;
+    return (int)ceil((k - 1)/(2.*kldErr)*b*b*b);
+  }
+};
+
+#endif
@@ -0,0 +1,127 @@
+/// @file playerlog.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Reader for the text logs of Player's writelog driver (see
+/// stage_local/writelog.cfg), for offline benchmarks on recorded runs.
+/// Laser scans, ranger scans and position2d odometry are read, other
+/// interfaces are skipped. Ranger logs carry no angles; they are taken from
+/// the beam count of the known lasers (URG 682 beams over 240 deg, UTM-30LX
+/// 1080 beams over 270 deg).
+///
+#ifndef PLAYERLOG_H
+#define PLAYERLOG_H
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// Laser scan of a log
+struct ts_LogScan {
+  double time;     ///< Time stamp in seconds
+  double angleMin; ///< Angle of the first beam in radians
+  double angleRes; ///< Angle between beams in radians
+  double rangeMax; ///< Max range in meters
+  std::vector<double> ranges; ///< Ranges in meters
+};
+
+/// Odometry pose of a log
+struct ts_LogPose {
+  double time; ///< Time stamp in seconds
+  double x, y; ///< Position in meters
+  double yaw;  ///< Orientation in radians
+};
+
+class PlayerLog {
+public:
+  /// Record types returned by next()
+  enum RecordType { END, SCAN, POSE };
+
+  bool open ( const char * path )
+  {
+    file.close();
+    file.clear();
+    file.open(path);
+    return file.good();
+  }
+
+  /// Read up to the next scan or pose record.
+  /// @return Type of the record, stored in scan resp. pose
+  RecordType next ( void )
+  {
+    std::string line;
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#') continue;
+      std::istringstream in(line);
+      std::string host, robot, iface;
+      int index, type, subtype;
+      double time;
+      if (!(in >> time >> host >> robot >> iface >> index >> type >> subtype)) continue;
+      if (type != 1) continue; // Data only
+      tok.clear();
+      double v;
+      while (in >> v) tok.push_back(v);
+      if (iface == "position2d" && subtype == 1 && tok.size() >= 3) {
+        pose.time = time;
+        pose.x = tok[0]; pose.y = tok[1]; pose.yaw = tok[2];
+        return POSE;
+      }
+      if (iface == "laser" && (subtype == 1 || subtype == 2) && laser(time)) return SCAN;
+      if (iface == "ranger" && subtype == 1 && ranger(time)) return SCAN;
+    }
+    return END;
+  }
+
+  ts_LogScan scan; ///< Last scan read
+  ts_LogPose pose; ///< Last pose read
+
+private:
+  std::ifstream file;
+  std::vector<double> tok; ///< Values of the current line
+
+  /// Laser: [id] min_angle max_angle resolution max_range count (range intensity)*
+  /// A scanpose record carries the pose in front. The header is located by
+  /// the count matching the number of values behind it.
+  bool laser ( double time )
+  {
+    for (unsigned int k=4; k<tok.size() && k<10; k++) {
+      const double c = tok[k];
+      if (c != floor(c) || c <= 0.) continue;
+      const unsigned int n = (unsigned int)c;
+      const unsigned int rest = tok.size() - k - 1;
+      if (rest != 2*n && rest != n) continue;
+      scan.time     = time;
+      scan.angleMin = tok[k-4];
+      scan.angleRes = tok[k-2];
+      scan.rangeMax = tok[k-1];
+      scan.ranges.resize(n);
+      for (unsigned int i=0; i<n; i++) scan.ranges[i] = tok[k + 1 + i*(rest/n)];
+      return true;
+    }
+    return false;
+  }
+
+  /// Ranger: count range*
+  bool ranger ( double time )
+  {
+    if (tok.empty() || tok[0] + 1 != tok.size()) return false;
+    const unsigned int n = (unsigned int)tok[0];
+    const double fov = (n == 1080 ? 270. : 240.)*M_PI/180.;
+    if (n < 2) return false;
+    scan.time     = time;
+    scan.angleMin = -fov/2.;
+    scan.angleRes = fov/(n - 1);
+    scan.rangeMax = (n == 1080 ? 30. : 5.6);
+    scan.ranges.assign(tok.begin() + 1, tok.end());
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,573 @@
+/// @file posegraph.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Pose graph of 2D robot poses (x, y, yaw) with relative pose edges from
+/// odometry, scan matching and loop closures, optimized incrementally by
+/// Gauss-Newton with a sparse Cholesky factor, in the manner of iSAM2:
+/// - Every node keeps a linearization point and the step from it. Edges are
+///   linearized at the points of their nodes and keep their 3x3 blocks of
+///   the normal equations and of the gradient. Only the edges of nodes whose
+///   step grew beyond a threshold are linearized again (fluid
+///   relinearization), the others keep their blocks.
+/// - The factor L (H = L L^T) is stored by rows of 3x3 blocks in an
+///   elimination order, computed row by row (up-looking). Row r depends only
+///   on the rows of its structure, which are descendants of r in the
+///   elimination tree. A changed block of H therefore changes its row and
+///   the rows on the tree path to the root only; these are computed again,
+///   the rest of the factor is kept. New nodes are appended as new last rows.
+/// - The order is a minimum degree order of the graph, computed again after
+///   a number of appended nodes, so loop closures do not fill the factor.
+/// - Node positions are kept in a spatial hash (TileMap of cell lists) for
+///   loop closure candidates around a pose.
+/// The first node is held at its initial pose by a prior.
+///
+#ifndef POSEGRAPH_H
+#define POSEGRAPH_H
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <sys/time.h>
+#include "tilemap.h"
+
+/// Relative pose measurement between two nodes
+struct ts_PoseEdge {
+  int    from, to;       ///< Nodes, the measurement is to in the frame of from
+  double dx, dy, dyaw;   ///< Measured pose of to in the frame of from
+  double wxy, wyaw;      ///< Information, inverse variances of position and yaw
+  bool   loop;           ///< Loop closure
+  double hii[9], hjj[9], hij[9]; ///< Normal equation blocks at the linearization
+  double gi[3], gj[3];           ///< Gradient blocks at the linearization
+};
+
+/// Solver statistics
+struct ts_GraphStats {
+  int    relinearized;   ///< Nodes linearized again by the last update
+  int    rows;           ///< Factor rows computed by the last update
+  long   nnz;            ///< Blocks of the factor
+  bool   reordered;      ///< The last update computed a new order
+  double usec;           ///< Time of the last update in microseconds
+  double usecMax;        ///< Longest update
+  double usecTotal;      ///< Time of all updates
+  int    updates;        ///< Updates so far
+};
+
+class PoseGraph {
+public:
+  /// @param relinXY,relinYaw Step of a node in meters and radians beyond
+  ///        which its edges are linearized again
+  /// @param reorder Nodes appended before a new elimination order is computed
+  /// @param cell Spatial hash cell size in meters
+  PoseGraph(double relinXY = 0.01, double relinYaw = 0.005, int reorder = 200,
+            double cell = 1.)
+    : relinXY(relinXY), relinYaw(relinYaw), reorderEvery(reorder), cell(cell),
+      prior(1e6), heads(-1), loops(0), ordered(0), rebuild(false), stamp(0)
+  {
+    memset(&last, 0, sizeof(last));
+  }
+
+  /// Remove all nodes and edges
+  void clear ( void )
+  {
+    lin.clear(); step.clear(); est.clear();
+    edges.clear(); incident.clear();
+    pos.clear(); order.clear(); rows.clear(); parent.clear();
+    heads.clear(); nextInCell.clear(); cellX.clear(); cellY.clear();
+    relin.clear(); dirty.clear(); mark.clear();
+    loops = ordered = 0;
+    rebuild = false;
+    stamp = 0;
+    memset(&last, 0, sizeof(last));
+  }
+
+  /// Add a node at an initial pose
+  /// @return Node index
+  int addNode ( double x, double y, double yaw )
+  {
+    const int n = size();
+    const double p[3] = { x, y, yaw };
+    lin.insert(lin.end(), p, p + 3);
+    est.insert(est.end(), p, p + 3);
+    step.resize(3*(n + 1), 0.);
+    incident.push_back(std::vector<int>());
+    relin.push_back(false);
+    pos.push_back(-1);
+    nextInCell.push_back(-1);
+    cellX.push_back(cellOf(x));
+    cellY.push_back(cellOf(y));
+    int & head = heads.at(cellX[n], cellY[n]);
+    nextInCell[n] = head;
+    head = n;
+    if (n == 0) { anchorX = x; anchorY = y; anchorYaw = yaw; }
+    return n;
+  }
+
+  /// Add a relative pose measurement, pose of to in the frame of from
+  /// @param sxy,syaw Standard deviations in meters and radians
+  /// @param loop True for a loop closure
+  void addEdge ( int from, int to, double dx, double dy, double dyaw,
+                 double sxy, double syaw, bool loop = false )
+  {
+    ts_PoseEdge e;
+    e.from = from;
+    e.to = to;
+    e.dx = dx;
+    e.dy = dy;
+    e.dyaw = dyaw;
+    e.wxy = 1./(sxy*sxy);
+    e.wyaw = 1./(syaw*syaw);
+    e.loop = loop;
+    linearize(e);
+    const int k = edges.size();
+    edges.push_back(e);
+    incident[from].push_back(k);
+    incident[to].push_back(k);
+    loops += loop;
+    // Rows already factored get a new block, their structure changes
+    if (pos[from] >= 0 && pos[to] >= 0) rebuild = true;
+    else {
+      if (pos[from] >= 0) touch(pos[from]);
+      if (pos[to] >= 0) touch(pos[to]);
+    }
+  }
+
+  /// One incremental Gauss-Newton step: linearize the edges of the nodes
+  /// that moved too far again, factor the changed rows and the new nodes,
+  /// solve for all steps and update the estimates and the spatial hash.
+  void update ( void )
+  {
+    timeval t0, t1;
+    gettimeofday(&t0, 0);
+    const int n = size();
+    last.relinearized = last.rows = 0;
+    last.reordered = false;
+    if (n == 0) return;
+    // Fluid relinearization
+    for (int i=0; i<n; i++) {
+      const double * d = &step[3*i];
+      relin[i] = pos[i] >= 0 && (fabs(d[0]) > relinXY || fabs(d[1]) > relinXY ||
+                                 fabs(d[2]) > relinYaw);
+      if (!relin[i]) continue;
+      for (int k=0; k<3; k++) {
+        lin[3*i + k] = est[3*i + k];
+        step[3*i + k] = 0.;
+      }
+      last.relinearized++;
+    }
+    for (unsigned int k=0; k<edges.size(); k++) {
+      ts_PoseEdge & e = edges[k];
+      if (!relin[e.from] && !relin[e.to]) continue;
+      linearize(e);
+      touch(pos[e.from]);
+      touch(pos[e.to]);
+    }
+    if (rebuild || n - ordered >= reorderEvery) {
+      reorder();
+      for (int r=0; r<n; r++) factorRow(r);
+      last.rows = n;
+      last.reordered = true;
+      dirty.clear();
+      rebuild = false;
+    } else {
+      // Changed rows and their ancestors, then the new nodes
+      const int s = nextStamp();
+      std::vector<int> todo;
+      for (unsigned int k=0; k<dirty.size(); k++)
+        for (int r=dirty[k]; r>=0 && mark[r] != s; r=parent[r]) {
+          mark[r] = s;
+          todo.push_back(r);
+        }
+      dirty.clear();
+      std::sort(todo.begin(), todo.end());
+      for (unsigned int k=0; k<todo.size(); k++) factorRow(todo[k]);
+      for (int i=0; i<n; i++) {
+        if (pos[i] >= 0) continue;
+        appendRow(i);
+        factorRow(pos[i]);
+        last.rows++;
+      }
+      last.rows += todo.size();
+    }
+    solve();
+    // Estimates and their hash cells
+    for (int i=0; i<n; i++) {
+      for (int k=0; k<3; k++) est[3*i + k] = lin[3*i + k] + step[3*i + k];
+      est[3*i + 2] = atan2(sin(est[3*i + 2]), cos(est[3*i + 2]));
+      const int cx = cellOf(est[3*i]), cy = cellOf(est[3*i + 1]);
+      if (cx != cellX[i] || cy != cellY[i]) rehash(i, cx, cy);
+    }
+    last.nnz = 0;
+    for (int r=0; r<n; r++) last.nnz += rows[r].cols.size() + 1;
+    gettimeofday(&t1, 0);
+    last.usec = (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+    last.usecMax = std::max(last.usecMax, last.usec);
+    last.usecTotal += last.usec;
+    last.updates++;
+  }
+
+  /// Update until no node moves beyond the relinearization thresholds
+  /// @return Updates done
+  int optimize ( int iterations )
+  {
+    int i = 0;
+    while (i < iterations) {
+      update();
+      i++;
+      if (!moving()) break;
+    }
+    return i;
+  }
+
+  /// Current estimate of a node
+  void pose ( int i, double * x, double * y, double * yaw ) const
+  {
+    *x = est[3*i];
+    *y = est[3*i + 1];
+    *yaw = est[3*i + 2];
+  }
+
+  /// Nodes within a radius of a position by their current estimates
+  /// @param below Only nodes with a smaller index
+  void near ( double x, double y, double radius, int below, std::vector<int> & out ) const
+  {
+    out.clear();
+    const int x0 = cellOf(x - radius), x1 = cellOf(x + radius);
+    const int y0 = cellOf(y - radius), y1 = cellOf(y + radius);
+    for (int cy=y0; cy<=y1; cy++)
+      for (int cx=x0; cx<=x1; cx++)
+        for (int i=heads.get(cx, cy); i>=0; i=nextInCell[i])
+          if (i < below && hypot(est[3*i] - x, est[3*i + 1] - y) <= radius) out.push_back(i);
+  }
+
+  /// Weighted squared error of all edges at the current estimates
+  double error ( void ) const
+  {
+    double sum = 0.;
+    for (unsigned int k=0; k<edges.size(); k++) {
+      double e[3];
+      residual(edges[k], &est[3*edges[k].from], &est[3*edges[k].to], e);
+      const ts_PoseEdge & ed = edges[k];
+      sum += ed.wxy*(e[0]*e[0] + e[1]*e[1]) + ed.wyaw*e[2]*e[2];
+    }
+    return sum;
+  }
+
+  int size ( void ) const { return incident.size(); }
+  const std::vector<ts_PoseEdge> & edgeList ( void ) const { return edges; }
+  int loopCount ( void ) const { return loops; }
+  const ts_GraphStats & stats ( void ) const { return last; }
+
+private:
+  /// Row of the factor: blocks left of the diagonal and the diagonal block
+  struct Row {
+    std::vector<int>    cols;   ///< Columns of the blocks, ascending
+    std::vector<double> blocks; ///< 3x3 blocks, row major
+    double diag[9];             ///< Lower triangular diagonal block
+  };
+
+  double relinXY, relinYaw;
+  int    reorderEvery;
+  double cell;
+  double prior;                       ///< Information of the first node's prior
+  double anchorX, anchorY, anchorYaw; ///< Pose of the first node's prior
+  std::vector<double> lin, step, est;  ///< Linearization points, steps, estimates
+  std::vector<ts_PoseEdge> edges;
+  std::vector< std::vector<int> > incident; ///< Edges of a node
+  std::vector<int> pos, order;  ///< Row of a node, node of a row
+  std::vector<Row> rows;
+  std::vector<int> parent;      ///< Elimination tree, -1 at roots
+  TileMap<int> heads;           ///< First node of a hash cell, -1 if none
+  std::vector<int> nextInCell, cellX, cellY;
+  std::vector<bool> relin;      ///< Linearized again by this update
+  std::vector<int> dirty;       ///< Rows whose H blocks changed
+  std::vector<int> mark;        ///< Stamp per row
+  std::vector<double> work;     ///< Blocks of the row being factored
+  int loops, ordered;           ///< Loop closures, nodes at the last reorder
+  bool rebuild;                 ///< Structure changed, reorder
+  int stamp;
+  ts_GraphStats last;
+
+  int cellOf ( double v ) const { return (int)floor(v/cell); }
+
+  void rehash ( int i, int cx, int cy )
+  {
+    int & head = heads.at(cellX[i], cellY[i]);
+    if (head == i) head = nextInCell[i];
+    else {
+      int k = head;
+      while (nextInCell[k] != i) k = nextInCell[k];
+      nextInCell[k] = nextInCell[i];
+    }
+    cellX[i] = cx;
+    cellY[i] = cy;
+    int & h = heads.at(cx, cy);
+    nextInCell[i] = h;
+    h = i;
+  }
+
+  int nextStamp ( void )
+  {
+    mark.resize(size(), 0);
+    if (++stamp == 0x7fffffff) {
+      std::fill(mark.begin(), mark.end(), 0);
+      stamp = 1;
+    }
+    return stamp;
+  }
+
+  void touch ( int r ) { if (r >= 0) dirty.push_back(r); }
+
+  bool moving ( void ) const
+  {
+    for (int i=0; i<size(); i++) {
+      const double * d = &step[3*i];
+      if (fabs(d[0]) > relinXY || fabs(d[1]) > relinXY || fabs(d[2]) > relinYaw) return true;
+    }
+    return false;
+  }
+
+  /// Error of an edge: measured minus predicted pose of to in the frame of from
+  static void residual ( const ts_PoseEdge & e, const double * pi, const double * pj,
+                         double * r )
+  {
+    const double c = cos(pi[2]), s = sin(pi[2]);
+    const double dx = pj[0] - pi[0], dy = pj[1] - pi[1];
+    const double a = pj[2] - pi[2] - e.dyaw;
+    r[0] =  c*dx + s*dy - e.dx;
+    r[1] = -s*dx + c*dy - e.dy;
+    r[2] = atan2(sin(a), cos(a));
+  }
+
+  /// Normal equation and gradient blocks of an edge at the linearization points
+  void linearize ( ts_PoseEdge & e ) const
+  {
+    const double * pi = &lin[3*e.from], * pj = &lin[3*e.to];
+    double r[3];
+    residual(e, pi, pj, r);
+    const double c = cos(pi[2]), s = sin(pi[2]);
+    const double dx = pj[0] - pi[0], dy = pj[1] - pi[1];
+    const double A[9] = { -c, -s, -s*dx + c*dy,
+                           s, -c, -c*dx - s*dy,
+                           0.,  0., -1. };
+    const double B[9] = {  c,  s, 0.,
+                          -s,  c, 0.,
+                           0., 0., 1. };
+    const double w[3] = { e.wxy, e.wxy, e.wyaw };
+    for (int a=0; a<3; a++) {
+      for (int b=0; b<3; b++) {
+        double ii = 0., jj = 0., ij = 0.;
+        for (int k=0; k<3; k++) {
+          ii += A[3*k + a]*w[k]*A[3*k + b];
+          jj += B[3*k + a]*w[k]*B[3*k + b];
+          ij += A[3*k + a]*w[k]*B[3*k + b];
+        }
+        e.hii[3*a + b] = ii;
+        e.hjj[3*a + b] = jj;
+        e.hij[3*a + b] = ij;
+      }
+      double gi = 0., gj = 0.;
+      for (int k=0; k<3; k++) {
+        gi += A[3*k + a]*w[k]*r[k];
+        gj += B[3*k + a]*w[k]*r[k];
+      }
+      e.gi[a] = gi;
+      e.gj[a] = gj;
+    }
+  }
+
+  /// Minimum degree order of the nodes, ties to the older node
+  void reorder ( void )
+  {
+    const int n = size();
+    std::vector< std::vector<int> > adj(n);
+    for (unsigned int k=0; k<edges.size(); k++) {
+      if (edges[k].from == edges[k].to) continue;
+      adj[edges[k].from].push_back(edges[k].to);
+      adj[edges[k].to].push_back(edges[k].from);
+    }
+    std::set< std::pair<int, int> > queue;
+    for (int i=0; i<n; i++) {
+      std::sort(adj[i].begin(), adj[i].end());
+      adj[i].erase(std::unique(adj[i].begin(), adj[i].end()), adj[i].end());
+      queue.insert(std::make_pair((int)adj[i].size(), i));
+    }
+    order.clear();
+    std::vector<int> merged;
+    while (!queue.empty()) {
+      const int v = queue.begin()->second;
+      queue.erase(queue.begin());
+      order.push_back(v);
+      // The neighbours of v become a clique
+      const std::vector<int> & nb = adj[v];
+      for (unsigned int k=0; k<nb.size(); k++) {
+        const int u = nb[k];
+        queue.erase(std::make_pair((int)adj[u].size(), u));
+        merged.clear();
+        std::set_union(adj[u].begin(), adj[u].end(), nb.begin(), nb.end(),
+            std::back_inserter(merged));
+        adj[u].clear();
+        for (unsigned int m=0; m<merged.size(); m++)
+          if (merged[m] != u && merged[m] != v) adj[u].push_back(merged[m]);
+        queue.insert(std::make_pair((int)adj[u].size(), u));
+      }
+      std::vector<int>().swap(adj[v]);
+    }
+    rows.clear();
+    parent.clear();
+    std::fill(pos.begin(), pos.end(), -1);
+    std::vector<int> nodes;
+    nodes.swap(order);
+    for (int r=0; r<n; r++) appendRow(nodes[r]);
+    ordered = n;
+  }
+
+  /// Give a node the next row and find the row's structure: the union of
+  /// the elimination tree paths from its neighbours in earlier rows
+  void appendRow ( int i )
+  {
+    const int r = order.size();
+    order.push_back(i);
+    pos[i] = r;
+    rows.push_back(Row());
+    parent.push_back(-1);
+    const int s = nextStamp();
+    mark[r] = s;
+    std::vector<int> & cols = rows[r].cols;
+    for (unsigned int k=0; k<incident[i].size(); k++) {
+      const ts_PoseEdge & e = edges[incident[i][k]];
+      const int o = e.from == i ? e.to : e.from;
+      for (int c=pos[o]; c>=0 && c<r && mark[c] != s; c=parent[c]) {
+        mark[c] = s;
+        cols.push_back(c);
+        if (parent[c] < 0) parent[c] = r;
+      }
+    }
+    std::sort(cols.begin(), cols.end());
+    rows[r].blocks.resize(9*cols.size());
+  }
+
+  /// Compute row r of the factor from H and the rows of its structure
+  void factorRow ( int r )
+  {
+    const int i = order[r];
+    Row & row = rows[r];
+    work.resize(9*rows.size());
+    for (unsigned int k=0; k<row.cols.size(); k++)
+      std::fill(&work[9*row.cols[k]], &work[9*row.cols[k]] + 9, 0.);
+    // Blocks of H in row r: the diagonal and the edges to earlier rows
+    double d[9] = { 0. };
+    if (i == 0) d[0] = d[4] = d[8] = prior;
+    for (unsigned int k=0; k<incident[i].size(); k++) {
+      const ts_PoseEdge & e = edges[incident[i][k]];
+      if (e.from == e.to) continue;
+      const bool from = e.from == i;
+      const double * h = from ? e.hii : e.hjj;
+      for (int m=0; m<9; m++) d[m] += h[m];
+      const int c = pos[from ? e.to : e.from];
+      if (c < 0 || c >= r) continue;
+      double * wb = &work[9*c];
+      // H_ij for i = from, H_ji = H_ij^T otherwise
+      for (int a=0; a<3; a++)
+        for (int b=0; b<3; b++) wb[3*a + b] += from ? e.hij[3*a + b] : e.hij[3*b + a];
+    }
+    for (unsigned int k=0; k<row.cols.size(); k++) {
+      const int c = row.cols[k];
+      double * x = &work[9*c];
+      // x -= sum of L[r][m] L[c][m]^T over the structure of row c
+      const Row & rc = rows[c];
+      for (unsigned int m=0; m<rc.cols.size(); m++) {
+        const double * lr = &work[9*rc.cols[m]], * lc = &rc.blocks[9*m];
+        for (int a=0; a<3; a++)
+          for (int b=0; b<3; b++)
+            x[3*a + b] -= lr[3*a]*lc[3*b] + lr[3*a + 1]*lc[3*b + 1] + lr[3*a + 2]*lc[3*b + 2];
+      }
+      // L[r][c] = x L[c][c]^-T, forward substitution per row of x
+      const double * l = rc.diag;
+      for (int a=0; a<3; a++) {
+        double * xa = x + 3*a;
+        xa[0] = xa[0]/l[0];
+        xa[1] = (xa[1] - l[3]*xa[0])/l[4];
+        xa[2] = (xa[2] - l[6]*xa[0] - l[7]*xa[1])/l[8];
+      }
+      for (int a=0; a<3; a++)
+        for (int b=0; b<3; b++)
+          d[3*a + b] -= x[3*a]*x[3*b] + x[3*a + 1]*x[3*b + 1] + x[3*a + 2]*x[3*b + 2];
+      std::copy(x, x + 9, &row.blocks[9*k]);
+    }
+    chol3(d, row.diag);
+  }
+
+  /// Lower triangular Cholesky factor of a 3x3 block, tiny pivots of a
+  /// singular block are raised
+  static void chol3 ( const double * a, double * l )
+  {
+    const double eps = 1e-12;
+    l[1] = l[2] = l[5] = 0.;
+    l[0] = sqrt(std::max(a[0], eps));
+    l[3] = a[3]/l[0];
+    l[6] = a[6]/l[0];
+    l[4] = sqrt(std::max(a[4] - l[3]*l[3], eps));
+    l[7] = (a[7] - l[6]*l[3])/l[4];
+    l[8] = sqrt(std::max(a[8] - l[6]*l[6] - l[7]*l[7], eps));
+  }
+
+  /// Steps from the factor: L L^T step = -g
+  void solve ( void )
+  {
+    const int n = size();
+    std::vector<double> & y = work;
+    y.assign(3*n, 0.);
+    for (unsigned int k=0; k<edges.size(); k++) {
+      const ts_PoseEdge & e = edges[k];
+      for (int a=0; a<3; a++) {
+        y[3*pos[e.from] + a] -= e.gi[a];
+        y[3*pos[e.to] + a] -= e.gj[a];
+      }
+    }
+    const double p0[3] = { lin[0] - anchorX, lin[1] - anchorY,
+                              atan2(sin(lin[2] - anchorYaw), cos(lin[2] - anchorYaw)) };
+    for (int a=0; a<3; a++) y[3*pos[0] + a] -= prior*p0[a];
+    // Forward, L y = -g
+    for (int r=0; r<n; r++) {
+      const Row & row = rows[r];
+      double * yr = &y[3*r];
+      for (unsigned int k=0; k<row.cols.size(); k++) {
+        const double * l = &row.blocks[9*k], * yc = &y[3*row.cols[k]];
+        for (int a=0; a<3; a++) yr[a] -= l[3*a]*yc[0] + l[3*a + 1]*yc[1] + l[3*a + 2]*yc[2];
+      }
+      const double * l = row.diag;
+      yr[0] = yr[0]/l[0];
+      yr[1] = (yr[1] - l[3]*yr[0])/l[4];
+      yr[2] = (yr[2] - l[6]*yr[0] - l[7]*yr[1])/l[8];
+    }
+    // Backward, L^T x = y, column by column from the last row
+    for (int r=n-1; r>=0; r--) {
+      const Row & row = rows[r];
+      double * xr = &y[3*r];
+      const double * l = row.diag;
+      xr[2] = xr[2]/l[8];
+      xr[1] = (xr[1] - l[7]*xr[2])/l[4];
+      xr[0] = (xr[0] - l[3]*xr[1] - l[6]*xr[2])/l[0];
+      for (unsigned int k=0; k<row.cols.size(); k++) {
+        const double * b = &row.blocks[9*k];
+        double * xc = &y[3*row.cols[k]];
+        for (int a=0; a<3; a++) xc[a] -= b[a]*xr[0] + b[3 + a]*xr[1] + b[6 + a]*xr[2];
+      }
+    }
+    for (int r=0; r<n; r++)
+      for (int a=0; a<3; a++) step[3*order[r] + a] = y[3*r + a];
+  }
+
+  PoseGraph(const PoseGraph &);
+  PoseGraph & operator= (const PoseGraph &);
+};
+
+#endif
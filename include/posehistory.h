@@ -0,0 +1,84 @@
+/// @file posehistory.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Ring buffer of time stamped odometry poses. Sensor readings which took
+/// long to process (e.g. camera frames) are related to the pose at their
+/// capture time by interpolating between the neighbouring poses.
+///
+#ifndef POSEHISTORY_H
+#define POSEHISTORY_H
+
+#include <cmath>
+
+/// Time stamped odometry pose
+struct ts_Pose {
+  double t;   ///< Time stamp in seconds
+  double x;   ///< Position in meters
+  double y;   ///< Position in meters
+  double yaw; ///< Orientation in radians
+};
+
+template <int SIZE>
+class PoseHistory {
+public:
+  PoseHistory() : head(0), count(0) {}
+
+  /// Append a pose, the oldest one is dropped when full.
+  /// Stamps have to be increasing.
+  void push ( double t, double x, double y, double yaw )
+  {
+    ts_Pose & p = ring[head];
+    p.t = t; p.x = x; p.y = y; p.yaw = yaw;
+    head = (head + 1) % SIZE;
+    if (count < SIZE) count++;
+  }
+
+  /// Number of stored poses
+  int size ( void ) const { return count; }
+  /// i'th newest pose, 0 is the latest
+  const ts_Pose & newest ( int i = 0 ) const { return ring[(head - 1 - i + 2*SIZE) % SIZE]; }
+
+  /// Interpolate the pose at time t.
+  /// Times outside the history are clamped to the oldest resp. newest pose.
+  /// @return False if the history is empty or t had to be clamped.
+  bool at ( double t, double * x, double * y, double * yaw ) const
+  {
+    if (count == 0) return false;
+    const ts_Pose * a = &newest(0);
+    if (t >= a->t) {
+      *x = a->x; *y = a->y; *yaw = a->yaw;
+      return t == a->t;
+    }
+    for (int i=1; i<count; i++) {
+      const ts_Pose * b = &newest(i); // b older than a
+      if (t >= b->t) {
+        const double s = (a->t > b->t) ? (t - b->t)/(a->t - b->t) : 0.;
+        double dyaw = a->yaw - b->yaw;
+        while (dyaw >  M_PI) dyaw -= 2*M_PI;
+        while (dyaw < -M_PI) dyaw += 2*M_PI;
+        *x   = b->x + s*(a->x - b->x);
+        *y   = b->y + s*(a->y - b->y);
+        *yaw = b->yaw + s*dyaw;
+        if (*yaw >  M_PI) *yaw -= 2*M_PI;
+        if (*yaw < -M_PI) *yaw += 2*M_PI;
+        return true;
+      }
+      a = b;
+    }
+    *x = a->x; *y = a->y; *yaw = a->yaw; // Older than the history
+    return false;
+  }
+
+private:
+  ts_Pose ring[SIZE];
+  int head;  ///< Next slot to write
+  int count; ///< Valid entries
+};
+
+#endif
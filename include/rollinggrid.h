@@ -0,0 +1,190 @@
+/// @file rollinggrid.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Occupancy grid of fixed size following the robot, so obstacles seen by
+/// the laser stay known when they move into the sonar only blind spots.
+/// The grid is aligned with the odometry frame and centered at the robot.
+/// Cells are addressed by their odometry cell index modulo the grid size,
+/// i.e. the storage is a ring buffer in both axes: when the robot moves only
+/// the rows and columns that leave the window are cleared for reuse, nothing
+/// is copied. Laser beams and sonar cones are traced with integer line
+/// traversal, lowering the log odds along the beam and raising them at its
+/// end.
+///
+#ifndef ROLLINGGRID_H
+#define ROLLINGGRID_H
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "scanframe.h"
+
+class RollingGrid {
+public:
+  static const int LOGMAX = 60;     ///< Log odds clamp
+  static const int OCCUPIED = 6;    ///< Log odds from which a cell is occupied
+  static const int LASERHIT = 12, LASERMISS = -4; ///< Laser log odds update
+  static const int SONARHIT = 4, SONARMISS = -1;  ///< Sonar log odds update
+
+  /// @param size Side length in meters, the robot is at the center
+  /// @param res Cell size in meters
+  RollingGrid(double size = 8., double res = 0.05)
+    : n((int)(size/res + 0.5)), res(res), ox(0), oy(0), cell(n*n, 0)
+  {
+    setPose(0., 0., 0.);
+  }
+
+  /// Center the grid at the robot's odometry pose
+  void setPose ( double x, double y, double yaw )
+  {
+    rx = x; ry = y;
+    rc = cos(yaw); rs = sin(yaw);
+    scroll(index(x) - n/2, index(y) - n/2);
+  }
+
+  /// Trace a beam, robot coordinates
+  /// @param hit True if the beam ends at an obstacle
+  void addBeam ( double x0, double y0, double x1, double y1, bool hit,
+                 int hitOdds, int missOdds )
+  {
+    int cx = index(rx + rc*x0 - rs*y0) - ox;
+    int cy = index(ry + rs*x0 + rc*y0) - oy;
+    const int ex = index(rx + rc*x1 - rs*y1) - ox;
+    const int ey = index(ry + rs*x1 + rc*y1) - oy;
+    const int dx = abs(ex - cx), dy = -abs(ey - cy);
+    const int sx = cx < ex ? 1 : -1, sy = cy < ey ? 1 : -1;
+    int err = dx + dy;
+    while (cx != ex || cy != ey) {
+      if (!inside(cx, cy)) return;
+      add(cx, cy, missOdds);
+      const int e2 = 2*err;
+      if (e2 >= dy) { err += dy; cx += sx; }
+      if (e2 <= dx) { err += dx; cy += sy; }
+    }
+    if (inside(cx, cy)) add(cx, cy, hit ? hitOdds : missOdds);
+  }
+
+  /// Trace the beams of a scan, max ranges clear up to rangeMax
+  void addScan ( const ScanFrame & scan, double rangeMin, double rangeMax )
+  {
+    const double * r = scan.ranges();
+    for (int i=0; i<scan.size(); i++) {
+      if (r[i] <= rangeMin) continue;
+      if (r[i] < rangeMax) {
+        addBeam(scan.mountX(), 0., scan.x()[i], scan.y()[i], true,
+            LASERHIT, LASERMISS);
+      } else {
+        const double a = scan.angle(i);
+        addBeam(scan.mountX(), 0., scan.mountX() + rangeMax*cos(a),
+            rangeMax*sin(a), false, LASERHIT, LASERMISS);
+      }
+    }
+  }
+
+  /// Trace a sonar cone by its center and border beams
+  /// @param x,y,yaw Sonar pose in robot coordinates
+  /// @param fov Cone opening in radians
+  void addSonar ( double x, double y, double yaw, double range, double fov,
+                  double rangeMax )
+  {
+    const bool hit = range < rangeMax;
+    range = std::min(range, rangeMax);
+    for (int k=-2; k<=2; k++) {
+      const double a = yaw + k*fov/4;
+      addBeam(x, y, x + range*cos(a), y + range*sin(a), hit, SONARHIT, SONARMISS);
+    }
+  }
+
+  /// True if the cell at (x, y) in robot coordinates is occupied
+  bool occupied ( double x, double y ) const
+  {
+    const int cx = index(rx + rc*x - rs*y) - ox;
+    const int cy = index(ry + rs*x + rc*y) - oy;
+    return inside(cx, cy) && at(cx, cy) >= OCCUPIED;
+  }
+
+  /// Distance to the first occupied cell along a ray in robot coordinates
+  /// @return maxRange if there is none
+  double distance ( double x, double y, double angle, double maxRange ) const
+  {
+    const double step = res/2;
+    const double c = cos(angle), s = sin(angle);
+    for (double d=0.; d<maxRange; d+=step)
+      if (occupied(x + d*c, y + d*s)) return d;
+    return maxRange;
+  }
+
+  /// Centers of the occupied cells within a radius, robot coordinates
+  void occupiedCells ( double radius, std::vector<float> & xs,
+                       std::vector<float> & ys ) const
+  {
+    xs.clear();
+    ys.clear();
+    const int k = std::min(n/2, (int)ceil(radius/res));
+    const int cx = index(rx) - ox, cy = index(ry) - oy;
+    const double r2 = radius*radius;
+    for (int j=std::max(0, cy - k); j<=std::min(n - 1, cy + k); j++)
+      for (int i=std::max(0, cx - k); i<=std::min(n - 1, cx + k); i++) {
+        if (at(i, j) < OCCUPIED) continue;
+        const double wx = (ox + i + 0.5)*res - rx, wy = (oy + j + 0.5)*res - ry;
+        if (wx*wx + wy*wy > r2) continue;
+        xs.push_back((float)( rc*wx + rs*wy));
+        ys.push_back((float)(-rs*wx + rc*wy));
+      }
+  }
+
+  int cells ( void ) const { return n; }
+  double resolution ( void ) const { return res; }
+
+private:
+  int n;       ///< Cells per side
+  double res;
+  int ox, oy;  ///< Odometry cell index of the window's lower left cell
+  double rx, ry, rc, rs; ///< Robot pose
+  std::vector<signed char> cell; ///< Log odds, ring buffer in x and y
+
+  int index ( double v ) const { return (int)floor(v/res); }
+  static int wrap ( int i, int n ) { return ((i % n) + n) % n; }
+  bool inside ( int cx, int cy ) const { return cx >= 0 && cx < n && cy >= 0 && cy < n; }
+
+  /// Cell by window coordinates
+  signed char & at ( int cx, int cy ) { return cell[wrap(oy + cy, n)*n + wrap(ox + cx, n)]; }
+  signed char at ( int cx, int cy ) const { return cell[wrap(oy + cy, n)*n + wrap(ox + cx, n)]; }
+
+  void add ( int cx, int cy, int odds )
+  {
+    signed char & c = at(cx, cy);
+    const int l = c + odds;
+    c = (signed char)(l > LOGMAX ? LOGMAX : (l < -LOGMAX ? -LOGMAX : l));
+  }
+
+  /// Move the window, clearing the rows and columns leaving it
+  void scroll ( int nx, int ny )
+  {
+    const int dx = nx - ox, dy = ny - oy;
+    if (abs(dx) >= n || abs(dy) >= n) {
+      std::fill(cell.begin(), cell.end(), 0);
+    } else {
+      // Columns entering the window reuse the storage of the leaving ones
+      for (int k=0; k<abs(dx); k++) {
+        const int c = wrap(dx > 0 ? ox + n + k : ox - 1 - k, n);
+        for (int j=0; j<n; j++) cell[j*n + c] = 0;
+      }
+      for (int k=0; k<abs(dy); k++) {
+        const int r = wrap(dy > 0 ? oy + n + k : oy - 1 - k, n);
+        std::fill(cell.begin() + r*n, cell.begin() + (r + 1)*n, 0);
+      }
+    }
+    ox = nx;
+    oy = ny;
+  }
+};
+
+#endif
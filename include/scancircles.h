@@ -0,0 +1,136 @@
+/// @file scancircles.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Detects balls and other round obstacles in a laser scan.
+/// The scan is split into segments at range jumps, segments of the right
+/// width get an algebraic (Kasa) circle fit, circles of about the ball radius
+/// which bulge towards the sensor are reported. Cheap enough for every scan.
+///
+#ifndef SCANCIRCLES_H
+#define SCANCIRCLES_H
+
+#include <cmath>
+#include "scanframe.h"
+
+/// Circle found in a scan, robot coordinates
+struct ts_Circle {
+  double x, y;    ///< Center in meters
+  double r;       ///< Radius in meters
+  double bearing; ///< Bearing of the center in radians
+  double dist;    ///< Distance of the center in meters
+  double rms;     ///< Fit residual in meters
+};
+
+class ScanCircles {
+public:
+  static const int MAXCIRCLES = 16; ///< Circles reported per scan at most
+
+  /// @param radius Expected circle radius in meters
+  /// @param radiusTol Relative radius tolerance
+  /// @param jump Range jump in meters splitting segments (grows with range)
+  /// @param minPoints Minimum beams per segment
+  /// @param maxRms Maximum fit residual in meters
+  ScanCircles(double radius, double radiusTol = 0.3, double jump = 0.1,
+              int minPoints = 4, double maxRms = 0.01)
+    : radius(radius), radiusTol(radiusTol), jump(jump),
+      minPoints(minPoints), maxRms(maxRms), px(0), py(0), count(0) {}
+
+  /// Detect circles in a scan.
+  /// @param scan Scan with its end points
+  /// @param rangeMin,rangeMax Valid range interval in meters
+  /// @return Number of circles found
+  int detect ( const ScanFrame & scan, double rangeMin, double rangeMax )
+  {
+    const double * ranges = scan.ranges();
+    const int num = scan.size();
+    count = 0;
+    px = scan.x();
+    py = scan.y();
+
+    int first = -1;
+    for (int i=0; i<=num; i++) {
+      const bool valid = i<num && ranges[i] > rangeMin && ranges[i] < rangeMax;
+      if (first >= 0 &&
+          (!valid || fabs(ranges[i] - ranges[i-1]) > jump*(1. + ranges[i-1]))) {
+        segment(first, i - 1);
+        first = -1;
+      }
+      if (valid && first < 0) first = i;
+    }
+    return count;
+  }
+
+  /// Number of circles of the last scan
+  int size ( void ) const { return count; }
+  /// i'th circle of the last scan
+  const ts_Circle & operator[] ( int i ) const { return circles[i]; }
+
+private:
+  double radius, radiusTol, jump;
+  int    minPoints;
+  double maxRms;
+  const double * px, * py; ///< Beam end points of the current scan
+  ts_Circle circles[MAXCIRCLES];
+  int count;
+
+  /// Check and fit the beams first..last.
+  void segment ( int first, int last )
+  {
+    if (count >= MAXCIRCLES || last - first + 1 < minPoints) return;
+    // A visible ball arc spans at most its diameter
+    const double chord = hypot(px[last] - px[first], py[last] - py[first]);
+    if (chord > 2*radius*(1. + radiusTol) || chord < radius*0.5) return;
+
+    // Kasa fit: minimize sum (x^2 + y^2 + D x + E y + F)^2, centered on the
+    // mean for numerical stability
+    const int n = last - first + 1;
+    double mx = 0., my = 0.;
+    for (int i=first; i<=last; i++) { mx += px[i]; my += py[i]; }
+    mx /= n; my /= n;
+    double sxx = 0., sxy = 0., syy = 0., sxz = 0., syz = 0., sz = 0.;
+    for (int i=first; i<=last; i++) {
+      const double x = px[i] - mx, y = py[i] - my, z = x*x + y*y;
+      sxx += x*x; sxy += x*y; syy += y*y;
+      sxz += x*z; syz += y*z; sz += z;
+    }
+    // With centered data the normal equations decouple F = -mean(z)
+    const double det = sxx*syy - sxy*sxy;
+    if (fabs(det) < 1e-12) return; // Collinear: a wall
+    const double D = -(sxz*syy - syz*sxy)/det;
+    const double E = -(syz*sxx - sxz*sxy)/det;
+    const double F = -sz/n;
+    const double cx = -D/2., cy = -E/2.;
+    const double r2 = cx*cx + cy*cy - F;
+    if (r2 <= 0.) return;
+    const double r = sqrt(r2);
+    if (fabs(r - radius) > radius*radiusTol) return;
+
+    double rms = 0.;
+    for (int i=first; i<=last; i++) {
+      const double e = hypot(px[i] - mx - cx, py[i] - my - cy) - r;
+      rms += e*e;
+    }
+    rms = sqrt(rms/n);
+    if (rms > maxRms) return;
+
+    ts_Circle & c = circles[count];
+    c.x = cx + mx;
+    c.y = cy + my;
+    c.r = r;
+    c.dist = hypot(c.x, c.y);
+    c.bearing = atan2(c.y, c.x);
+    c.rms = rms;
+    // Convex towards the robot: the center lies behind the mid beam
+    const int m = (first + last)/2;
+    if (c.dist <= hypot(px[m], py[m])) return;
+    count++;
+  }
+};
+
+#endif
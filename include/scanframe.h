@@ -0,0 +1,100 @@
+/// @file scanframe.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// One laser scan with its beam end points in robot coordinates.
+/// The points are computed once per scan for all consumers (line and circle
+/// extraction, ...) and kept as structure of arrays x[], y[]. The cos/sin of
+/// the beam angles are tabled when the sensor geometry (first angle,
+/// resolution, beam count) changes, so converting a scan is a multiply-add
+/// per coordinate, done two beams at once with SSE2 when available.
+///
+#ifndef SCANFRAME_H
+#define SCANFRAME_H
+
+#include <cmath>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+class ScanFrame {
+public:
+  ScanFrame() : num(0), aMin(0.), aRes(0.), mount(0.) {}
+
+  /// Set the sensor geometry, the trig tables are rebuilt if it changed.
+  /// @param num Number of beams
+  /// @param angleMin Angle of the first beam in radians
+  /// @param angleRes Angle between beams in radians
+  /// @param mountX Laser offset in front of the robot center in meters
+  void setGeometry ( int num, double angleMin, double angleRes, double mountX )
+  {
+    mount = mountX;
+    if (num == this->num && angleMin == aMin && angleRes == aRes) return;
+    this->num = num;
+    aMin = angleMin;
+    aRes = angleRes;
+    cosT.resize(num); sinT.resize(num);
+    r.resize(num); px.resize(num); py.resize(num);
+    for (int i=0; i<num; i++) {
+      cosT[i] = cos(angleMin + i*angleRes);
+      sinT[i] = sin(angleMin + i*angleRes);
+    }
+  }
+
+  /// Range buffer to fill before convert()
+  double * ranges ( void ) { return num ? &r[0] : 0; }
+
+  /// Compute the beam end points of the ranges
+  void convert ( void )
+  {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128d m = _mm_set1_pd(mount);
+    for (; i+2<=num; i+=2) {
+      const __m128d ri = _mm_loadu_pd(&r[i]);
+      _mm_storeu_pd(&px[i], _mm_add_pd(_mm_mul_pd(ri, _mm_loadu_pd(&cosT[i])), m));
+      _mm_storeu_pd(&py[i], _mm_mul_pd(ri, _mm_loadu_pd(&sinT[i])));
+    }
+#endif
+    for (; i<num; i++) {
+      px[i] = r[i]*cosT[i] + mount;
+      py[i] = r[i]*sinT[i];
+    }
+  }
+
+  /// Set geometry and ranges of a scan and convert it
+  void set ( const double * ranges, int num, double angleMin, double angleRes,
+             double mountX )
+  {
+    setGeometry(num, angleMin, angleRes, mountX);
+    for (int i=0; i<num; i++) r[i] = ranges[i];
+    convert();
+  }
+
+  /// Number of beams
+  int size ( void ) const { return num; }
+  /// Beam ranges in meters
+  const double * ranges ( void ) const { return num ? &r[0] : 0; }
+  /// Beam end points in meters, robot coordinates
+  const double * x ( void ) const { return num ? &px[0] : 0; }
+  const double * y ( void ) const { return num ? &py[0] : 0; }
+  /// Angle of beam i at the sensor in radians
+  double angle ( int i ) const { return aMin + i*aRes; }
+  double angleMin ( void ) const { return aMin; }
+  double angleRes ( void ) const { return aRes; }
+  double mountX ( void ) const { return mount; }
+
+private:
+  int num;
+  double aMin, aRes, mount;
+  std::vector<double> cosT, sinT; ///< Trig tables of the beam angles
+  std::vector<double> r, px, py;
+};
+
+#endif
@@ -0,0 +1,245 @@
+/// @file scanlines.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Extracts wall segments from a laser scan by split-and-merge.
+/// The scan is cut into clusters at range jumps, each cluster is split
+/// iteratively at the point farthest from its chord until all points are
+/// close to it, neighbouring collinear pieces are merged again and every
+/// segment gets a total least squares line fit.
+/// Clusters are processed from the left end of the scan (the followed wall)
+/// to the right one while the time budget lasts, so a scan which is too
+/// complex still delivers the left wall.
+///
+#ifndef SCANLINES_H
+#define SCANLINES_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+#include "scanframe.h"
+
+/// Line segment found in a scan, robot coordinates
+struct ts_Line {
+  double x0, y0;  ///< Start point (right end) in meters
+  double x1, y1;  ///< End point (left end) in meters
+  double angle;   ///< Direction relative to the robot heading in radians,
+                  ///  -pi/2..pi/2, positive if the line runs away to the left
+  double dist;    ///< Perpendicular distance of the robot center in meters
+  double length;  ///< Segment length in meters
+  double rms;     ///< Fit residual in meters
+  int    first;   ///< First beam index
+  int    last;    ///< Last beam index
+};
+
+class ScanLines {
+public:
+  static const int MAXLINES = 64; ///< Lines reported per scan at most
+
+  /// @param splitDist Max point to chord distance in meters before splitting
+  /// @param jump Range jump in meters splitting clusters (grows with range)
+  /// @param minPoints Minimum beams per segment
+  /// @param budget Processing time budget per scan in microseconds, 0 for none
+  ScanLines(double splitDist = 0.03, double jump = 0.1, int minPoints = 6,
+            long budget = 0)
+    : splitDist(splitDist), jump(jump), minPoints(minPoints), budget(budget),
+      px(0), py(0), count(0), complete(true) {}
+
+  /// Extract the lines of a scan.
+  /// @param scan Scan with its end points
+  /// @param rangeMin,rangeMax Valid range interval in meters
+  /// @return Number of lines found
+  int detect ( const ScanFrame & scan, double rangeMin, double rangeMax )
+  {
+    timeval start;
+    if (budget > 0) gettimeofday(&start, 0);
+    const double * ranges = scan.ranges();
+    const int num = scan.size();
+    count = 0;
+    complete = true;
+    px = scan.x();
+    py = scan.y();
+
+    // Clusters from the left end (last beam) to the right one
+    int last = -1;
+    for (int i=num-1; i>=-1; i--) {
+      const bool valid = i>=0 && ranges[i] > rangeMin && ranges[i] < rangeMax;
+      if (last >= 0 &&
+          (!valid || fabs(ranges[i] - ranges[i+1]) > jump*(1. + ranges[i+1]))) {
+        if (budget > 0 && elapsed(start) > budget) {
+          complete = false;
+          break;
+        }
+        cluster(i + 1, last);
+        last = -1;
+      }
+      if (valid && last < 0) last = i;
+    }
+    return count;
+  }
+
+  /// Number of lines of the last scan
+  int size ( void ) const { return count; }
+  /// i'th line of the last scan, ordered from left to right
+  const ts_Line & operator[] ( int i ) const { return lines[i]; }
+  /// False if the last scan was cut short by the time budget
+  bool isComplete ( void ) const { return complete; }
+
+  /// The wall on the left to follow: the closest segment of at least
+  /// minLength which lies left of the robot and runs roughly along it.
+  /// @param minLength Minimum segment length in meters
+  /// @param maxDist Maximum segment distance in meters
+  /// @param angle Wall direction relative to the robot heading in radians
+  /// @param dist Perpendicular wall distance of the robot center in meters
+  /// @return False if there is no such wall
+  bool leftWall ( double minLength, double maxDist,
+                  double * angle, double * dist ) const
+  {
+    int best = -1;
+    double bestDist = maxDist;
+    for (int i=0; i<count; i++) {
+      const ts_Line & l = lines[i];
+      if (l.length < minLength || fabs(l.angle) > M_PI/4) continue;
+      double cy;
+      const double d = segmentDist(l, &cy);
+      if (cy <= 0.) continue; // Right of the robot
+      if (d < bestDist) {
+        bestDist = d;
+        best = i;
+      }
+    }
+    if (best < 0) return false;
+    *angle = lines[best].angle;
+    *dist  = lines[best].dist;
+    return true;
+  }
+
+private:
+  double splitDist, jump;
+  int    minPoints;
+  long   budget;
+  const double * px, * py; ///< Beam end points of the current scan
+  std::vector<int> pieces; ///< first/last pairs of the split cluster
+  std::vector<int> stack; ///< Split work list
+  ts_Line lines[MAXLINES];
+  int count;
+  bool complete;
+
+  static long elapsed ( const timeval & start )
+  {
+    timeval now;
+    gettimeofday(&now, 0);
+    return (now.tv_sec - start.tv_sec)*1000000L + now.tv_usec - start.tv_usec;
+  }
+
+  /// Split, merge and fit the beams first..last
+  void cluster ( int first, int last )
+  {
+    if (last - first + 1 < minPoints) return;
+    // Split
+    pieces.clear();
+    stack.clear();
+    stack.push_back(first);
+    stack.push_back(last);
+    while (!stack.empty()) {
+      const int j = stack.back(); stack.pop_back();
+      const int i = stack.back(); stack.pop_back();
+      if (j - i + 1 < minPoints) continue;
+      const double dx = px[j] - px[i], dy = py[j] - py[i];
+      const double len = hypot(dx, dy);
+      if (len < 1e-9) continue;
+      int k = -1;
+      double dmax = splitDist*len;
+      for (int m=i+1; m<j; m++) {
+        const double d = fabs(dx*(py[m] - py[i]) - dy*(px[m] - px[i]));
+        if (d > dmax) {
+          dmax = d;
+          k = m;
+        }
+      }
+      if (k < 0) {
+        pieces.push_back(i);
+        pieces.push_back(j);
+      } else {
+        // Right piece first on the stack, so the left one is done first
+        stack.push_back(i); stack.push_back(k);
+        stack.push_back(k); stack.push_back(j);
+      }
+    }
+
+    // Merge neighbours which fit one line (pieces are ordered left to right)
+    ts_Line cur;
+    bool open = false;
+    for (unsigned int p=0; p<pieces.size(); p+=2) {
+      ts_Line l;
+      if (!fit(pieces[p], pieces[p+1], &l)) continue;
+      if (open) {
+        ts_Line merged;
+        if (fit(l.first, cur.last, &merged) && merged.rms < splitDist/2) {
+          cur = merged;
+          continue;
+        }
+        add(cur);
+      }
+      cur = l;
+      open = true;
+    }
+    if (open) add(cur);
+  }
+
+  void add ( const ts_Line & l )
+  {
+    if (count < MAXLINES) lines[count++] = l;
+  }
+
+  /// Total least squares line through the beams first..last
+  bool fit ( int first, int last, ts_Line * l ) const
+  {
+    const int n = last - first + 1;
+    if (n < 2) return false;
+    double mx = 0., my = 0.;
+    for (int i=first; i<=last; i++) { mx += px[i]; my += py[i]; }
+    mx /= n; my /= n;
+    double sxx = 0., sxy = 0., syy = 0.;
+    for (int i=first; i<=last; i++) {
+      const double x = px[i] - mx, y = py[i] - my;
+      sxx += x*x; sxy += x*y; syy += y*y;
+    }
+    // Direction of the principal axis and the residual across it
+    const double theta = 0.5*atan2(2.*sxy, sxx - syy);
+    const double c = cos(theta), s = sin(theta);
+    const double var = (sxx*s*s - 2.*sxy*s*c + syy*c*c)/n;
+    // End points projected onto the line
+    const double t0 = (px[first] - mx)*c + (py[first] - my)*s;
+    const double t1 = (px[last]  - mx)*c + (py[last]  - my)*s;
+    l->x0 = mx + t0*c; l->y0 = my + t0*s;
+    l->x1 = mx + t1*c; l->y1 = my + t1*s;
+    l->angle  = theta; // cos(theta) >= 0, i.e. pointing forward
+    l->dist   = fabs(mx*s - my*c);
+    l->length = fabs(t1 - t0);
+    l->rms    = sqrt(var > 0. ? var : 0.);
+    l->first  = first;
+    l->last   = last;
+    return true;
+  }
+
+  /// Distance of the robot center to the segment
+  /// @param cy Lateral coordinate of the closest segment point
+  static double segmentDist ( const ts_Line & l, double * cy )
+  {
+    const double dx = l.x1 - l.x0, dy = l.y1 - l.y0;
+    const double len2 = dx*dx + dy*dy;
+    double t = len2 > 0. ? -(l.x0*dx + l.y0*dy)/len2 : 0.;
+    t = std::max(0., std::min(1., t));
+    *cy = l.y0 + t*dy;
+    return hypot(l.x0 + t*dx, *cy);
+  }
+};
+
+#endif
@@ -0,0 +1,252 @@
+/// @file scanmatcher.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Correlative scan to map matcher for correcting odometry drift.
+/// The occupied cells of a GridMap are turned into a likelihood field
+/// (gaussian of the distance to the closest obstacle, one byte per cell) and
+/// into coarser levels where each cell holds the max of the 2^k x 2^k cells
+/// at and above it. A scan point's value at level k is therefore a bound of
+/// its value for every one of the 2^k x 2^k finer translations, which allows
+/// a branch and bound search: per rotation of the search window the
+/// translations are scored at the coarsest level and only the promising
+/// ones are split, best first, down to single cells. The result is the best
+/// pose of the window on the map's grid and the rotation step. Rotations are
+/// shared among threads, which only exchange the best score found so far.
+///
+#ifndef SCANMATCHER_H
+#define SCANMATCHER_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include "scanframe.h"
+#include "distancemap.h"
+
+class ScanMatcher {
+public:
+  /// @param levels Resolution levels, the coarsest pools 2^(levels-1) cells
+  /// @param sigma Likelihood field std. deviation in meters
+  /// @param threads Threads sharing the rotations
+  /// @param points Scan points used at most, evenly subsampled
+  ScanMatcher(int levels = 5, double sigma = 0.1, int threads = 2, int points = 256)
+    : levels(levels), sigma(sigma), threads(threads), maxPoints(points), w(0), h(0),
+      dist(threads) {}
+
+  /// Precompute the likelihood field and its pooled levels from a map
+  void setMap ( const GridMap & map )
+  {
+    w = map.width();
+    h = map.height();
+    res = map.resolution();
+    originX = map.originx();
+    originY = map.originy();
+    dist.compute(map);
+    const float * d = dist.data();
+    grid.resize(levels);
+    grid[0].resize(w*h);
+    const double k = 1./(2.*sigma*sigma);
+    for (int i=0; i<w*h; i++) grid[0][i] = (unsigned char)(255.*exp(-k*d[i]*d[i]) + 0.5);
+    // Level l: max over [x, x+2^l) x [y, y+2^l), from two windows of level l-1
+    for (int l=1; l<levels; l++) {
+      const int s = 1 << (l - 1);
+      const std::vector<unsigned char> & f = grid[l-1];
+      std::vector<unsigned char> & c = grid[l];
+      c.resize(w*h);
+      for (int y=0; y<h; y++)
+        for (int x=0; x<w; x++) {
+          unsigned char v = f[y*w + x];
+          if (x + s < w) v = std::max(v, f[y*w + x + s]);
+          if (y + s < h) {
+            v = std::max(v, f[(y + s)*w + x]);
+            if (x + s < w) v = std::max(v, f[(y + s)*w + x + s]);
+          }
+          c[y*w + x] = v;
+        }
+    }
+  }
+
+  /// Match a scan around an initial pose.
+  /// @param x,y,yaw Initial robot pose in the map
+  /// @param window Translation search window +- in meters
+  /// @param angle Rotation search window +- in radians
+  /// @param mx,my,myaw Best pose
+  /// @return Score in [0, 1], the mean likelihood of the scan points; 0 if
+  ///         there is no map or no point
+  double match ( const ScanFrame & scan, double rangeMin, double rangeMax,
+                 double x, double y, double yaw, double window, double angle,
+                 double * mx, double * my, double * myaw )
+  {
+    *mx = x; *my = y; *myaw = yaw;
+    if (w == 0) return 0.;
+    // Subsampled points in the laser independent robot frame
+    px.clear();
+    py.clear();
+    const double * r = scan.ranges();
+    int valid = 0;
+    for (int i=0; i<scan.size(); i++) valid += r[i] > rangeMin && r[i] < rangeMax;
+    if (valid == 0) return 0.;
+    const int stride = (valid + maxPoints - 1)/maxPoints;
+    double rmax = 0.;
+    for (int i=0, k=0; i<scan.size(); i++) {
+      if (!(r[i] > rangeMin && r[i] < rangeMax)) continue;
+      if (k++ % stride) continue;
+      px.push_back(scan.x()[i]);
+      py.push_back(scan.y()[i]);
+      rmax = std::max(rmax, hypot(scan.x()[i], scan.y()[i]));
+    }
+    // Rotation step moving the farthest point by about a cell
+    const double step = acos(std::max(-1., 1. - res*res/(2.*rmax*rmax)));
+    nRot = 2*(int)ceil(angle/step) + 1;
+    rotStep = nRot > 1 ? 2.*angle/(nRot - 1) : 0.;
+    rot0 = yaw - angle;
+    win = (int)ceil(window/res);
+    // Initial position on the grid, the translations are whole cells from it
+    cx0 = (x - originX)/res;
+    cy0 = (y - originY)/res;
+    best = 0;
+    bestRot = nRot/2;
+    bestDx = bestDy = 0;
+    next = 0;
+    pthread_mutex_init(&lock, 0);
+    std::vector<pthread_t> tid(std::max(0, threads - 1));
+    for (unsigned int t=0; t<tid.size(); t++)
+      if (pthread_create(&tid[t], 0, worker, this) != 0) tid.resize(t);
+    search();
+    for (unsigned int t=0; t<tid.size(); t++) pthread_join(tid[t], 0);
+    pthread_mutex_destroy(&lock);
+    *mx = x + bestDx*res;
+    *my = y + bestDy*res;
+    *myaw = rot0 + bestRot*rotStep;
+    return best/(255.*px.size());
+  }
+
+private:
+  int levels;
+  double sigma;
+  int threads, maxPoints;
+  int w, h;
+  double res, originX, originY;
+  DistanceMap dist;           ///< Obstacle distances of the map
+  std::vector< std::vector<unsigned char> > grid; ///< Likelihood, pooled per level
+
+  // Current match
+  std::vector<double> px, py; ///< Scan points, robot coordinates
+  int nRot, win;
+  double rotStep, rot0, cx0, cy0;
+  pthread_mutex_t lock;       ///< Guards next and the best result
+  int next;                   ///< Next rotation to search
+  long best;                  ///< Best score so far
+  int bestRot, bestDx, bestDy;
+
+  /// Translation candidate of a level
+  struct Candidate {
+    int dx, dy;
+    long score;
+    bool operator< ( const Candidate & c ) const { return score > c.score; }
+  };
+
+  static void * worker ( void * self )
+  {
+    static_cast<ScanMatcher *>(self)->search();
+    return 0;
+  }
+
+  /// Take rotations until all are searched
+  void search ( void )
+  {
+    std::vector<int> ix(px.size()), iy(px.size());
+    std::vector<Candidate> cand;
+    for (;;) {
+      pthread_mutex_lock(&lock);
+      const int k = next++;
+      long bound = best;
+      pthread_mutex_unlock(&lock);
+      if (k >= nRot) return;
+      // From the initial rotation outwards, good bounds come early
+      const int r = nRot/2 + (k % 2 ? (k + 1)/2 : -k/2);
+      // Points rotated, cells relative to the window's lower left corner
+      const double a = rot0 + r*rotStep, c = cos(a), s = sin(a);
+      for (unsigned int i=0; i<px.size(); i++) {
+        ix[i] = (int)floor(cx0 + (c*px[i] - s*py[i])/res) - win;
+        iy[i] = (int)floor(cy0 + (s*px[i] + c*py[i])/res) - win;
+      }
+      // Coarsest level covering the window
+      const int top = levels - 1, size = 1 << top;
+      cand.clear();
+      for (int dy=0; dy<=2*win; dy+=size)
+        for (int dx=0; dx<=2*win; dx+=size) {
+          Candidate t = { dx, dy, score(top, ix, iy, dx, dy) };
+          cand.push_back(t);
+        }
+      std::sort(cand.begin(), cand.end());
+      int bx = 0, by = 0;
+      if (branch(top, cand, ix, iy, &bound, &bx, &by)) {
+        pthread_mutex_lock(&lock);
+        // Ties go to the rotation closest to the initial one
+        if (bound > best || (bound == best && abs(r - nRot/2) < abs(bestRot - nRot/2))) {
+          best = bound;
+          bestRot = r;
+          bestDx = bx - win;
+          bestDy = by - win;
+        }
+        pthread_mutex_unlock(&lock);
+      }
+    }
+  }
+
+  /// Best first search below the sorted candidates of a level
+  /// @return True if a translation better than bound was found
+  bool branch ( int level, const std::vector<Candidate> & cand,
+                const std::vector<int> & ix, const std::vector<int> & iy,
+                long * bound, int * bx, int * by ) const
+  {
+    bool found = false;
+    for (unsigned int k=0; k<cand.size() && cand[k].score > *bound; k++) {
+      if (level == 0) {
+        *bound = cand[k].score;
+        *bx = cand[k].dx;
+        *by = cand[k].dy;
+        return true;
+      }
+      const int half = 1 << (level - 1);
+      std::vector<Candidate> sub;
+      for (int j=0; j<2; j++)
+        for (int i=0; i<2; i++) {
+          const int dx = cand[k].dx + i*half, dy = cand[k].dy + j*half;
+          if (dx > 2*win || dy > 2*win) continue;
+          Candidate c = { dx, dy, score(level - 1, ix, iy, dx, dy) };
+          sub.push_back(c);
+        }
+      std::sort(sub.begin(), sub.end());
+      found |= branch(level - 1, sub, ix, iy, bound, bx, by);
+    }
+    return found;
+  }
+
+  /// Sum of the level's values at the points moved by (dx, dy) cells.
+  /// Points up to 2^level - 1 cells left of or below the map are scored at
+  /// its border, which covers the part of their window inside.
+  long score ( int level, const std::vector<int> & ix, const std::vector<int> & iy,
+               int dx, int dy ) const
+  {
+    const unsigned char * g = &grid[level][0];
+    const int size = 1 << level;
+    long sum = 0;
+    for (unsigned int i=0; i<ix.size(); i++) {
+      int x = ix[i] + dx, y = iy[i] + dy;
+      if (x < 0 && x > -size) x = 0;
+      if (y < 0 && y > -size) y = 0;
+      if ((unsigned)x < (unsigned)w && (unsigned)y < (unsigned)h) sum += g[y*w + x];
+    }
+    return sum;
+  }
+};
+
+#endif
@@ -0,0 +1,187 @@
+/// @file tilemap.h
+/// @author Sebastian Rockel
+///
+/// @par Copyright
+/// Copyright (C) 2009 Sebastian Rockel.
+/// This program can be distributed and modified under the condition mentioning
+/// the @ref author.
+///
+/// @par Description
+/// Sparse grid of cells stored in square tiles (64x64 cells by default)
+/// which are allocated when a cell in them is first written, so memory
+/// scales with the area touched instead of the bounding box. Tiles are found
+/// through a directory of tile pointers (the second level), which grows to
+/// cover new tiles; it holds one pointer per tile of the bounding box only.
+/// Cell coordinates may be negative. Cells of missing tiles read the fill
+/// value. Ray walks cells along a line with the tile looked up only when the
+/// line crosses into the next one, Tiles walks the allocated tiles for
+/// export.
+///
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+template <class T, int BITS = 6>
+class TileMap {
+public:
+  static const int TILE = 1 << BITS; ///< Cells per tile side
+  static const int MASK = TILE - 1;
+
+  TileMap(T fill = T()) : fill(fill), tx0(0), ty0(0), dw(0), dh(0), count(0) {}
+  ~TileMap() { clear(); }
+
+  /// Free all tiles
+  void clear ( void )
+  {
+    for (unsigned int i=0; i<dir.size(); i++) delete [] dir[i];
+    dir.clear();
+    tx0 = ty0 = dw = dh = count = 0;
+  }
+
+  /// Cell value, the fill value if its tile is not allocated
+  T get ( int cx, int cy ) const
+  {
+    const T * t = tile(cx >> BITS, cy >> BITS);
+    return t ? t[((cy & MASK) << BITS) + (cx & MASK)] : fill;
+  }
+
+  /// Writable cell, its tile is allocated if needed
+  T & at ( int cx, int cy )
+  {
+    return touch(cx >> BITS, cy >> BITS)[((cy & MASK) << BITS) + (cx & MASK)];
+  }
+
+  /// Tile by tile coordinates, 0 if not allocated
+  const T * tile ( int tx, int ty ) const
+  {
+    const unsigned int ix = tx - tx0, iy = ty - ty0;
+    return ix < (unsigned)dw && iy < (unsigned)dh ? dir[iy*dw + ix] : 0;
+  }
+
+  /// Tile by tile coordinates, allocated and filled if needed
+  T * touch ( int tx, int ty )
+  {
+    unsigned int ix = tx - tx0, iy = ty - ty0;
+    if (ix >= (unsigned)dw || iy >= (unsigned)dh) {
+      grow(tx, ty);
+      ix = tx - tx0;
+      iy = ty - ty0;
+    }
+    T * & t = dir[iy*dw + ix];
+    if (!t) {
+      t = new T[TILE*TILE];
+      std::fill(t, t + TILE*TILE, fill);
+      count++;
+    }
+    return t;
+  }
+
+  /// Number of allocated tiles
+  int tiles ( void ) const { return count; }
+  /// Memory of the tiles and the directory in bytes
+  size_t bytes ( void ) const
+  {
+    return (size_t)count*TILE*TILE*sizeof(T) + dir.size()*sizeof(T*);
+  }
+
+  /// Cells along the line from (x0, y0) to (x1, y1), both included
+  class Ray {
+  public:
+    Ray(TileMap & map, int x0, int y0, int x1, int y1)
+      : map(map), cx(x0), cy(y0),
+        dx(std::abs(x1 - x0)), dy(-std::abs(y1 - y0)),
+        sx(x0 < x1 ? 1 : -1), sy(y0 < y1 ? 1 : -1),
+        err(dx + dy), left(std::max(dx, -dy)) { lookup(); }
+
+    /// False once past the end cell
+    bool valid ( void ) const { return left >= 0; }
+    /// True at the end cell
+    bool last ( void ) const { return left == 0; }
+    int x ( void ) const { return cx; }
+    int y ( void ) const { return cy; }
+    /// Current cell, allocated if needed
+    T & operator* ( void )
+    {
+      if (!tile) tile = map.touch(cx >> BITS, cy >> BITS);
+      return tile[((cy & MASK) << BITS) + (cx & MASK)];
+    }
+    /// Current cell, the fill value if not allocated
+    T value ( void ) const
+    {
+      return tile ? tile[((cy & MASK) << BITS) + (cx & MASK)] : map.fill;
+    }
+    void next ( void )
+    {
+      const int e2 = 2*err;
+      int mx = 0, my = 0;
+      if (e2 >= dy) { err += dy; mx = sx; }
+      if (e2 <= dx) { err += dx; my = sy; }
+      // Look up the tile only when crossing its border
+      const bool cross = ((cx & MASK) + mx) & ~MASK || ((cy & MASK) + my) & ~MASK;
+      cx += mx;
+      cy += my;
+      left--;
+      if (cross) lookup();
+    }
+
+  private:
+    TileMap & map;
+    int cx, cy, dx, dy, sx, sy, err;
+    int left; ///< Steps to the end cell
+    T * tile; ///< Tile of the current cell, 0 if not allocated
+
+    void lookup ( void ) { tile = const_cast<T *>(map.tile(cx >> BITS, cy >> BITS)); }
+  };
+
+  /// Allocated tiles in directory order
+  class Tiles {
+  public:
+    Tiles(const TileMap & map) : map(map), i(-1) { next(); }
+    bool valid ( void ) const { return i < (int)map.dir.size(); }
+    /// Tile coordinates, the first cell is (x()*TILE, y()*TILE)
+    int x ( void ) const { return map.tx0 + i % map.dw; }
+    int y ( void ) const { return map.ty0 + i / map.dw; }
+    const T * operator* ( void ) const { return map.dir[i]; }
+    void next ( void )
+    {
+      do i++; while (i < (int)map.dir.size() && !map.dir[i]);
+    }
+  private:
+    const TileMap & map;
+    int i;
+  };
+
+private:
+  T fill;
+  int tx0, ty0, dw, dh;  ///< Directory origin and size in tiles
+  int count;
+  std::vector<T *> dir;  ///< Tile pointers, row by row
+
+  TileMap(const TileMap &);
+  TileMap & operator= (const TileMap &);
+
+  /// Extend the directory to cover tile (tx, ty), with some slack
+  void grow ( int tx, int ty )
+  {
+    int nx0 = tx0, ny0 = ty0, nx1 = tx0 + dw, ny1 = ty0 + dh;
+    if (dw == 0) {
+      nx0 = tx; ny0 = ty; nx1 = tx + 1; ny1 = ty + 1;
+    }
+    if (tx <  nx0) nx0 = tx - (nx1 - tx)/2;
+    if (tx >= nx1) nx1 = tx + 1 + (tx - nx0)/2;
+    if (ty <  ny0) ny0 = ty - (ny1 - ty)/2;
+    if (ty >= ny1) ny1 = ty + 1 + (ty - ny0)/2;
+    std::vector<T *> d((nx1 - nx0)*(ny1 - ny0), (T *)0);
+    for (int y=0; y<dh; y++)
+      for (int x=0; x<dw; x++)
+        d[(ty0 + y - ny0)*(nx1 - nx0) + tx0 + x - nx0] = dir[y*dw + x];
+    dir.swap(d);
+    tx0 = nx0; ty0 = ny0;
+    dw = nx1 - nx0; dh = ny1 - ny0;
+  }
+};
+
+#endif
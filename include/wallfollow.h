@@ -12,9 +12,13 @@
 /// Some global definitions here
 ///
 const double TRACKING_NO = 10 * M_PI;///< Disable camera tracking
+const int BALLBATCH = 8;///< Max number of balls reported per detection
 
+/// Ball candidates of one detection, sorted by descending confidence.
 struct ts_Ball {
   int num;
-  double dist;
-  double angle;
+  double dist[BALLBATCH];  ///< Distance in meters
+  double angle[BALLBATCH]; ///< Bearing in radians
+  double conf[BALLBATCH];  ///< Detection confidence 0..1
+  double stamp;            ///< Capture time of the frame in seconds
 };
@@ -0,0 +1,69 @@
+/// @file ballreplay.cpp
+/// @author Sebastian Rockel
+///
+/// Replays a raw frame archive (see cc_framearchive.h) through
+/// BallFinder::DetectBall as fast as possible. Needs no camera and no X
+/// server.
+///
+/// Detection results go to stdout, one line per frame, to be diffed between
+/// versions of the detector:
+/// @code frame stamp num [dist angle conf]... @endcode
+/// Throughput and per stage timing go to stderr.
+/// Has to be started from the repository root since BallFinder loads
+/// include/learning.svm relative to it.
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "cc_framearchive.h"
+#include "cc_ballfinder.h"
+
+static const char *stageName[BF_STAGES] = {
+  "convert", "threshold", "smooth", "contours", "hough", "distance"
+};
+
+int main (int argc, char **argv)
+{
+  FrameArchive archive;
+  BallFinder fb;
+  const Ball *balls;
+  timeval start, stop;
+  double total;
+  int passes = 1;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <archive> [passes]\n", argv[0]);
+    return -1;
+  }
+  if (argc > 2) passes = atoi(argv[2]);
+  if (!archive.open(argv[1])) return -1;
+  if (archive.frameCount() == 0) {
+    fprintf(stderr, "Archive %s holds no frames\n", argv[1]);
+    return -1;
+  }
+  fb.Init(archive.getWidth(), archive.getHeight(), false);
+
+  gettimeofday(&start, 0);
+  for (int pass = 0; pass < passes; pass++) {
+    archive.seek(0);
+    while (archive.captureImage()) {
+      balls = fb.DetectBall(archive.captureBuf);
+      if (pass == 0) { // Identical on each pass
+        printf("%05u %.3f %d", archive.frameNum(), archive.captureTime, balls->num);
+        for (int i = 0; i < balls->num; i++)
+          printf(" %.4f %+.4f %.2f", balls->dist[i], balls->angle[i], balls->conf[i]);
+        printf("\n");
+      }
+    }
+  }
+  gettimeofday(&stop, 0);
+  total = (stop.tv_sec - start.tv_sec) * 1e3 + (stop.tv_usec - start.tv_usec) / 1e3;
+
+  fprintf(stderr, "%u frames in %.1f ms: %.2f frames/s\n",
+      fb.frames, total, fb.frames * 1e3 / total);
+  for (int i = 0; i < BF_STAGES; i++)
+    fprintf(stderr, "  %-10s %8.3f ms/frame\n", stageName[i], fb.stageTime[i] / fb.frames);
+
+  fb.Over();
+  archive.cleanup();
+  return 0;
+}
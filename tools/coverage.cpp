@@ -0,0 +1,114 @@
+/// @file coverage.cpp
+/// @author Sebastian Rockel
+///
+/// Coverage statistics (see coverage.h) of Player writelog files, to compare
+/// runs with different behaviour parameters. Every log is replayed as one
+/// run, scans placed at the latest odometry pose from the start pose of the
+/// online map (-7, -7, 90 deg) as mapbuild does. Reports per run the area
+/// covered and its rate, the revisit ratio, the time to 50 % and 90 % of a
+/// reference area (the -a argument, else the area the run covered in the
+/// end) and the area after each minute.
+/// Usage: coverage [-r useful range] [-a area] logfile ...
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "playerlog.h"
+#include "coverage.h"
+
+const double LASERMOUNT = 0.13; ///< Laser offset in front of robot center in meters
+const double LPMIN    = 0.02;   ///< Min valid laser range in meters
+const double RES      = 0.08;   ///< Cell size in meters, as the online map
+const double STARTX   = -7.;    ///< Start pose in the map in meters
+const double STARTY   = -7.;
+const double STARTYAW = 90.;    ///< Start orientation in deg
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+/// Time as "123 s" or "-" if not reached
+static const char * seconds ( double t, char * buf )
+{
+  if (t < 0.) strcpy(buf, "-");
+  else sprintf(buf, "%.0f s", t);
+  return buf;
+}
+
+/// Replay a log into a coverage, false if it cannot be read
+static bool run ( const char * file, double range, double reference )
+{
+  PlayerLog log;
+  if (!log.open(file)) {
+    fprintf(stderr, "Cannot open %s\n", file);
+    return false;
+  }
+  Coverage cov(RES, range);
+  ScanFrame frame;
+  const double c = cos(STARTYAW*M_PI/180.), s = sin(STARTYAW*M_PI/180.);
+  double x = STARTX, y = STARTY, yaw = STARTYAW*M_PI/180.;
+  double travel = 0., usec = 0.;
+  bool posed = false;
+  PlayerLog::RecordType r;
+  while ((r = log.next()) != PlayerLog::END) {
+    if (r == PlayerLog::POSE) {
+      // Odometry relative to the start pose
+      const double nx = STARTX + c*log.pose.x - s*log.pose.y;
+      const double ny = STARTY + s*log.pose.x + c*log.pose.y;
+      if (posed) travel += hypot(nx - x, ny - y);
+      x = nx;
+      y = ny;
+      yaw = STARTYAW*M_PI/180. + log.pose.yaw;
+      posed = true;
+      continue;
+    }
+    timeval t0;
+    gettimeofday(&t0, 0);
+    frame.set(&log.scan.ranges[0], log.scan.ranges.size(), log.scan.angleMin,
+        log.scan.angleRes, LASERMOUNT);
+    cov.addScan(frame, LPMIN, x, y, yaw, log.scan.time);
+    usec += usecSince(t0);
+  }
+  if (cov.scanCount() == 0) {
+    fprintf(stderr, "%s: no scans\n", file);
+    return false;
+  }
+  const double ref = reference > 0. ? reference : cov.area();
+  char t50[32], t90[32];
+  printf("%s: %d scans over %.1f min, %.0f m driven, %.0f us/scan\n", file,
+      cov.scanCount(), cov.duration()/60., travel, usec/cov.scanCount());
+  printf("  covered %.1f m^2 (%.1f m^2/min) within %.1f m, revisits %.0f%%, "
+      "50%% / 90%% of %.0f m^2 after %s / %s\n", cov.area(), cov.rate(), range,
+      100.*cov.revisitRatio(), ref, seconds(cov.timeTo(0.5*ref), t50),
+      seconds(cov.timeTo(0.9*ref), t90));
+  printf("  m^2 after each minute:");
+  const std::vector<ts_CoverageSample> & h = cov.history();
+  for (unsigned int i=0, minute=1; i<h.size(); i++) {
+    if (h[i].time < 60.*minute) continue;
+    printf(" %.1f", h[i].area);
+    minute++;
+  }
+  printf(" %.1f\n", cov.area());
+  return true;
+}
+
+int main ( int argc, char **argv )
+{
+  double range = 3., reference = 0.;
+  int f = 1;
+  for (; f+1<argc && argv[f][0] == '-'; f+=2) {
+    if (!strcmp(argv[f], "-r")) range = atof(argv[f+1]);
+    else if (!strcmp(argv[f], "-a")) reference = atof(argv[f+1]);
+    else break;
+  }
+  if (f >= argc || argv[f][0] == '-' || range <= 0.) {
+    fprintf(stderr, "Usage: %s [-r useful range] [-a area] logfile ...\n", argv[0]);
+    return -1;
+  }
+  int failed = 0;
+  for (; f<argc; f++) failed += !run(argv[f], range, reference);
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,81 @@
+/// @file cspace.cpp
+/// @author Sebastian Rockel
+///
+/// Builds the configuration space of a map image (see costmap.h) as the
+/// wavefront driver of the pnav_ex configurations does, and exports it as
+/// PGM for the mapfile driver and playernav. Reports the time until a
+/// planner could start: cold (distance transform and costs computed and
+/// written to the cache) and warm (both mapped from the cache), the case of
+/// every later start.
+/// Usage: cspace <map image> <resolution> <origin x> <origin y>
+///        [safety_dist] [out.pgm] [cachedir]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "costmap.h"
+
+const double INFLATION = 0.5;   ///< Cost decay distance beyond safety_dist in meters
+const int    THREADS   = 2;     ///< Threads of the transform and the costs
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+int main ( int argc, char **argv )
+{
+  if (argc < 5) {
+    fprintf(stderr, "Usage: %s <map image> <resolution> <origin x> <origin y> "
+        "[safety_dist] [out.pgm] [cachedir]\n", argv[0]);
+    return -1;
+  }
+  const double safety = argc > 5 ? atof(argv[5]) : 0.5;
+  const char * dir = argc > 7 ? argv[7] : "/tmp/mapcache";
+  timeval t0;
+  gettimeofday(&t0, 0);
+  GridMap map;
+  if (!map.readImage(argv[1], atof(argv[2]), atof(argv[3]), atof(argv[4]))) {
+    fprintf(stderr, "Cannot read %s\n", argv[1]);
+    return -1;
+  }
+  printf("%s: %dx%d at %.3f m, read in %.1f ms\n", argv[1], map.width(), map.height(),
+      map.resolution(), usecSince(t0)/1e3);
+
+  // Cold start, then a restart
+  for (int run=0; run<2; run++) {
+    if (run == 0) {
+      remove(MapCache::file(dir, "edt", DistanceMap::hash(map)).c_str());
+    }
+    gettimeofday(&t0, 0);
+    DistanceMap dist(THREADS);
+    const bool edtCached = dist.load(map, dir);
+    const double edt = usecSince(t0);
+    CostMap cspace(THREADS);
+    if (run == 0) {
+      // Drop a cached C-space of the same parameters
+      const double param[2] = { safety, INFLATION };
+      remove(MapCache::file(dir, "cspace",
+            MapCache::fnv(dist.contentHash(), param, sizeof(param))).c_str());
+    }
+    const bool costCached = cspace.load(map, dist, dir, safety, INFLATION);
+    const double total = usecSince(t0);
+    int blocked = 0;
+    for (int i=0; i<map.width()*map.height(); i++)
+      blocked += cspace.data()[i] >= CostMap::INSCRIBED;
+    printf("%s: distances %s in %.2f ms, C-space (safety_dist %.2f m) %s, ready after %.2f ms; "
+        "%.1f%% of the cells blocked\n", run == 0 ? "cold" : "warm",
+        edtCached ? "mapped" : "computed", edt/1e3, safety, costCached ? "mapped" : "computed",
+        total/1e3, 100.*blocked/(map.width()*map.height()));
+    if (run == 1 && argc > 6) {
+      if (!cspace.writePgm(argv[6])) {
+        fprintf(stderr, "Cannot write %s\n", argv[6]);
+        return -1;
+      }
+      printf("mapfile: filename \"%s\" resolution %.3f origin [%.1f %.1f]\n", argv[6],
+          map.resolution(), map.originx(), map.originy());
+    }
+  }
+  return 0;
+}
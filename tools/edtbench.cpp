@@ -0,0 +1,101 @@
+/// @file edtbench.cpp
+/// @author Sebastian Rockel
+///
+/// Benchmarks the distance transform of map bitmaps (see distancemap.h):
+/// per map the image is read, transformed with 1, 2 and 4 threads, checked
+/// against brute force distances at random cells, and then loaded twice
+/// through the cache (the first load computes and writes it, the second
+/// maps it). The maps of the stage worlds and navloc configurations are
+/// used, missing ones are skipped. Usage: edtbench [cachedir]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "distancemap.h"
+
+/// Map image with its resolution and lower left corner
+struct MapFile {
+  const char * file;
+  double res, originX, originY;
+};
+
+const MapFile MAPS[] = {
+  { "pnav_ex/bitmaps/cave.png", 0.032, -8., -8. },       // pnav_navloc.cfg
+  { "pnav_ex/bitmaps/tams_compl_fine2.pgm", 0.08, 0., 0. }, // tams_navloc.cfg
+  { "pnav_ex/bitmaps/tams_compl.png", 0.015, -8., -8. },
+  { "stage_local/bitmaps/tams_corr_orig_cut_q_05.png", 0.05, -8., -8. }, // uhh.world
+  { "stage_local/bitmaps/hospital.png", 0.05, 0., 0. } };      // stage example
+const int  CHECKS = 2000;  ///< Cells checked against brute force
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+/// Largest error of the transform at random cells, brute force over the
+/// occupied cells
+static double check ( const GridMap & map, const DistanceMap & dist )
+{
+  std::vector<int> ox, oy;
+  for (int y=0; y<map.height(); y++)
+    for (int x=0; x<map.width(); x++)
+      if (map.state(x, y) > 0) { ox.push_back(x); oy.push_back(y); }
+  if (ox.empty()) return 0.;
+  double err = 0.;
+  for (int k=0; k<CHECKS; k++) {
+    const int x = rand() % map.width(), y = rand() % map.height();
+    long best = -1;
+    for (unsigned int i=0; i<ox.size(); i++) {
+      const long d = (long)(ox[i] - x)*(ox[i] - x) + (long)(oy[i] - y)*(oy[i] - y);
+      if (best < 0 || d < best) best = d;
+    }
+    err = std::max(err, fabs(dist.at(x, y) - sqrt((double)best)*map.resolution()));
+  }
+  return err;
+}
+
+int main ( int argc, char **argv )
+{
+  const char * dir = argc > 1 ? argv[1] : "/tmp/mapcache";
+  srand(1);
+  for (unsigned int m=0; m<sizeof(MAPS)/sizeof(MAPS[0]); m++) {
+    GridMap map;
+    timeval t0;
+    gettimeofday(&t0, 0);
+    if (!map.readImage(MAPS[m].file, MAPS[m].res, MAPS[m].originX, MAPS[m].originY)) {
+      printf("%s: cannot read, skipped\n", MAPS[m].file);
+      continue;
+    }
+    const double read = usecSince(t0);
+    gettimeofday(&t0, 0);
+    const unsigned long long key = DistanceMap::hash(map);
+    const double hash = usecSince(t0);
+    printf("%s: %dx%d at %.3f m, read %.1f ms, hash %016llx in %.1f ms\n", MAPS[m].file,
+        map.width(), map.height(), map.resolution(), read/1e3, key, hash/1e3);
+    const int threads[] = { 1, 2, 4 };
+    for (unsigned int t=0; t<sizeof(threads)/sizeof(threads[0]); t++) {
+      DistanceMap dist(threads[t]);
+      gettimeofday(&t0, 0);
+      dist.compute(map);
+      const double us = usecSince(t0);
+      printf("  %d thread(s): transform %.1f ms", threads[t], us/1e3);
+      if (t == 0) printf(", max error %.4f m at %d cells", check(map, dist), CHECKS);
+      printf("\n");
+    }
+    // Start without a cache file
+    remove(MapCache::file(dir, "edt", key).c_str());
+    for (int run=0; run<2; run++) {
+      DistanceMap dist;
+      gettimeofday(&t0, 0);
+      const bool cached = dist.load(map, dir);
+      const double us = usecSince(t0);
+      // Touch every page so the mapped load pays for its reads
+      volatile float sink = 0.f;
+      for (int i=0; i<map.width()*map.height(); i+=1024) sink = sink + dist.data()[i];
+      printf("  load %s: %.2f ms (%.2f ms with the pages touched)\n",
+          cached ? "mapped from cache" : "computed and cached", us/1e3, usecSince(t0)/1e3);
+    }
+  }
+  return 0;
+}
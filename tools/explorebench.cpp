@@ -0,0 +1,219 @@
+/// @file explorebench.cpp
+/// @author Sebastian Rockel
+///
+/// Compares frontier exploration (see frontiers.h) with left wall following
+/// in the maps of the stage worlds. A robot with the Hokuyo of wallfollow.cpp
+/// (240 deg, 5 m, scans cast in the map) builds the online map (16 m x 16 m,
+/// 0.08 m cells as MAPPING) at 10 Hz from exact poses, driving 0.3 m/s either
+/// - with the wall following law of wallfollow.cpp (left front sector kept
+///   at WALLFOLLOWDIST, going straight while searching a wall, turning right
+///   when the front is blocked), or
+/// - to frontier targets: the C-space of the online map is rebuilt, the
+///   frontiers updated from the cells the scan changed, a target selected
+///   every 2 s or when it is gone, and the D* Lite path followed 1 m ahead.
+/// Reports the area mapped over time in m^2 per minute and the time the
+/// exploration takes per cycle. Usage: explorebench [minutes]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "gridmap.h"
+#include "distancemap.h"
+#include "costmap.h"
+#include "dstarlite.h"
+#include "frontiers.h"
+
+/// Map image with its resolution, lower left corner and the start pose
+struct World {
+  const char * file;
+  double res, originX, originY;
+  double x, y, yaw;
+};
+
+const World WORLDS[] = {
+  { "stage_local/bitmaps/tams_corr_orig_cut_q_05.png", 0.05, -8., -8., -6., -5., 0. }, // uhh.world
+  { "pnav_ex/bitmaps/cave.png", 0.032, -8., -8., -7., -7., 45. } };              // pnav_stage.world
+const double CYCLE      = 0.1;   ///< Control cycle in seconds
+const double VEL        = 0.3;   ///< Speed in meters per sec.
+const double TURN_RATE  = 40;    ///< Max turnrate in deg per sec.
+const double STOP_ROT   = 30;    ///< Turnrate when the front is blocked in deg per sec.
+const double RADIUS     = 0.22;  ///< Robot radius in meters
+const double LASERMOUNT = 0.13;  ///< Laser in front of the robot center in meters
+const double LPMAX      = 5.0;   ///< Laser range in meters
+const int    BEAMS      = 241;   ///< Laser beams over 240 deg
+const double WALLFOLLOWDIST = 0.5;  ///< Wall following distance in meters
+const double WALLLOSTDIST   = 1.5;  ///< Wall lost beyond in meters
+const double WALLGAIN       = 4;    ///< Wall distance error to turnrate gain
+const double SHAPE_DIST     = 0.3;  ///< Robot shape from the laser in meters
+const double DIAGOFFSET     = 0.1;  ///< Diagonal sector offset in meters
+const double HORZOFFSET     = 0.15; ///< Side sector offset in meters
+const double COS45          = 0.83867056795; ///< Cos(33)
+const double STOPDIST       = 0.2;  ///< Front distance turning right in meters
+const double MAP_SIZE   = 16;    ///< Online map side length in meters
+const double MAP_RES    = 0.08;  ///< Online map cell size in meters
+const double SAFETY     = 0.3;   ///< C-space safety distance in meters
+const double INFLATION  = 0.5;   ///< Cost decay distance in meters
+const double LOOKAHEAD  = 1.;    ///< Path point followed in meters
+const int    SELECT     = 20;    ///< Cycles between target selections
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+/// Range to the first occupied cell, half cell steps; off the map nothing
+static double cast ( const GridMap & map, double x, double y, double a )
+{
+  const double c = cos(a), s = sin(a), step = map.resolution()/2;
+  for (double d=0.; d<LPMAX; d+=step) {
+    const int cx = map.cellX(x + d*c), cy = map.cellY(y + d*s);
+    if (!map.inside(cx, cy)) break;
+    if (map.state(cx, cy) > 0) return d;
+  }
+  return LPMAX;
+}
+
+/// Minimum range over laser angles [from, to) in deg, 0 deg right, 120 ahead
+static double sector ( const ScanFrame & scan, int from, int to )
+{
+  double m = LPMAX;
+  for (int i=from*(BEAMS - 1)/240; i<to*(BEAMS - 1)/240; i++) m = std::min(m, scan.ranges()[i]);
+  return m;
+}
+
+/// Turnrate of the wall following law
+static double wallfollow ( const ScanFrame & scan )
+{
+  const double lfov = sector(scan, 140, 175) - DIAGOFFSET - SHAPE_DIST;
+  const double left = sector(scan, 175, 240) - HORZOFFSET - SHAPE_DIST;
+  if (lfov >= WALLLOSTDIST && left >= WALLLOSTDIST) return 0.;
+  const double t = atan((COS45*lfov - WALLFOLLOWDIST)*WALLGAIN);
+  return std::max(-TURN_RATE*M_PI/180., std::min(TURN_RATE*M_PI/180., t));
+}
+
+/// Frontier exploration state
+struct Explorer {
+  DistanceMap dist;
+  CostMap     costs;
+  DStarLite   planner;
+  Frontiers   frontiers;
+  std::vector<double> px, py;
+  int    cycles;
+  bool   hasTarget, valid;
+  int    tx, ty;          ///< Target cell
+  double usec, usecMax;   ///< Time of the cycles
+
+  Explorer() : cycles(0), hasTarget(false), valid(false), tx(0), ty(0), usec(0.), usecMax(0.) {}
+
+  /// Turnrate towards the path, false if there is nothing left to explore
+  bool step ( const GridMap & map, double x, double y, double yaw, double * turn )
+  {
+    timeval t0;
+    gettimeofday(&t0, 0);
+    dist.compute(map);
+    costs.build(map, dist, SAFETY, INFLATION);
+    frontiers.update(map);
+    if (cycles == 0) planner.setMap(costs);
+    else planner.update(costs);
+    planner.setStart(x, y);
+    if (cycles % SELECT == 0 || !hasTarget || !valid || !frontiers.isFrontier(tx, ty)) {
+      const int best = frontiers.select(costs, x, y);
+      if (best >= 0) {
+        const ts_Frontier & f = frontiers.clusters()[best];
+        if (!hasTarget || f.cx != tx || f.cy != ty) planner.setGoal(f.x, f.y);
+        tx = f.cx;
+        ty = f.cy;
+      }
+      hasTarget = best >= 0;
+    }
+    valid = hasTarget && planner.replan() && planner.path(px, py);
+    cycles++;
+    const double us = usecSince(t0);
+    usec += us;
+    usecMax = std::max(usecMax, us);
+    if (!valid) return false;
+    // Path point LOOKAHEAD ahead
+    unsigned int i = 1;
+    for (double d=0.; i+1<px.size(); i++) {
+      d += hypot(px[i] - px[i-1], py[i] - py[i-1]);
+      if (d >= LOOKAHEAD) break;
+    }
+    i = std::min(i, (unsigned int)px.size() - 1);
+    const double a = atan2(py[i] - y, px[i] - x) - yaw;
+    *turn = std::max(-TURN_RATE*M_PI/180., std::min(TURN_RATE*M_PI/180., 2.*atan2(sin(a), cos(a))));
+    return true;
+  }
+};
+
+static void run ( const World & wd, bool explore, double minutes, double truth )
+{
+  GridMap world;
+  world.readImage(wd.file, wd.res, wd.originX, wd.originY);
+  DistanceMap clearance;
+  clearance.compute(world);
+  GridMap map(MAP_SIZE, MAP_SIZE, MAP_RES, -MAP_SIZE/2, -MAP_SIZE/2);
+  Explorer ex;
+  ScanFrame scan;
+  double x = wd.x, y = wd.y, yaw = wd.yaw*M_PI/180.;
+  double travel = 0.;
+  int stuck = 0;
+  const int cycles = (int)(minutes*60./CYCLE);
+  printf("  %-16s", explore ? "frontiers" : "wall following");
+  int done = -1;
+  for (int c=0; c<cycles; c++) {
+    scan.setGeometry(BEAMS, -120.*M_PI/180., M_PI/180., LASERMOUNT);
+    const double lx = x + LASERMOUNT*cos(yaw), ly = y + LASERMOUNT*sin(yaw);
+    for (int i=0; i<BEAMS; i++) scan.ranges()[i] = cast(world, lx, ly, yaw + scan.angle(i));
+    scan.convert();
+    map.addScan(scan, 0.02, LPMAX, x, y, yaw);
+    double turn = 0.;
+    if (explore) {
+      if (!ex.step(map, x, y, yaw, &turn) && done < 0) done = c;
+    } else {
+      turn = wallfollow(scan);
+    }
+    double v = VEL*std::max(0., cos(turn));
+    if (sector(scan, 90, 150) - SHAPE_DIST < STOPDIST) {
+      v = 0.;
+      turn = -STOP_ROT*M_PI/180.;
+    }
+    const double nx = x + v*CYCLE*cos(yaw), ny = y + v*CYCLE*sin(yaw);
+    if (clearance.at(nx, ny) > RADIUS) {
+      travel += hypot(nx - x, ny - y);
+      x = nx;
+      y = ny;
+    } else {
+      // The footprint check of the robot turns it away to the right
+      turn = -STOP_ROT*M_PI/180.;
+      stuck++;
+    }
+    yaw = atan2(sin(yaw + turn*CYCLE), cos(yaw + turn*CYCLE));
+    if ((c + 1) % (int)(60./CYCLE) == 0) printf(" %6.1f", map.knownArea());
+  }
+  printf(" m^2; %.1f m^2/min, %.0f%% mapped, %.0f m driven, %d blocked steps",
+      map.knownArea()/minutes, 100.*map.knownArea()/truth, travel, stuck);
+  if (explore) {
+    printf(", %.1f ms/cycle (max %.1f)", ex.usec/ex.cycles/1e3, ex.usecMax/1e3);
+    if (done >= 0) printf(", no reachable frontier after %.1f min", done*CYCLE/60.);
+  }
+  printf("\n");
+}
+
+int main ( int argc, char **argv )
+{
+  const double minutes = argc > 1 ? atof(argv[1]) : 5.;
+  for (unsigned int w=0; w<sizeof(WORLDS)/sizeof(WORLDS[0]); w++) {
+    GridMap world;
+    if (!world.readImage(WORLDS[w].file, WORLDS[w].res, WORLDS[w].originX, WORLDS[w].originY)) {
+      printf("%s: cannot read, skipped\n", WORLDS[w].file);
+      continue;
+    }
+    const double truth = world.knownArea();
+    printf("%s: %.0f m^2 known in the map image; area mapped after each minute\n",
+        WORLDS[w].file, truth);
+    run(WORLDS[w], false, minutes, truth);
+    run(WORLDS[w], true, minutes, truth);
+  }
+  return 0;
+}
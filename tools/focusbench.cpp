@@ -0,0 +1,123 @@
+/// @file focusbench.cpp
+/// @author Sebastian Rockel
+///
+/// Runs the camera autofocus (see cc_autofocus.h) against a synthetic blur
+/// frame source: the Y channel of a base frame is box blurred with a radius
+/// growing with the distance of the set focus to the true focus. The base
+/// frame is the first one of a frame archive if given, a generated pattern
+/// otherwise. Reports the frames needed to converge, the focus error and the
+/// time of the sharpness measure.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+#include "cc_framearchive.h"
+#include "cc_autofocus.h"
+
+const int width=1280; ///< Camera width resolution definition
+const int height=960; ///< Camera height resolution definition
+
+/// Frame source blurring a base frame depending on the focus
+class BlurSource : public FrameSource
+{
+  public:
+    BlurSource(const unsigned char *base, int width, int height, int trueFocus)
+      : frame(base, base + width*height*2), tmp(width*height), focus(FOCUS_MIN),
+        trueFocus(trueFocus)
+    {
+      this->width = width;
+      this->height = height;
+      imagelen = width*height*2;
+    }
+
+    int setFocus(int value) { focus = value; return 1; }
+    void cleanup() {}
+
+    int captureImage()
+    {
+      int radius = abs(focus - trueFocus) / 12;
+      blurred = frame;
+      if (radius > 0) blurY(radius);
+      captureBuf = &blurred[0];
+      captureTime = now();
+      return 1;
+    }
+
+  private:
+    std::vector<unsigned char> frame, blurred;
+    std::vector<int> tmp;
+    int focus, trueFocus;
+
+    // Separable box blur of the Y bytes
+    void blurY(int r)
+    {
+      const int n = 2*r + 1;
+      for (int y = 0; y < height; y++) {
+        unsigned char *row = &blurred[y*width*2];
+        int sum = 0;
+        for (int x = -r; x <= r; x++) sum += row[clamp(x, width)*2 + 1];
+        for (int x = 0; x < width; x++) {
+          tmp[y*width + x] = sum;
+          sum += row[clamp(x + r + 1, width)*2 + 1] - row[clamp(x - r, width)*2 + 1];
+        }
+      }
+      for (int x = 0; x < width; x++) {
+        int sum = 0;
+        for (int y = -r; y <= r; y++) sum += tmp[clamp(y, height)*width + x];
+        for (int y = 0; y < height; y++) {
+          blurred[(y*width + x)*2 + 1] = sum / (n*n);
+          sum += tmp[clamp(y + r + 1, height)*width + x] - tmp[clamp(y - r, height)*width + x];
+        }
+      }
+    }
+
+    static int clamp(int v, int n) { return v < 0 ? 0 : (v >= n ? n - 1 : v); }
+};
+
+int main (int argc, char **argv)
+{
+  std::vector<unsigned char> base(width*height*2);
+  SharpnessMeter meter;
+  timeval t0, t1;
+  double measureMs = 0.;
+  unsigned int measures = 0;
+
+  if (argc > 1) {
+    FrameArchive archive;
+    if (!archive.open(argv[1]) || !archive.captureImage()) return -1;
+    if (archive.getWidth() != width || archive.getHeight() != height) {
+      fprintf(stderr, "Archive frames have to be %dx%d\n", width, height);
+      return -1;
+    }
+    memcpy(&base[0], archive.captureBuf, base.size());
+  } else {
+    srand(1);
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++) {
+        base[(y*width + x)*2]     = 128;
+        base[(y*width + x)*2 + 1] = ((x/16 + y/16) % 2) ? 200 : 60 + rand() % 20;
+        base[(y*width + x)*2 + 2] = 128;
+      }
+  }
+  meter.InitAnnulus(width, height, 705, 490, 95, 460);
+
+  for (int trueFocus = 40; trueFocus < FOCUS_MAX; trueFocus += 60) {
+    BlurSource src(&base[0], width, height, trueFocus);
+    AutoFocus af;
+    src.setFocus(af.Init(FOCUS_MIN, FOCUS_MAX));
+    while (af.Mode() == AF_global && af.Frames() < 100) {
+      src.captureImage();
+      gettimeofday(&t0, 0);
+      af.Update(src, meter);
+      gettimeofday(&t1, 0);
+      measureMs += (t1.tv_sec - t0.tv_sec)*1e3 + (t1.tv_usec - t0.tv_usec)/1e3;
+      measures++;
+    }
+    printf("true focus %3d: focused at %3d (error %3d) after %2u frames\n",
+        trueFocus, af.Focus(), af.Focus() - trueFocus, af.Frames());
+  }
+  printf("sharpness measure over %d pixels: %.3f ms/frame\n",
+      meter.Pixels(), measureMs / measures);
+  return 0;
+}
@@ -0,0 +1,47 @@
+/// @file framerecord.cpp
+/// @author Sebastian Rockel
+///
+/// Records frames of the 1394 omni camera into a raw frame archive (see
+/// cc_framearchive.h) for offline replay with ballreplay.
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "cc_framearchive.h"
+#include "cc_camera1394.h"
+
+const int width=1280; ///< Camera width resolution definition
+const int height=960; ///< Camera height resolution definition
+
+int main (int argc, char **argv)
+{
+  Single1394 c1394;
+  FrameRecorder recorder;
+  int count;
+  int interval = 0; // Pause between frames in ms
+
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <archive> <frames> [interval ms]\n", argv[0]);
+    return -1;
+  }
+  count = atoi(argv[2]);
+  if (argc > 3) interval = atoi(argv[3]);
+
+  if (!c1394.initCam(width, height)) {
+    printf("Initializing Camera failed.\n");
+    return -1;
+  }
+  c1394.initFocus();
+  if (!recorder.open(argv[1], width, height)) {
+    c1394.cleanup();
+    return -1;
+  }
+  for (int i = 0; i < count; i++) {
+    c1394.captureImage();
+    if (!recorder.write(c1394)) break;
+    if (interval > 0) usleep(interval * 1000);
+  }
+  recorder.close();
+  printf("Recorded %u frames into %s\n", recorder.count(), argv[1]);
+  c1394.cleanup();
+  return 0;
+}
@@ -0,0 +1,161 @@
+/// @file linebench.cpp
+/// @author Sebastian Rockel
+///
+/// Benchmarks the scan line extraction (see scanlines.h) used by the wall
+/// follower. Scans are read from Player writelog files if given, otherwise
+/// corridor scans with a slanted left wall, clutter and range noise are
+/// generated for the URG (682 beams) and the UTM-30LX (1080 beams); for those
+/// the estimated left wall is compared to the true one.
+/// Reports the extraction time per scan (including the conversion to points)
+/// and the lines found.
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+#include <map>
+#include "playerlog.h"
+#include "scanlines.h"
+
+const double LASERMOUNT = 0.13; ///< Laser offset in front of robot center in meters
+const double WALLMINLEN = 0.3;  ///< Min wall segment length in meters
+const double WALLMAXDIST = 2.0; ///< Max wall segment distance in meters
+
+/// Statistics per beam count
+struct Stats {
+  Stats() : scans(0), usec(0.), usecMax(0.), lines(0), walls(0),
+            angleErr(0.), distErr(0.) {}
+  int scans;
+  double usec, usecMax;
+  long lines;
+  int walls;
+  double angleErr, distErr; ///< Sum of absolute errors
+};
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+/// Run the extraction on a scan
+static void run ( ScanLines & lines, const ts_LogScan & scan, Stats & st,
+                  double * wallAngle, double * wallDist, bool * wall )
+{
+  static ScanFrame frame;
+  timeval t0;
+  gettimeofday(&t0, 0);
+  frame.set(&scan.ranges[0], scan.ranges.size(), scan.angleMin,
+      scan.angleRes, LASERMOUNT);
+  lines.detect(frame, 0.02, scan.rangeMax);
+  *wall = lines.leftWall(WALLMINLEN, WALLMAXDIST, wallAngle, wallDist);
+  const double us = usecSince(t0);
+  st.scans++;
+  st.usec += us;
+  if (us > st.usecMax) st.usecMax = us;
+  st.lines += lines.size();
+  if (*wall) st.walls++;
+}
+
+/// Range of the ray from (ox,oy) in direction a to segment (x0,y0)-(x1,y1)
+static double ray ( double ox, double oy, double a,
+                    double x0, double y0, double x1, double y1 )
+{
+  const double dx = cos(a), dy = sin(a);
+  const double ex = x1 - x0, ey = y1 - y0;
+  const double den = dx*ey - dy*ex;
+  if (fabs(den) < 1e-12) return 1e9;
+  const double t = ((x0 - ox)*ey - (y0 - oy)*ex)/den; // Along the ray
+  const double s = ((x0 - ox)*dy - (y0 - oy)*dx)/den; // Along the segment
+  return (t > 0. && s >= 0. && s <= 1.) ? t : 1e9;
+}
+
+static double gauss ( void )
+{
+  double u = (rand() + 1.)/(RAND_MAX + 2.), v = (rand() + 1.)/(RAND_MAX + 2.);
+  return sqrt(-2.*log(u))*cos(2.*M_PI*v);
+}
+
+/// Corridor scan, robot at the origin heading along x
+static void corridor ( ts_LogScan & scan, int beams, double fov, double rangeMax,
+                       double wallAngle, double wallDist )
+{
+  // Left wall through (0,wallDist), right wall, front wall, a box
+  const double c = cos(wallAngle), s = sin(wallAngle);
+  const double seg[][4] = {
+    { -5.*c, wallDist - 5.*s, 5.*c, wallDist + 5.*s },
+    { -5., -1.2, 5., -1.2 },
+    { 4., -1.2, 4., 5. },
+    { 1.5, -0.6, 1.8, -0.6 }, { 1.8, -0.6, 1.8, -0.9 },
+    { 1.8, -0.9, 1.5, -0.9 }, { 1.5, -0.9, 1.5, -0.6 } };
+  scan.angleRes = fov/beams;
+  scan.angleMin = -fov/2.;
+  scan.rangeMax = rangeMax;
+  scan.ranges.resize(beams);
+  for (int i=0; i<beams; i++) {
+    const double a = scan.angleMin + i*scan.angleRes;
+    double r = rangeMax;
+    for (unsigned int k=0; k<sizeof(seg)/sizeof(seg[0]); k++)
+      r = std::min(r, ray(LASERMOUNT, 0., a, seg[k][0], seg[k][1], seg[k][2], seg[k][3]));
+    if (r < rangeMax) r += 0.01*gauss();
+    scan.ranges[i] = r;
+  }
+}
+
+static void report ( int beams, const Stats & st, bool truth )
+{
+  printf("%4d beams: %5d scans, %7.1f us/scan (max %7.1f), %5.1f lines/scan, left wall in %5.1f%%",
+      beams, st.scans, st.usec/st.scans, st.usecMax, (double)st.lines/st.scans,
+      100.*st.walls/st.scans);
+  if (truth && st.walls > 0)
+    printf(", error %.2f deg / %.3f m", st.angleErr/st.walls*180./M_PI,
+        st.distErr/st.walls);
+  printf("\n");
+}
+
+int main (int argc, char **argv)
+{
+  ScanLines lines;
+  double angle, dist;
+  bool wall;
+
+  if (argc > 1) {
+    std::map<int, Stats> stats;
+    for (int f=1; f<argc; f++) {
+      PlayerLog log;
+      if (!log.open(argv[f])) {
+        fprintf(stderr, "Cannot open %s\n", argv[f]);
+        return -1;
+      }
+      PlayerLog::RecordType r;
+      while ((r = log.next()) != PlayerLog::END)
+        if (r == PlayerLog::SCAN)
+          run(lines, log.scan, stats[log.scan.ranges.size()], &angle, &dist, &wall);
+    }
+    for (std::map<int, Stats>::iterator i=stats.begin(); i!=stats.end(); ++i)
+      report(i->first, i->second, false);
+    return 0;
+  }
+
+  // URG (stage_local/urgr.inc) and UTM-30LX (stage_local/utm30lx.inc)
+  const int beams[] = { 682, 1080 };
+  const double fov[] = { 682*360./1024., 270. };
+  const double rangeMax[] = { 5.6, 30. };
+  srand(1);
+  for (int l=0; l<2; l++) {
+    Stats st;
+    ts_LogScan scan;
+    for (int n=0; n<2000; n++) {
+      const double trueAngle = (rand()/(double)RAND_MAX - 0.5)*M_PI/3.;
+      const double trueDist  = 0.4 + rand()/(double)RAND_MAX*0.8;
+      corridor(scan, beams[l], fov[l]*M_PI/180., rangeMax[l], trueAngle, trueDist);
+      run(lines, scan, st, &angle, &dist, &wall);
+      if (wall) {
+        st.angleErr += fabs(angle - trueAngle);
+        st.distErr  += fabs(dist - trueDist*cos(trueAngle));
+      }
+    }
+    report(beams[l], st, true);
+  }
+  return 0;
+}
@@ -0,0 +1,149 @@
+/// @file mapbuild.cpp
+/// @author Sebastian Rockel
+///
+/// Builds an occupancy grid map (see gridmap.h) from Player writelog files,
+/// the online counterpart of "make slam" (pmaptest), with the same grid
+/// (16x16 m at 0.08 m) and start pose (-7, -7, 90 deg). Scans are placed at
+/// the latest odometry pose, no scan matching is done.
+/// Without log files UTM-30LX scans (1080 beams, 30 m) of a generated room
+/// are mapped instead. Reports the time per scan and writes the map as PNG
+/// for the mapfile driver.
+#include <stdio.h>
+#include <sys/time.h>
+#include "playerlog.h"
+#include "gridmap.h"
+
+const double LASERMOUNT = 0.13; ///< Laser offset in front of robot center in meters
+const double MAPSIZE  = 16.;    ///< Map side length in meters
+const double MAPRES   = 0.08;   ///< Map cell size in meters
+const double STARTX   = -7.;    ///< Start pose in the map in meters
+const double STARTY   = -7.;
+const double STARTYAW = 90.;    ///< Start orientation in deg
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+/// Range of the ray from (ox,oy) in direction a to segment (x0,y0)-(x1,y1)
+static double ray ( double ox, double oy, double a,
+                    double x0, double y0, double x1, double y1 )
+{
+  const double dx = cos(a), dy = sin(a);
+  const double ex = x1 - x0, ey = y1 - y0;
+  const double den = dx*ey - dy*ex;
+  if (fabs(den) < 1e-12) return 1e9;
+  const double t = ((x0 - ox)*ey - (y0 - oy)*ex)/den;
+  const double s = ((x0 - ox)*dy - (y0 - oy)*dx)/den;
+  return (t > 0. && s >= 0. && s <= 1.) ? t : 1e9;
+}
+
+/// Room of 14x14 m with an inner wall and a pillar, scanned from (x, y, th)
+static void room ( ts_LogScan & scan, double x, double y, double th )
+{
+  const double seg[][4] = {
+    { -7.5, -7.5, 6.5, -7.5 }, { 6.5, -7.5, 6.5, 6.5 },
+    { 6.5, 6.5, -7.5, 6.5 }, { -7.5, 6.5, -7.5, -7.5 },
+    { -3., -7.5, -3., 2. }, { 2., 0., 3., 0. }, { 3., 0., 3., 1. },
+    { 3., 1., 2., 1. }, { 2., 1., 2., 0. } };
+  scan.angleRes = 270./1080.*M_PI/180.;
+  scan.angleMin = -135.*M_PI/180.;
+  scan.rangeMax = 30.;
+  scan.ranges.resize(1080);
+  const double lx = x + LASERMOUNT*cos(th), ly = y + LASERMOUNT*sin(th);
+  for (int i=0; i<1080; i++) {
+    double r = scan.rangeMax;
+    for (unsigned int k=0; k<sizeof(seg)/sizeof(seg[0]); k++)
+      r = std::min(r, ray(lx, ly, th + scan.angleMin + i*scan.angleRes,
+            seg[k][0], seg[k][1], seg[k][2], seg[k][3]));
+    scan.ranges[i] = r;
+  }
+}
+
+int main ( int argc, char **argv )
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <map.png> [logfile ...]\n", argv[0]);
+    return -1;
+  }
+  GridMap map(MAPSIZE, MAPSIZE, MAPRES, -MAPSIZE/2, -MAPSIZE/2);
+  ScanFrame frame;
+  int scans = 0;
+  long beams = 0;
+  double usec = 0., usecMax = 0.;
+
+  if (argc > 2) {
+    const double c = cos(STARTYAW*M_PI/180.), s = sin(STARTYAW*M_PI/180.);
+    for (int f=2; f<argc; f++) {
+      PlayerLog log;
+      if (!log.open(argv[f])) {
+        fprintf(stderr, "Cannot open %s\n", argv[f]);
+        return -1;
+      }
+      double x = STARTX, y = STARTY, yaw = STARTYAW*M_PI/180.;
+      PlayerLog::RecordType r;
+      while ((r = log.next()) != PlayerLog::END) {
+        if (r == PlayerLog::POSE) {
+          // Odometry relative to the start pose
+          x = STARTX + c*log.pose.x - s*log.pose.y;
+          y = STARTY + s*log.pose.x + c*log.pose.y;
+          yaw = STARTYAW*M_PI/180. + log.pose.yaw;
+          continue;
+        }
+        timeval t0;
+        gettimeofday(&t0, 0);
+        frame.set(&log.scan.ranges[0], log.scan.ranges.size(), log.scan.angleMin,
+            log.scan.angleRes, LASERMOUNT);
+        map.addScan(frame, 0.02, log.scan.rangeMax, x, y, yaw);
+        const double us = usecSince(t0);
+        usec += us;
+        usecMax = std::max(usecMax, us);
+        beams += log.scan.ranges.size();
+        scans++;
+      }
+    }
+  } else {
+    // Round trip through the room
+    ts_LogScan scan;
+    for (int n=0; n<400; n++) {
+      const double a = 2.*M_PI*n/400.;
+      const double x = 1.5 + 4.*cos(a), y = -2. + 4.*sin(a), th = a + M_PI/2.;
+      room(scan, x, y, th);
+      timeval t0;
+      gettimeofday(&t0, 0);
+      frame.set(&scan.ranges[0], scan.ranges.size(), scan.angleMin,
+          scan.angleRes, LASERMOUNT);
+      map.addScan(frame, 0.02, scan.rangeMax, x, y, th);
+      const double us = usecSince(t0);
+      usec += us;
+      usecMax = std::max(usecMax, us);
+      beams += scan.ranges.size();
+      scans++;
+    }
+  }
+  if (scans == 0) {
+    fprintf(stderr, "No scans\n");
+    return -1;
+  }
+  int occupied = 0, vacant = 0;
+  for (int cy=0; cy<map.height(); cy++)
+    for (int cx=0; cx<map.width(); cx++) {
+      const int st = map.state(cx, cy);
+      if (st > 0) occupied++;
+      else if (st < 0) vacant++;
+    }
+  printf("%d scans (%.0f beams/scan) in %.0f us/scan (max %.0f), %.0f scans/s on one core\n",
+      scans, (double)beams/scans, usec/scans, usecMax, 1e6*scans/usec);
+  printf("%dx%d cells: %d occupied, %d free; %d tiles, %.0f KB (dense %.0f KB)\n",
+      map.width(), map.height(), occupied, vacant, map.storage().tiles(),
+      map.bytes()/1024., map.width()*map.height()*sizeof(short)/1024.);
+  if (!map.writePng(argv[1])) {
+    fprintf(stderr, "Cannot write %s\n", argv[1]);
+    return -1;
+  }
+  printf("mapfile: filename \"%s\" resolution %.3f origin [%.1f %.1f]\n", argv[1],
+      map.resolution(), map.originx(), map.originy());
+  return 0;
+}
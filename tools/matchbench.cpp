@@ -0,0 +1,153 @@
+/// @file matchbench.cpp
+/// @author Sebastian Rockel
+///
+/// Benchmarks the correlative scan matcher (see scanmatcher.h). A map is
+/// built (gridmap.h) from the scans of Player writelog files at their
+/// odometry poses, or from UTM-30LX scans (1080 beams) of a generated room
+/// at the true poses. Then every scan is matched starting from its pose
+/// disturbed by up to 0.2 m and 5 deg, searching +-0.3 m and +-8 deg, and
+/// the recovered pose is compared to the undisturbed one. Reports matches
+/// per second for 1, 2 and 4 threads and the errors.
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "playerlog.h"
+#include "scanmatcher.h"
+
+const double LASERMOUNT = 0.13; ///< Laser offset in front of robot center in meters
+const double MAPSIZE  = 16.;    ///< Map side length in meters
+const double MAPRES   = 0.05;   ///< Map cell size in meters
+const double STARTX   = -7.;    ///< Start pose of logs in the map in meters
+const double STARTY   = -7.;
+const double STARTYAW = 90.;    ///< Start orientation of logs in deg
+const double NOISE_XY  = 0.2;   ///< Max initial pose error in meters
+const double NOISE_YAW = 5.;    ///< Max initial orientation error in deg
+const double WINDOW    = 0.3;   ///< Translation search window in meters
+const double ANGLE     = 8.;    ///< Rotation search window in deg
+
+/// Scan with its pose
+struct Sample {
+  ScanFrame scan;
+  double rangeMax;
+  double x, y, yaw;
+};
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+/// Range of the ray from (ox,oy) in direction a to segment (x0,y0)-(x1,y1)
+static double ray ( double ox, double oy, double a,
+                    double x0, double y0, double x1, double y1 )
+{
+  const double dx = cos(a), dy = sin(a);
+  const double ex = x1 - x0, ey = y1 - y0;
+  const double den = dx*ey - dy*ex;
+  if (fabs(den) < 1e-12) return 1e9;
+  const double t = ((x0 - ox)*ey - (y0 - oy)*ex)/den;
+  const double s = ((x0 - ox)*dy - (y0 - oy)*dx)/den;
+  return (t > 0. && s >= 0. && s <= 1.) ? t : 1e9;
+}
+
+/// Room of 14x14 m with an inner wall and a pillar, scanned from (x, y, th)
+static void room ( Sample & smp, double x, double y, double th )
+{
+  const double seg[][4] = {
+    { -7.5, -7.5, 6.5, -7.5 }, { 6.5, -7.5, 6.5, 6.5 },
+    { 6.5, 6.5, -7.5, 6.5 }, { -7.5, 6.5, -7.5, -7.5 },
+    { -3., -7.5, -3., 2. }, { 2., 0., 3., 0. }, { 3., 0., 3., 1. },
+    { 3., 1., 2., 1. }, { 2., 1., 2., 0. } };
+  const double res = 270./1080.*M_PI/180.;
+  smp.scan.setGeometry(1080, -135.*M_PI/180., res, LASERMOUNT);
+  smp.rangeMax = 30.;
+  const double lx = x + LASERMOUNT*cos(th), ly = y + LASERMOUNT*sin(th);
+  for (int i=0; i<1080; i++) {
+    double r = smp.rangeMax;
+    for (unsigned int k=0; k<sizeof(seg)/sizeof(seg[0]); k++)
+      r = std::min(r, ray(lx, ly, th + smp.scan.angle(i), seg[k][0], seg[k][1], seg[k][2], seg[k][3]));
+    smp.scan.ranges()[i] = r;
+  }
+  smp.scan.convert();
+  smp.x = x; smp.y = y; smp.yaw = th;
+}
+
+static double uniform ( double a ) { return (2.*rand()/RAND_MAX - 1.)*a; }
+
+int main ( int argc, char **argv )
+{
+  std::vector<Sample> samples;
+  if (argc > 1) {
+    const double c = cos(STARTYAW*M_PI/180.), s = sin(STARTYAW*M_PI/180.);
+    for (int f=1; f<argc; f++) {
+      PlayerLog log;
+      if (!log.open(argv[f])) {
+        fprintf(stderr, "Cannot open %s\n", argv[f]);
+        return -1;
+      }
+      double x = STARTX, y = STARTY, yaw = STARTYAW*M_PI/180.;
+      PlayerLog::RecordType r;
+      while ((r = log.next()) != PlayerLog::END) {
+        if (r == PlayerLog::POSE) {
+          x = STARTX + c*log.pose.x - s*log.pose.y;
+          y = STARTY + s*log.pose.x + c*log.pose.y;
+          yaw = STARTYAW*M_PI/180. + log.pose.yaw;
+          continue;
+        }
+        samples.push_back(Sample());
+        Sample & smp = samples.back();
+        smp.scan.set(&log.scan.ranges[0], log.scan.ranges.size(), log.scan.angleMin,
+            log.scan.angleRes, LASERMOUNT);
+        smp.rangeMax = log.scan.rangeMax;
+        smp.x = x; smp.y = y; smp.yaw = yaw;
+      }
+    }
+  } else {
+    // Round trip through the room
+    samples.resize(200);
+    for (int n=0; n<200; n++) {
+      const double a = 2.*M_PI*n/200.;
+      room(samples[n], 1.5 + 4.*cos(a), -2. + 4.*sin(a), a + M_PI/2.);
+    }
+  }
+  if (samples.empty()) {
+    fprintf(stderr, "No scans\n");
+    return -1;
+  }
+
+  GridMap map(MAPSIZE, MAPSIZE, MAPRES, -MAPSIZE/2, -MAPSIZE/2);
+  for (unsigned int i=0; i<samples.size(); i++)
+    map.addScan(samples[i].scan, 0.02, samples[i].rangeMax, samples[i].x,
+        samples[i].y, samples[i].yaw);
+  const int threads[] = { 1, 2, 4 };
+  for (int t=0; t<3; t++) {
+    ScanMatcher matcher(5, 0.1, threads[t]);
+    timeval t0;
+    gettimeofday(&t0, 0);
+    matcher.setMap(map);
+    const double usMap = usecSince(t0);
+    srand(1);
+    double usec = 0., errXY = 0., errYaw = 0., maxXY = 0., maxYaw = 0., score = 0.;
+    for (unsigned int i=0; i<samples.size(); i++) {
+      const Sample & smp = samples[i];
+      double x, y, yaw;
+      gettimeofday(&t0, 0);
+      score += matcher.match(smp.scan, 0.02, smp.rangeMax, smp.x + uniform(NOISE_XY),
+          smp.y + uniform(NOISE_XY), smp.yaw + uniform(NOISE_YAW*M_PI/180.),
+          WINDOW, ANGLE*M_PI/180., &x, &y, &yaw);
+      usec += usecSince(t0);
+      const double exy = hypot(x - smp.x, y - smp.y);
+      const double eyaw = fabs(remainder(yaw - smp.yaw, 2.*M_PI))*180./M_PI;
+      errXY += exy; errYaw += eyaw;
+      maxXY = std::max(maxXY, exy);
+      maxYaw = std::max(maxYaw, eyaw);
+    }
+    const int n = samples.size();
+    printf("%d thread(s): map %.0f us, %d matches at %.0f/s, score %.2f,"
+        " error %.3f m / %.2f deg (max %.3f m / %.2f deg)\n", threads[t], usMap, n,
+        1e6*n/usec, score/n, errXY/n, errYaw/n, maxXY, maxYaw);
+  }
+  return 0;
+}
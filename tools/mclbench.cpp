@@ -0,0 +1,168 @@
+/// @file mclbench.cpp
+/// @author Sebastian Rockel
+///
+/// Benchmarks the particle filter localizer (see particlefilter.h) on the
+/// map of the navigation example (pnav_ex/bitmaps/cave.png, 0.032 m, origin
+/// -8, -8). A robot wanders through the free space from the stage start pose
+/// (-7, -7, 45 deg) with drifting odometry; SICK LMS200 scans (361 beams,
+/// 8 m) are cast in the map. Per particle count the filter tracks the robot
+/// from its start pose, then KLD sampling localizes it globally. Reports the
+/// time per update (motion, measurement, resampling) and the pose error.
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "particlefilter.h"
+
+const double LASERMOUNT = 0.13;  ///< Laser offset in front of robot center in meters
+const double RANGEMAX = 8.;      ///< Laser range in meters
+const int    BEAMS    = 361;     ///< Laser beams over 180 deg
+const double MAPRES   = 0.032;   ///< Map cell size in meters
+const double ORIGIN   = -8.;     ///< Map lower left corner in meters
+const double STEP     = 0.1;     ///< Distance between updates in meters
+const int    UPDATES  = 300;     ///< Updates per run
+const double ODOMDRIFT = 0.05;   ///< Odometry error per meter and per radian
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+static double uniform ( double a ) { return (2.*rand()/RAND_MAX - 1.)*a; }
+
+/// Range to the first occupied cell, half cell steps; nothing is seen off
+/// the map, cave.png has no border
+static double cast ( const GridMap & map, double x, double y, double a )
+{
+  const double c = cos(a), s = sin(a), step = map.resolution()/2;
+  for (double d=0.; d<RANGEMAX; d+=step) {
+    const int cx = map.cellX(x + d*c), cy = map.cellY(y + d*s);
+    if (!map.inside(cx, cy)) break;
+    if (map.state(cx, cy) > 0) return d;
+  }
+  return RANGEMAX;
+}
+
+/// True if a step ahead stays on the map
+static bool inside ( const GridMap & map, double x, double y, double a )
+{
+  return map.inside(map.cellX(x + 0.6*cos(a)), map.cellY(y + 0.6*sin(a)));
+}
+
+/// Pose along the path with the odometry of it
+struct Step {
+  double x, y, yaw;       ///< True pose
+  double ox, oy, oyaw;    ///< Odometry
+  ScanFrame scan;
+};
+
+/// Wander through the free space, turning away from obstacles ahead
+static void wander ( const GridMap & map, std::vector<Step> & path )
+{
+  double x = -7., y = -7., yaw = 45.*M_PI/180.;
+  double ox = 0., oy = 0., oyaw = 0.;
+  path.resize(UPDATES);
+  for (int k=0; k<UPDATES; k++) {
+    Step & p = path[k];
+    p.x = x; p.y = y; p.yaw = yaw;
+    p.ox = ox; p.oy = oy; p.oyaw = oyaw;
+    p.scan.setGeometry(BEAMS, -M_PI/2, M_PI/(BEAMS - 1), LASERMOUNT);
+    const double lx = x + LASERMOUNT*cos(yaw), ly = y + LASERMOUNT*sin(yaw);
+    for (int i=0; i<BEAMS; i++) {
+      const double r = cast(map, lx, ly, yaw + p.scan.angle(i));
+      p.scan.ranges()[i] = r < RANGEMAX ? std::max(0.01, r + 0.01*uniform(1.)) : r;
+    }
+    p.scan.convert();
+    // Next pose: keep going if there is room, else turn
+    double turn = uniform(0.2);
+    while (cast(map, x, y, yaw + turn) < 0.6 || !inside(map, x, y, yaw + turn))
+      turn += uniform(1.);
+    const double a = yaw + turn;
+    x += STEP*cos(a);
+    y += STEP*sin(a);
+    yaw = atan2(sin(a), cos(a));
+    // Odometry of the motion with a drift
+    const double d = STEP*(1. + ODOMDRIFT*uniform(1.));
+    const double oa = oyaw + turn*(1. + ODOMDRIFT*uniform(1.));
+    ox += d*cos(oa);
+    oy += d*sin(oa);
+    oyaw = atan2(sin(oa), cos(oa));
+  }
+}
+
+/// Run the filter along the path
+/// @return Mean position error after the first quarter of the path
+static double run ( ParticleFilter & pf, const std::vector<Step> & path,
+                    double * usec, double * usecMax, double * yawErr, int * count )
+{
+  double err = 0., errYaw = 0.;
+  int n = 0, particles = 0;
+  *usec = *usecMax = 0.;
+  for (unsigned int k=1; k<path.size(); k++) {
+    const Step & a = path[k-1], & b = path[k];
+    timeval t0;
+    gettimeofday(&t0, 0);
+    pf.predict(a.ox, a.oy, a.oyaw, b.ox, b.oy, b.oyaw);
+    pf.correct(b.scan, 0.02, RANGEMAX);
+    pf.resample();
+    const double us = usecSince(t0);
+    *usec += us;
+    *usecMax = std::max(*usecMax, us);
+    particles += pf.size();
+    if (k < path.size()/4) continue;
+    double x = 0., y = 0., yaw = 0.;
+    pf.estimate(&x, &y, &yaw);
+    err += hypot(x - b.x, y - b.y);
+    errYaw += fabs(atan2(sin(yaw - b.yaw), cos(yaw - b.yaw)));
+    n++;
+  }
+  *usec /= path.size() - 1;
+  *count = particles/(path.size() - 1);
+  *yawErr = errYaw/n*180./M_PI;
+  return err/n;
+}
+
+int main ( int argc, char **argv )
+{
+  const char * file = argc > 1 ? argv[1] : "pnav_ex/bitmaps/cave.png";
+  GridMap map;
+  if (!map.readImage(file, MAPRES, ORIGIN, ORIGIN)) {
+    fprintf(stderr, "Cannot read %s\n", file);
+    return -1;
+  }
+  srand(1);
+  std::vector<Step> path;
+  wander(map, path);
+
+  timeval t0;
+  gettimeofday(&t0, 0);
+  ParticleFilter field;
+  field.setMap(map);
+  printf("%dx%d map, likelihood field in %.0f ms; %d updates every %.1f m\n",
+      map.width(), map.height(), usecSince(t0)/1e3, UPDATES - 1, STEP);
+
+  // Tracking with a fixed particle count
+  const int counts[] = { 1000, 5000, 20000, 50000 };
+  for (unsigned int c=0; c<sizeof(counts)/sizeof(counts[0]); c++) {
+    ParticleFilter pf(counts[c], counts[c]);
+    pf.setMap(map);
+    pf.init(path[0].x, path[0].y, path[0].yaw, 0.1, 0.1);
+    double usec, usecMax, yawErr;
+    int n;
+    const double err = run(pf, path, &usec, &usecMax, &yawErr, &n);
+    printf("%6d particles: %6.2f ms/update (max %6.2f), %5.0f Hz, error %.3f m / %.2f deg\n",
+        n, usec/1e3, usecMax/1e3, 1e6/usec, err, yawErr);
+  }
+
+  // Global localization, KLD sampling shrinks the set once converged
+  ParticleFilter pf(500, 50000);
+  pf.setMap(map);
+  pf.initGlobal();
+  double usec, usecMax, yawErr;
+  int n;
+  const double err = run(pf, path, &usec, &usecMax, &yawErr, &n);
+  printf("global, KLD: %d particles average, %d at the end, %.2f ms/update (max %.2f), "
+      "error %.3f m / %.2f deg\n", n, pf.size(), usec/1e3, usecMax/1e3, err, yawErr);
+  return 0;
+}
@@ -0,0 +1,187 @@
+/// @file motionbench.cpp
+/// @author Sebastian Rockel
+///
+/// Benchmarks the motion checks of the wall follower on a generated corridor
+/// scan (URG geometry, robot close to the left wall, a box ahead): the swept
+/// footprint test (see footprint.h) over a window of (v, w) candidates, the
+/// closed form time to collision over the same window, the distance grid
+/// (distgrid.h), the dynamic window planner (dwaplanner.h) and the rolling
+/// obstacle memory (rollinggrid.h).
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <algorithm>
+#include "scanframe.h"
+#include "footprint.h"
+#include "distgrid.h"
+#include "dwaplanner.h"
+#include "rollinggrid.h"
+
+const double LASERMOUNT = 0.13; ///< Laser offset in front of robot center in meters
+const int    BEAMS = 682;       ///< URG beams
+const double DEGPROBEAM = 0.3515625; ///< URG resolution in degree
+const double RANGEMAX = 5.6;    ///< URG max range in meters
+const int    RUNS = 100;        ///< Repetitions per measurement
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+/// Range of the ray from (ox,oy) in direction a to segment (x0,y0)-(x1,y1)
+static double ray ( double ox, double oy, double a,
+                    double x0, double y0, double x1, double y1 )
+{
+  const double dx = cos(a), dy = sin(a);
+  const double ex = x1 - x0, ey = y1 - y0;
+  const double den = dx*ey - dy*ex;
+  if (fabs(den) < 1e-12) return 1e9;
+  const double t = ((x0 - ox)*ey - (y0 - oy)*ex)/den;
+  const double s = ((x0 - ox)*dy - (y0 - oy)*dx)/den;
+  return (t > 0. && s >= 0. && s <= 1.) ? t : 1e9;
+}
+
+/// Corridor 1.6 m wide, 0.7 m to the left wall and a box 1.2 m ahead of the
+/// robot at the origin
+static const double CORRIDOR[][4] = {
+  { -5., 0.7, 5., 0.7 }, { -5., -0.9, 5., -0.9 },
+  { 1.2, -0.3, 1.5, -0.3 }, { 1.5, -0.3, 1.5, -0.6 },
+  { 1.5, -0.6, 1.2, -0.6 }, { 1.2, -0.6, 1.2, -0.3 } };
+
+/// Range in the corridor from (x, y) in direction a
+static double cast ( double x, double y, double a, double rangeMax )
+{
+  double r = rangeMax;
+  for (unsigned int k=0; k<sizeof(CORRIDOR)/sizeof(CORRIDOR[0]); k++)
+    r = std::min(r, ray(x, y, a, CORRIDOR[k][0], CORRIDOR[k][1], CORRIDOR[k][2], CORRIDOR[k][3]));
+  return r;
+}
+
+/// Corridor scanned from the robot pose (x, y, th)
+static void corridor ( ScanFrame & scan, double x = 0., double y = 0., double th = 0. )
+{
+  const double res = DEGPROBEAM*M_PI/180.;
+  scan.setGeometry(BEAMS, -BEAMS*res/2., res, LASERMOUNT);
+  const double lx = x + LASERMOUNT*cos(th), ly = y + LASERMOUNT*sin(th);
+  for (int i=0; i<BEAMS; i++) scan.ranges()[i] = cast(lx, ly, th + scan.angle(i), RANGEMAX);
+  scan.convert();
+}
+
+int main ( void )
+{
+  ScanFrame scan;
+  Footprint fp;
+  timeval t0;
+  corridor(scan);
+  fp.addScan(scan, 0.02, RANGEMAX, 1.5);
+
+  // Velocity window: 11 speeds x 41 turnrates
+  const int NV = 11, NW = 41;
+  int freeArcs = 0;
+  gettimeofday(&t0, 0);
+  for (int run=0; run<RUNS; run++) {
+    freeArcs = 0;
+    for (int i=0; i<NV; i++)
+      for (int j=0; j<NW; j++)
+        freeArcs += fp.free(0.1*i, -1. + 2.*j/(NW - 1), 1.5);
+  }
+  printf("footprint sweep: %d points, %d candidates (1.5 s horizon) in %.0f us, %d free\n",
+      fp.points(), NV*NW, usecSince(t0)/RUNS, freeArcs);
+
+  // Same window in closed form, compared to the sweep at 1 cm
+  double tmin = 0., err = 0.;
+  gettimeofday(&t0, 0);
+  for (int run=0; run<RUNS; run++) {
+    tmin = 1e9;
+    for (int i=0; i<NV; i++)
+      for (int j=0; j<NW; j++)
+        tmin = std::min(tmin, fp.timeToCollision(0.1*i + 0.05, -1. + 2.*j/(NW - 1), 3.));
+  }
+  const double us = usecSince(t0)/RUNS;
+  for (int i=0; i<NV; i++)
+    for (int j=0; j<NW; j++) {
+      const double v = 0.1*i + 0.05, w = -1. + 2.*j/(NW - 1);
+      const double d = fabs(fp.timeToCollision(v, w, 3.) - fp.sweep(v, w, 3., 0.01));
+      err = std::max(err, d*(v + fabs(w)*fp.radius()));
+    }
+  double lx = 0., ly = 0.;
+  const double t = fp.timeToCollision(0.5, -0.3, 3., &lx, &ly);
+  printf("time to collision: %d candidates in %.0f us (%.1f us each), min %.2f s, max deviation"
+      " from sweep %.3f m; 0.5 m/s -0.3 rad/s: %.2f s, limited by (%.2f, %.2f)\n",
+      NV*NW, us, us/(NV*NW), tmin, err, t, lx, ly);
+
+  DistGrid grid(6., 0.05, 1.);
+  gettimeofday(&t0, 0);
+  for (int run=0; run<RUNS; run++) {
+    grid.clear();
+    grid.addScan(scan, 0.02, RANGEMAX);
+    grid.update();
+  }
+  printf("distance grid: %dx%d cells in %.0f us\n", grid.cells(), grid.cells(),
+      usecSince(t0)/RUNS);
+
+  ts_DwaConfig cfg;
+  cfg.vMax = 0.6; cfg.wMax = 1.; cfg.acc = 0.5; cfg.rotAcc = 1.5;
+  cfg.dt = 0.1; cfg.horizon = 1.5; cfg.steps = 15; cfg.nv = 21; cfg.nw = 25;
+  cfg.halfWidth = 0.19; cfg.wHeading = 2.; cfg.wClear = 0.2; cfg.wVel = 0.2;
+  cfg.checks = 8;
+  DwaPlanner dwa(cfg);
+  double v = 0.3, w = 0.;
+  gettimeofday(&t0, 0);
+  for (int run=0; run<RUNS; run++)
+    dwa.plan(0.3, 0., 3., 0.2, cfg.vMax, grid, fp, &v, &w);
+  printf("dwa: %d candidates (%d steps) in %.0f us, v %.2f w %.2f\n",
+      dwa.candidates(), cfg.steps, usecSince(t0)/RUNS, v, w);
+  // Drive the corridor past the box, goal 3 m ahead 0.5 m off the left wall
+  double x = 0., y = 0., th = 0.;
+  v = 0.; w = 0.;
+  for (int cycle=0; cycle<60; cycle++) {
+    ScanFrame view;
+    Footprint fpv;
+    corridor(view, x, y, th);
+    fpv.addScan(view, 0.02, RANGEMAX, 1.5);
+    grid.clear();
+    grid.addScan(view, 0.02, RANGEMAX);
+    grid.update();
+    const double c = cos(th), s = sin(th);
+    const double gx = 3., gy = 0.2 - y;
+    if (!dwa.plan(v, w, c*gx + s*gy, -s*gx + c*gy, cfg.vMax, grid, fpv, &v, &w)) {
+      v = 0.; w = 0.;
+    }
+    double dx, dy, dth;
+    Footprint::arc(v, w, cfg.dt, &dx, &dy, &dth);
+    x += c*dx - s*dy; y += s*dx + c*dy; th += dth;
+  }
+  printf("dwa drive: after 6 s at x %.2f y %.2f yaw %.1f deg, v %.2f\n",
+      x, y, th*180./M_PI, v);
+
+  // Obstacle memory driving past the box at 0.5 m/s, 40 Hz: scroll, laser
+  // beams, 16 sonar cones (ring around the center) and the cells within reach
+  RollingGrid memory(8., 0.05);
+  std::vector<float> ox, oy;
+  double usMax = 0., usSum = 0.;
+  const int cycles = 200;
+  for (int cycle=0; cycle<cycles; cycle++) {
+    const double mx = cycle*0.5/40.;
+    ScanFrame view;
+    corridor(view, mx);
+    double sonar[16];
+    for (int i=0; i<16; i++) sonar[i] = cast(mx, 0., i*M_PI/8., 5.);
+    gettimeofday(&t0, 0);
+    memory.setPose(mx, 0., 0.);
+    memory.addScan(view, 0.02, RANGEMAX);
+    for (int i=0; i<16; i++)
+      memory.addSonar(0., 0., i*M_PI/8., sonar[i], 15.*M_PI/180., 5.);
+    memory.occupiedCells(1.8, ox, oy);
+    const double us = usecSince(t0);
+    usSum += us;
+    usMax = std::max(usMax, us);
+  }
+  const double bx = 1.35 - cycles*0.5/40., by = -0.3;
+  printf("obstacle memory: %dx%d cells, %.0f us per cycle (max %.0f), %d cells within reach,"
+      " box behind at (%.2f, %.2f) %s\n", memory.cells(), memory.cells(), usSum/cycles,
+      usMax, (int)ox.size(), bx, by, memory.occupied(bx, by) ? "remembered" : "lost");
+  return 0;
+}
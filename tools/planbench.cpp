@@ -0,0 +1,171 @@
+/// @file planbench.cpp
+/// @author Sebastian Rockel
+///
+/// Benchmarks the D* Lite planner (see dstarlite.h) against planning from
+/// scratch. Per map a start and a far goal are picked in the free space and
+/// the robot drives along the path at 0.5 m/s with a replan every 0.1 s (the
+/// Player cycle). Now and then an obstacle of 0.4 m x 0.4 m, as a person or a
+/// closed door, shows up 1 to 3 m ahead on the path; its inflated costs are
+/// set in the planner. Every replan is checked against a search from scratch
+/// on the same costs. Reports expanded cells and time per replan for both.
+/// Usage: planbench [map image resolution origin x origin y]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "dstarlite.h"
+
+/// Map image with its resolution and lower left corner
+struct MapFile {
+  const char * file;
+  double res, originX, originY;
+};
+
+const MapFile MAPS[] = {
+  { "stage_local/bitmaps/tams_corr_orig_cut_q_05.png", 0.05, -8., -8. },  // uhh.world
+  { "pnav_ex/bitmaps/cave.png", 0.032, -8., -8. },                       // pnav_navloc.cfg
+  { "stage_local/bitmaps/tams_corr_orig.png", 0.015625, 0., 0. } };      // whole TAMS floor
+const double SAFETY    = 0.3;  ///< C-space safety distance in meters
+const double INFLATION = 0.5;  ///< Cost decay distance in meters
+const double STEP      = 0.05; ///< Robot travel per cycle in meters
+const int    CYCLES    = 200;  ///< Replans per map at most
+const double OBSTACLE  = 0.2;  ///< Obstacle half side in meters
+const int    OBSTACLE_EVERY = 10; ///< Cycles between obstacles
+const int    SCRATCH_CELLS = 1000000; ///< Larger maps are checked every 10th cycle only
+
+static double usecSince ( const timeval & t0 )
+{
+  timeval t1;
+  gettimeofday(&t1, 0);
+  return (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_usec - t0.tv_usec);
+}
+
+/// Random free cell center
+static void randomFree ( const CostMap & costs, double * x, double * y )
+{
+  int cx, cy;
+  do {
+    cx = rand() % costs.width();
+    cy = rand() % costs.height();
+  } while (costs.at(cx, cy) >= CostMap::INSCRIBED);
+  *x = costs.originx() + (cx + 0.5)*costs.resolution();
+  *y = costs.originy() + (cy + 0.5)*costs.resolution();
+}
+
+/// Put an obstacle at (x, y) into the planner with its inflated costs
+static void addObstacle ( DStarLite & planner, double res, double x, double y )
+{
+  const int r = (int)ceil((OBSTACLE + SAFETY + INFLATION)/res);
+  const int ox = planner.cellX(x), oy = planner.cellY(y);
+  for (int cy=oy-r; cy<=oy+r; cy++)
+    for (int cx=ox-r; cx<=ox+r; cx++) {
+      if (!planner.inside(cx, cy)) continue;
+      // Distance of the cell center to the square
+      const double dx = std::max(0., fabs((cx - ox)*res) - OBSTACLE);
+      const double dy = std::max(0., fabs((cy - oy)*res) - OBSTACLE);
+      const unsigned char c = CostMap::costOf(hypot(dx, dy), SAFETY, INFLATION);
+      const unsigned char old = planner.costAt(cx, cy);
+      if (old != CostMap::UNKNOWN && c > old) planner.setCost(cx, cy, c);
+    }
+}
+
+/// Search from scratch on the costs of a planner
+static bool scratch ( const DStarLite & planner, DStarLite & fresh, const CostMap & costs,
+                      double sx, double sy, double gx, double gy )
+{
+  fresh.setMap(costs);
+  for (int cy=0; cy<costs.height(); cy++)
+    for (int cx=0; cx<costs.width(); cx++) fresh.setCost(cx, cy, planner.costAt(cx, cy));
+  fresh.setStart(sx, sy);
+  fresh.setGoal(gx, gy);
+  return fresh.replan();
+}
+
+static void bench ( const MapFile & mf )
+{
+  GridMap map;
+  if (!map.readImage(mf.file, mf.res, mf.originX, mf.originY)) {
+    printf("%s: cannot read, skipped\n", mf.file);
+    return;
+  }
+  timeval t0;
+  gettimeofday(&t0, 0);
+  DistanceMap dist;
+  dist.compute(map);
+  CostMap costs;
+  costs.build(map, dist, SAFETY, INFLATION);
+  printf("%s: %dx%d at %.4f m, C-space in %.0f ms\n", mf.file, map.width(), map.height(),
+      map.resolution(), usecSince(t0)/1e3);
+
+  // Start and goal far apart with a path between them
+  DStarLite planner;
+  planner.setMap(costs);
+  const double diag = hypot(map.width(), map.height())*map.resolution();
+  double sx = 0., sy = 0., gx = 0., gy = 0.;
+  std::vector<double> px, py;
+  bool found = false;
+  for (int tries=0; tries<50 && !found; tries++) {
+    randomFree(costs, &sx, &sy);
+    randomFree(costs, &gx, &gy);
+    if (hypot(gx - sx, gy - sy) < diag/3) continue;
+    planner.setStart(sx, sy);
+    planner.setGoal(gx, gy);
+    found = planner.replan() && planner.path(px, py);
+  }
+  if (!found) {
+    printf("  no start and goal found, skipped\n");
+    return;
+  }
+  const ts_PlanStats & st = planner.stats();
+  printf("  (%.2f, %.2f) to (%.2f, %.2f): %.1f m path, first plan %d cells in %.1f ms\n",
+      sx, sy, gx, gy, (px.size() - 1)*map.resolution(), st.expanded, st.usec/1e3);
+
+  // Drive along the path, obstacles show up ahead
+  const bool everyCycle = map.width()*map.height() <= SCRATCH_CELLS;
+  DStarLite fresh;
+  double incUsec = 0., incMax = 0., freshUsec = 0.;
+  long incCells = 0, freshCells = 0;
+  int cycles = 0, checks = 0, mismatches = 0, obstacles = 0;
+  const int advance = std::max(1, (int)(STEP/map.resolution() + 0.5));
+  for (int c=0; c<CYCLES; c++) {
+    if ((int)px.size() <= advance) break;
+    sx = px[advance];
+    sy = py[advance];
+    planner.setStart(sx, sy);
+    if (c % OBSTACLE_EVERY == OBSTACLE_EVERY - 1) {
+      const int ahead = (int)((1. + 2.*rand()/RAND_MAX)/map.resolution());
+      if (ahead < (int)px.size() - 1) {
+        addObstacle(planner, map.resolution(), px[ahead], py[ahead]);
+        obstacles++;
+      }
+    }
+    const bool ok = planner.replan();
+    incUsec += st.usec;
+    incMax = std::max(incMax, st.usec);
+    incCells += st.expanded;
+    cycles++;
+    if (!ok || !planner.path(px, py)) break;
+    if (everyCycle || c % 10 == 0) {
+      scratch(planner, fresh, costs, sx, sy, gx, gy);
+      freshUsec += fresh.stats().usec;
+      freshCells += fresh.stats().expanded;
+      if (fabs(fresh.pathCost() - planner.pathCost()) > 1e-3*planner.pathCost()) mismatches++;
+      checks++;
+    }
+  }
+  printf("  %d replans, %d obstacles: D* Lite %.0f cells, %.3f ms (max %.2f ms) per replan; "
+      "from scratch %.0f cells, %.2f ms; %d of %d path costs differ\n", cycles, obstacles,
+      (double)incCells/cycles, incUsec/cycles/1e3, incMax/1e3, (double)freshCells/checks,
+      freshUsec/checks/1e3, mismatches, checks);
+}
+
+int main ( int argc, char **argv )
+{
+  srand(1);
+  if (argc > 4) {
+    const MapFile mf = { argv[1], atof(argv[2]), atof(argv[3]), atof(argv[4]) };
+    bench(mf);
+    return 0;
+  }
+  for (unsigned int m=0; m<sizeof(MAPS)/sizeof(MAPS[0]); m++) bench(MAPS[m]);
+  return 0;
+}
@@ -43,7 +43,25 @@
 #ifdef OPENCV //{{{
 # include "cc_camera1394.h"
 # include "cc_ballfinder.h"
+# include "cc_changedetector.h"
 #endif //}}}
+#include "balltracker.h"
+#include "posehistory.h"
+#include "scanframe.h"
+#include "scancircles.h"
+#include "scanlines.h"
+#include "footprint.h"
+#include "rollinggrid.h"
+#include "gridmap.h"
+#include "scanmatcher.h"
+#include "distancemap.h"
+#include "particlefilter.h"
+#include "dstarlite.h"
+#include "frontiers.h"
+#include "coverage.h"
+#include "distgrid.h"
+#include "dwaplanner.h"
+#include "blobball.h"
 
 using namespace PlayerCc;
 
@@ -57,7 +75,20 @@ using namespace PlayerCc;
 #define DEBUG_CAM_NO///< Output camera debug information
 #define ENABLE_LASER///< Uses sonar + laser if defined
 //#define OPENCV///< Uses omni vision camera via opencv library(Don't change-> makefile magic!)
+#define BLOBFINDER_NO///< Uses the (stage) blobfinder as ball source if no camera
+#define DWA_NO///< Dynamic window planner instead of the behaviour fusion
+#define MAPPING_NO///< Builds an occupancy grid map online (libpng)
+#define LOCALIZE_NO///< Localizes in the stage map with a particle filter (libpng)
+#define PLANNER_NO///< Follows a D* Lite path to a goal in the online map (needs MAPPING, DWA)
 // }}}
+#define EXPLORE_NO///< Explores the frontiers of the online map instead of wall following (needs PLANNER)
+#define COVERAGE_NO///< Accounts the floor area the laser covered, output with DEBUG_STATE
+#if defined PLANNER && !(defined MAPPING && defined DWA)
+#error "PLANNER needs MAPPING and DWA"
+#endif
+#if defined EXPLORE && !defined PLANNER
+#error "EXPLORE needs PLANNER"
+#endif
 
 // Parameters {{{
 const double VEL       = 0.3;///< Normal_advance_speed in meters per sec.
@@ -74,21 +105,129 @@ const double DIST_TOLERANCE = 0.5;///< Distance tolerance before stopping in met
 const time_t BALLTIMEOUT = 10;/// Goal tracking time out in seconds.
 const time_t BALLREQINT  = 1;/// Goal position request interval, i.e. driver
                                /// call, in seconds.
+const time_t BALLREQINT_TRACKED = 3;/// Goal position request interval while
+                               /// the tracker is confident, in seconds.
+const double TRACK_CONFIDENT = 10;///< Bearing std. deviation in deg below
+                               /// which the tracker is confident.
+const double TRACK_GAIN = 1.5; ///< Ball bearing to turnrate gain in 1/sec.
+const int    POSEHISTORY = 64; ///< Odometry poses kept for latency
+                                /// compensation, 6.4 sec at 10Hz.
+const double BALLRADIUS = 0.1; ///< Ball radius in meters for laser detection
+const double LBALL_STD_YAW  = 1;    ///< Laser ball bearing std. deviation in deg
+const double LBALL_STD_DIST = 0.03; ///< Laser ball distance std. deviation in meters
+const double BLOBFOV  = 60;  ///< Blobfinder field of view in deg (stage_local/devices.inc)
+const double BLOBSIZE = 0.3; ///< Blob (ball) size in meters (stage_local/devices.inc)
+const double EGOMOTION_DIST = 0.02; ///< Robot translation in meters regarded
+                                    /// as moving for ball detection reuse.
+const double EGOMOTION_YAW  = 1; ///< Robot rotation in degrees regarded as
+                                 /// moving for ball detection reuse.
 const double WALLFOLLOWDIST = 0.5; ///< Preferred wall following distance in meters.
 const double STOP_WALLFOLLOWDIST = 0.2; ///< Stop distance in meters.
 const double WALLLOSTDIST  = 1.5; ///< Wall attractor in meters before loosing walls.
 const double SHAPE_DIST = 0.3; ///< Min Radius from sensor for robot shape.
+const double WALLGAIN   = 4;   ///< Wall distance error to turnrate gain.
+const double WALLMINLEN = 0.3; ///< Min wall segment length in meters to follow.
+const double LINE_SPLITDIST = 0.03; ///< Max point to wall segment distance in meters.
+const double LINE_JUMP      = 0.1;  ///< Range jump in meters separating walls.
+const int    LINE_MINBEAMS  = 6;    ///< Min beams per wall segment.
+const long   LINE_BUDGET    = 1000; ///< Wall extraction time budget in usec.
 // Laser ranger
 const double LMAXANGLE = 240; ///< Laser max angle in degree
 const int BEAMCOUNT = 2; ///< Number of laser beams taken for one average distance measurement
 const double DEGPROBEAM   = 0.3515625; ///< 360./1024. in degree per laser beam
 const double LPMAX     = 5.0;  ///< max laser range in meters
+const double LPMIN     = 0.02; ///< min laser range in meters
+const double LASERMOUNT = 0.13; ///< Laser offset in front of robot center in meters
 const double SONARMAX  = 5.0;  ///< max sonar range in meters
 const double COS45     = 0.83867056795; ///< Cos(33);
 const double INV_COS45 = 1.19236329284; ///< 1/COS45
 const double DIAGOFFSET  = 0.1;  ///< Laser to sonar diagonal offset in meters.
 const double HORZOFFSET  = 0.15; ///< Laser to sonar horizontal offset in meters.
 const double MOUNTOFFSET = 0.1;  ///< Sonar vertical offset at back for laptop mount.
+// Robot footprint and sonar poses (stage_local/pioneer.inc)
+const double FP_LENGTH = 0.44;  ///< Robot length in meters
+const double FP_WIDTH  = 0.38;  ///< Robot width in meters
+const double FP_ORIGIN = -0.04; ///< Footprint center ahead of the center of rotation in meters
+const double FP_REACH  = 1.5;   ///< Obstacle distance in meters considered for collisions
+const double ROTATE_CHECK = 30; ///< Rotation in deg checked for collisions before turning
+const double TTC_VEL     = 0.5;  ///< Wall following speed in meters per sec. on a clear arc
+const double TTC_DECEL   = 0.5;  ///< Braking deceleration in meters per sec^2
+const double TTC_LATENCY = 0.2;  ///< Time in sec. until a new speed takes effect
+const double TTC_MARGIN  = 0.1;  ///< Distance in meters left when stopped in front of obstacles
+const int    SONARCOUNT = 16;   ///< Number of sonars
+const double SONARPOSE[SONARCOUNT][3] = { ///< Sonar x, y in meters and yaw in deg
+  {  0.075,  0.130,   90 }, {  0.115,  0.115,   50 }, {  0.150,  0.080,   30 },
+  {  0.170,  0.025,   10 }, {  0.170, -0.025,  -10 }, {  0.150, -0.080,  -30 },
+  {  0.115, -0.115,  -50 }, {  0.075, -0.130,  -90 }, { -0.155, -0.130,  -90 },
+  { -0.195, -0.115, -130 }, { -0.230, -0.080, -150 }, { -0.250, -0.025, -170 },
+  { -0.250,  0.025,  170 }, { -0.230,  0.080,  150 }, { -0.195,  0.115,  130 },
+  { -0.155,  0.130,   90 } };
+const double SONARFOV    = 15;   ///< Sonar cone opening in deg
+const double MEMORY_SIZE = 8.;   ///< Obstacle memory side length in meters
+const double MEMORY_RES  = 0.05; ///< Obstacle memory cell size in meters
+// Online map, grid and start pose as "make slam" (pmaptest)
+const double MAP_SIZE     = 16;    ///< Map side length in meters
+const double MAP_RES      = 0.08;  ///< Map cell size in meters
+const double MAP_STARTX   = -7;    ///< Start position in the map in meters
+const double MAP_STARTY   = -7;    ///< Start position in the map in meters
+const double MAP_STARTYAW = 90;    ///< Start orientation in the map in deg
+const double MAP_SAVE     = 5;     ///< Map file write interval in seconds
+const char   MAP_IMAGE[]  = "map.png"; ///< Map file for the mapfile driver
+const int    MATCH_START    = 10;  ///< Scans mapped before matching starts
+const int    MATCH_REBUILD  = 10;  ///< Scans between matcher map updates
+const double MATCH_WINDOW   = 0.3; ///< Translation search window +- in meters
+const double MATCH_ANGLE    = 10;  ///< Rotation search window +- in deg
+const double MATCH_MINSCORE = 0.5; ///< Min match score to correct odometry
+const int    MATCH_THREADS  = 2;   ///< Scan matcher threads
+// Localization in the bitmap of stage_local/uhh.world (16x16 m), start pose of r0
+const char   LOC_MAP[]      = "stage_local/bitmaps/tams_corr_orig_cut_q_05.png"; ///< Map image
+const double LOC_RES        = 0.05; ///< Map pixel size in meters
+const double LOC_ORIGINX    = -8;   ///< Lower left map corner in meters
+const double LOC_ORIGINY    = -8;   ///< Lower left map corner in meters
+const double LOC_STARTX     = -6;   ///< Start position in the map in meters
+const double LOC_STARTY     = -5;   ///< Start position in the map in meters
+const double LOC_STARTYAW   = 0;    ///< Start orientation in the map in deg
+const double LOC_INITXY     = 0.2;  ///< Start position std. deviation in meters
+const double LOC_INITYAW    = 10;   ///< Start orientation std. deviation in deg
+const int    LOC_MINPARTICLES = 500;   ///< Particles at least (KLD sampling)
+const int    LOC_MAXPARTICLES = 30000; ///< Particles at most and at the start
+const int    LOC_BEAMS      = 60;   ///< Laser beams per filter update
+const double LOC_UPDATEDIST = 0.05; ///< Travel in meters between filter updates
+const double LOC_UPDATEYAW  = 3;    ///< Turn in deg between filter updates
+const char   CACHE_DIR[]    = "/tmp/mapcache"; ///< Map distance transform cache
+// Global planner on the online map
+const double PLAN_GOALX     = 5;   ///< Goal in the map in meters
+const double PLAN_GOALY     = 5;   ///< Goal in the map in meters
+const double PLAN_SAFETY    = 0.3; ///< C-space safety distance in meters
+const double PLAN_INFLATION = 0.5; ///< Cost decay distance beyond it in meters
+const double PLAN_LOOKAHEAD = 1.;  ///< Path distance of the local planner goal in meters
+const double PLAN_REACHED   = 0.3; ///< Goal distance counting as reached in meters
+const int    PLAN_THREADS   = 2;   ///< C-space threads
+const int    EXPLORE_SELECT = 20;  ///< Scans between frontier target selections
+const int    EXPLORE_MINSIZE = 8;  ///< Frontier cells of the smallest target
+// Coverage accounting in the frame of the online map
+const double COVER_RANGE  = 3;     ///< Useful laser range in meters
+const double COVER_AREA   = 234;   ///< Free floor of the uhh.world bitmap in m^2
+const double COVER_REPORT = 5;     ///< Coverage output interval in seconds
+// Dynamic window planner
+const double DWA_VEL      = 0.6; ///< Max speed in meters per sec.
+const double DWA_TURN_RATE = 60; ///< Max turnrate in deg per sec.
+const double DWA_ACC      = 0.5; ///< Acceleration in meters per sec^2
+const double DWA_ROTACC   = 90;  ///< Rotational acceleration in deg per sec^2
+const double DWA_CYCLE    = 0.1; ///< Control cycle in sec.
+const double DWA_HORIZON  = 1.5; ///< Simulated time in sec.
+const int    DWA_STEPS    = 15;  ///< Simulation steps over the horizon
+const int    DWA_NV       = 21;  ///< Speed samples of the window
+const int    DWA_NW       = 25;  ///< Turnrate samples of the window
+const double DWA_HEADING  = 2.;  ///< Goal heading score weight
+const double DWA_CLEAR    = 0.2; ///< Clearance score weight
+const double DWA_VELOCITY = 0.2; ///< Speed score weight
+const int    DWA_CHECKS   = 8;   ///< Best arcs checked with the footprint
+const double DWA_GOALDIST = 2.;  ///< Goal distance in meters along the
+                                 /// direction the behaviours head to.
+const double GRID_SIZE    = 6.;  ///< Distance grid side length in meters
+const double GRID_RES     = 0.05; ///< Distance grid cell size in meters
+const double GRID_MAXDIST = 1.;  ///< Distance grid cap in meters
 const int LMIN  = 175;/**< LEFT min angle.       */ const int LMAX  = 240; ///< LEFT max angle.
 const int LFMIN = 140;/**< LEFTFRONT min angle.  */ const int LFMAX = 175; ///< LEFTFRONT max angle.
 const int FMIN  = 100;/**< FRONT min angle.      */ const int FMAX  = 140; ///< FRONT max angle.
@@ -96,6 +235,29 @@ const int RFMIN = 65; /**< RIGHTFRONT min angle. */ const int RFMAX = 100; ///<
 const int RMIN  = 0;  /**< RIGHT min angle.      */ const int RMAX  = 65;  ///< RIGHT max angle.
 // }}} Parameters
 
+#ifdef DWA
+/// Planner configuration from the parameters
+ts_DwaConfig dwaConfig ( void )
+{
+  ts_DwaConfig cfg;
+  cfg.vMax      = DWA_VEL;
+  cfg.wMax      = dtor(DWA_TURN_RATE);
+  cfg.acc       = DWA_ACC;
+  cfg.rotAcc    = dtor(DWA_ROTACC);
+  cfg.dt        = DWA_CYCLE;
+  cfg.horizon   = DWA_HORIZON;
+  cfg.steps     = DWA_STEPS;
+  cfg.nv        = DWA_NV;
+  cfg.nw        = DWA_NW;
+  cfg.halfWidth = FP_WIDTH/2;
+  cfg.wHeading  = DWA_HEADING;
+  cfg.wClear    = DWA_CLEAR;
+  cfg.wVel      = DWA_VELOCITY;
+  cfg.checks    = DWA_CHECKS;
+  return cfg;
+}
+#endif
+
 /// This class represents a robot.
 /// The robot object provides wall following behaviour.
 class Robot {
@@ -108,12 +270,18 @@ private:
   //SonarProxy      *sp;
   RangerProxy     *sp; ///< New in Stage-4.0: only ranger is supported
   Position2dProxy *pp;
+#ifdef BLOBFINDER
+  BlobfinderProxy *bp; ///< Simulated camera
+  BlobBall         blobBall; ///< Blob to ball conversion
+#endif
   /// Current behaviour of the robot.
   enum StateType {  // {{{
     WALL_FOLLOWING,
     COLLISION_AVOIDANCE,
     WALL_SEARCHING,
-    BALL_TRACKING
+    BALL_TRACKING,
+    PATH_FOLLOWING,
+    EXPLORING
   };  // }}}
   /// Used for simple range area distinction.
   enum viewDirectType { // {{{
@@ -134,6 +302,51 @@ private:
   double    trackTurnrate; ///< Zero or tracking the ball turnrate
   double    trackSpeed; ///< Tracking ball speed
   StateType currentState; ///< Current robot state
+  PoseHistory<POSEHISTORY> poses; ///< Time stamped odometry
+  Footprint footprint; ///< Robot shape with the current obstacle points
+  double    ttcX, ttcY; ///< Obstacle point limiting the speed
+  RollingGrid memory; ///< Laser and sonar obstacles around the robot
+  std::vector<float> obstX, obstY; ///< Obstacles within reach of the footprint
+#ifdef MAPPING
+  GridMap map;    ///< Online map, origin at its lower left corner
+  double mapSaved; ///< Time of the last map file write
+  double mapStart; ///< Time of the first scan
+  int mapScans;    ///< Scans in the map
+  ScanMatcher matcher; ///< Corrects odometry drift against the map
+  double corrX, corrY, corrYaw; ///< Map pose of the odometry origin
+  double mapX, mapY, mapYaw;    ///< Map pose of the last scan
+#endif
+#ifdef PLANNER
+  DistanceMap planDist;  ///< Obstacle distances of the online map
+  CostMap     planCosts; ///< C-space of the online map
+  DStarLite   planner;   ///< Path to the goal, repaired as the map grows
+  std::vector<double> pathX, pathY; ///< Path in the map from the robot on
+  bool        planValid; ///< Path to follow
+#endif
+#ifdef EXPLORE
+  Frontiers   frontiers;     ///< Borders of the known space
+  bool        exploreTarget; ///< Frontier to head to
+  int         exploreX, exploreY; ///< Frontier target cell
+#endif
+#ifdef COVERAGE
+  Coverage    coverage;      ///< Floor observed by the laser
+  double      coverReported; ///< Time of the last coverage output
+#endif
+#ifdef LOCALIZE
+  ParticleFilter localizer; ///< Pose in the stage map
+  int    locUpdates;        ///< Filter updates so far
+  double locOdomX, locOdomY, locOdomYaw; ///< Odometry of the last update
+  double locX, locY, locYaw; ///< Localized pose of the last update
+#endif
+#ifdef DWA
+  DistGrid   grid; ///< Obstacle distances around the robot
+  DwaPlanner dwa;  ///< Local planner
+#endif
+#ifdef ENABLE_LASER
+  ScanFrame   scan; ///< Current laser scan and its end points
+  ScanCircles laserBalls; ///< Ball sized circles in the current laser scan
+  ScanLines   lines; ///< Wall segments in the current laser scan
+#endif
 
   /// Returns the minimum distance of the given arc.
   /// Algorithm calculates the average of BEAMCOUNT beams
@@ -244,6 +457,9 @@ private:
 
   /// Calculates the turnrate from range measurement and minimum wall follow
   /// distance.
+  /// If a left wall segment is extracted from the laser scan the robot heads
+  /// parallel to it and steers towards the wall follow distance, otherwise
+  /// the distance is approximated by the left front sector minimum.
   /// @param Current state of the robot.
   /// @returns Turnrate to follow wall.
   inline double wallfollow( StateType * currentState )
@@ -264,8 +480,15 @@ private:
     DistLRear = getDistance(LEFTREAR);
 
     // do simple (left) wall following
+#ifdef ENABLE_LASER
+    double wallAngle, wallDist;
+    if (lines.leftWall(WALLMINLEN, WALLLOSTDIST+HORZOFFSET+SHAPE_DIST, &wallAngle, &wallDist)) {
+      // Wall distance alike getDistance(LEFT)
+      turnrate = wallAngle + atan( (wallDist-HORZOFFSET-SHAPE_DIST - WALLFOLLOWDIST) * WALLGAIN );
+    } else
+#endif
     //do naiv calculus for turnrate; weight dist vector
-    turnrate = atan( (COS45*DistLFov - WALLFOLLOWDIST ) * 4 );
+    turnrate = atan( (COS45*DistLFov - WALLFOLLOWDIST ) * WALLGAIN );
 #ifdef DEBUG_STATE  // {{{
     std::cout << "WALLFOLLOW" << std::endl;
 #endif  // }}}
@@ -287,27 +510,12 @@ private:
     return turnrate;
   }
 
-  inline void getDistanceFOV (double * right_min, double * left_min)
-  {
-    double distLeftFront  = getDistance(LEFTFRONT);
-    double distFront      = getDistance(FRONT);
-    double distRightFront = getDistance(RIGHTFRONT);
-
-    *left_min  = (distFront + distLeftFront)  / 2;
-    *right_min = (distFront + distRightFront) / 2;
-  }
-
   // Biased by left wall following
+  /// Avoids if the footprint driving the turnrate at normal speed would hit
+  /// an obstacle within the stop distance.
   inline void collisionAvoid ( double * turnrate, StateType * currentState)
   {
-    double left_min  = LPMAX;
-    double right_min = LPMAX;
-
-    // Scan FOV for Walls
-    getDistanceFOV(&right_min, &left_min);
-
-    if ((left_min  < STOP_WALLFOLLOWDIST) ||
-        (right_min < STOP_WALLFOLLOWDIST)   )
+    if (!footprint.free(VEL, *turnrate, STOP_WALLFOLLOWDIST/VEL))
     {
       *currentState = COLLISION_AVOIDANCE;
       // Turn right as long we want left wall following
@@ -318,46 +526,72 @@ private:
     }
   }
 
-  /// @todo Code review
+  /// Speed limited by the time to collision on the commanded arc.
+  /// The footprint's time to collision with the laser and sonar points is
+  /// computed for driving the current turnrate at TTC_VEL and converted to
+  /// the path length left. The speed is the highest one that still stops
+  /// within that length minus TTC_MARGIN after TTC_LATENCY.
   inline double calcspeed ( void )
   {
-    double tmpMinDistFront = PlayerCc::min(getDistance(LEFTFRONT), PlayerCc::min(getDistance(FRONT), getDistance(RIGHTFRONT)));
-    double tmpMinDistBack  = PlayerCc::min(getDistance(LEFTREAR), PlayerCc::min(getDistance(BACK), getDistance(RIGHTREAR)));
-    double speed = VEL;
-
-    if (tmpMinDistFront < WALLFOLLOWDIST) {
-      speed = VEL * (tmpMinDistFront/WALLFOLLOWDIST);
-
-      // Do not turn back if there is a wall!
-      if (tmpMinDistFront<0 && tmpMinDistBack<0)
-        tmpMinDistBack<tmpMinDistFront ? speed=(VEL*tmpMinDistFront)/(tmpMinDistFront+tmpMinDistBack) : speed;
-      //speed=(VEL*(tmpMinDistBack-tmpMinDistFront))/SHAPE_DIST;
-      //tmpMinDistBack<tmpMinDistFront ? speed=(VEL*(tmpMinDistFront-tmpMinDistBack))/WALLFOLLOWDIST : speed;
-    }
-    return speed;
+    const double ttc = footprint.timeToCollision(TTC_VEL, turnrate,
+        FP_REACH/TTC_VEL, &ttcX, &ttcY);
+    const double dist = ttc*TTC_VEL - TTC_MARGIN;
+    if (dist <= 0) return 0;
+    const double lag = TTC_DECEL*TTC_LATENCY;
+    return PlayerCc::min(TTC_VEL, sqrt(lag*lag + 2*TTC_DECEL*dist) - lag);
   }
 
   /// Checks if turning the robot is not causing collisions.
-  /// Implements more or less a rotation policy which decides depending on
-  /// obstacles at the 4 robot edge surounding spots
-  /// To not interfere to heavy to overall behaviour turnrate is only inverted (or
-  /// set to zero)
+  /// The footprint is rotated in place by ROTATE_CHECK degrees into the
+  /// turn direction against the laser and sonar points.
+  /// To not interfere to heavy to overall behaviour turnrate is only set to
+  /// zero
   /// @param Turnrate
-  /// @todo Code review
   inline void checkrotate (double * turnrate)
   {
-    if (*turnrate < 0) { // Right turn
-      getDistance(LEFTREAR)<0 ? *turnrate=0 : *turnrate;
-      getDistance(RIGHT)   <0 ? *turnrate=0 : *turnrate;
-    } else { // Left turn
-      getDistance(RIGHTREAR)<0 ? *turnrate=0 : *turnrate;
-      getDistance(LEFT)     <0 ? *turnrate=0 : *turnrate;
-    }
+    if (*turnrate != 0 &&
+        !footprint.free(0, *turnrate, dtor(ROTATE_CHECK)/fabs(*turnrate)))
+      *turnrate = 0;
   }
 
 public:
-  Robot(std::string name, int address, int id) {
-    robot = new PlayerClient(name, address);
+  Robot(std::string name, int address, int id)
+    : robot(new PlayerClient(name, address))
+#ifdef BLOBFINDER
+    , blobBall(dtor(BLOBFOV), BLOBSIZE)
+#endif
+    , footprint(FP_LENGTH, FP_WIDTH, FP_ORIGIN)
+    , memory(MEMORY_SIZE, MEMORY_RES)
+#ifdef MAPPING
+    , map(MAP_SIZE, MAP_SIZE, MAP_RES, -MAP_SIZE/2, -MAP_SIZE/2)
+    , mapSaved(0), mapStart(0), mapScans(0)
+    , matcher(5, 0.1, MATCH_THREADS)
+    , corrX(MAP_STARTX), corrY(MAP_STARTY), corrYaw(dtor(MAP_STARTYAW))
+    , mapX(MAP_STARTX), mapY(MAP_STARTY), mapYaw(dtor(MAP_STARTYAW))
+#endif
+#ifdef PLANNER
+    , planDist(PLAN_THREADS), planCosts(PLAN_THREADS), planValid(false)
+#endif
+#ifdef EXPLORE
+    , frontiers(EXPLORE_MINSIZE), exploreTarget(false), exploreX(0), exploreY(0)
+#endif
+#ifdef COVERAGE
+    , coverage(MAP_RES, COVER_RANGE), coverReported(0)
+#endif
+#ifdef LOCALIZE
+    , localizer(LOC_MINPARTICLES, LOC_MAXPARTICLES, LOC_BEAMS)
+    , locUpdates(0), locOdomX(0), locOdomY(0), locOdomYaw(0)
+    , locX(LOC_STARTX), locY(LOC_STARTY), locYaw(dtor(LOC_STARTYAW))
+#endif
+#ifdef DWA
+    , grid(GRID_SIZE, GRID_RES, GRID_MAXDIST)
+    , dwa(dwaConfig())
+#endif
+#ifdef ENABLE_LASER
+    , laserBalls(BALLRADIUS)
+    , lines(LINE_SPLITDIST, LINE_JUMP, LINE_MINBEAMS, LINE_BUDGET)
+#endif
+  {
     pp    = new Position2dProxy(robot, id);
 #ifdef ENABLE_LASER
     lp = new RangerProxy(robot, id+1);
@@ -365,14 +599,225 @@ public:
 #endif
     //sp    = new SonarProxy(robot, id);
     sp    = new RangerProxy(robot, id);
+#ifdef BLOBFINDER
+    bp    = new BlobfinderProxy(robot, id);
+#endif
     robotID      = id;
     currentState = WALL_FOLLOWING;
+    speed        = 0;
+    turnrate     = 0;
+    ttcX = ttcY  = 0;
     pp->SetMotorEnable(true);
     trackTurnrate = TRACKING_NO; // Disable tracking camera targets be default
+#ifdef LOCALIZE
+    GridMap locMap;
+    if (locMap.readImage(LOC_MAP, LOC_RES, LOC_ORIGINX, LOC_ORIGINY)) {
+      DistanceMap locDist;
+      locDist.load(locMap, CACHE_DIR);
+      localizer.setMap(locMap, locDist);
+      localizer.init(LOC_STARTX, LOC_STARTY, dtor(LOC_STARTYAW),
+          LOC_INITXY, dtor(LOC_INITYAW));
+    } else {
+      std::cerr << "Cannot read " << LOC_MAP << std::endl;
+    }
+#endif
+  }
+
+#if defined MAPPING && defined ENABLE_LASER
+  /// Matches the current scan against the map to correct the odometry,
+  /// then adds it to the map at the corrected pose.
+  /// @param now Time of the scan in seconds
+  inline void mapScan ( double now )
+  {
+    const double ox = pp->GetXPos(), oy = pp->GetYPos(), oyaw = pp->GetYaw();
+    double x = corrX + cos(corrYaw)*ox - sin(corrYaw)*oy;
+    double y = corrY + sin(corrYaw)*ox + cos(corrYaw)*oy;
+    double yaw = corrYaw + oyaw;
+    if (mapScans >= MATCH_START) {
+      double mx, my, myaw;
+      if (mapScans % MATCH_REBUILD == 0) matcher.setMap(map);
+      if (matcher.match(scan, LPMIN, LPMAX, x, y, yaw, MATCH_WINDOW,
+            dtor(MATCH_ANGLE), &mx, &my, &myaw) >= MATCH_MINSCORE) {
+        // Odometry origin moved so it gives the matched pose
+        x = mx; y = my; yaw = myaw;
+        corrYaw = yaw - oyaw;
+        corrX = x - (cos(corrYaw)*ox - sin(corrYaw)*oy);
+        corrY = y - (sin(corrYaw)*ox + cos(corrYaw)*oy);
+      }
+    }
+    if (mapScans == 0) mapStart = now;
+    map.addScan(scan, LPMIN, LPMAX, x, y, yaw);
+    mapScans++;
+    mapX = x; mapY = y; mapYaw = yaw;
+    if (now - mapSaved >= MAP_SAVE) {
+      if (!map.writePng(MAP_IMAGE))
+        std::cerr << "Cannot write " << MAP_IMAGE << std::endl;
+      mapSaved = now;
+#ifdef DEBUG_STATE  // {{{
+      std::cout << "mapped (m^2, m^2/min):\t" << map.knownArea() << "\t"
+        << map.knownArea()/PlayerCc::max((now - mapStart)/60, 1./60) << std::endl;
+#endif  // }}}
+    }
+  }
+#endif
+
+#if defined PLANNER && defined ENABLE_LASER
+  /// Repairs the path to the goal with the C-space of the online map after
+  /// the latest scan; the planner expands only what the changed cells affect.
+  inline void planPath ( void )
+  {
+    planDist.compute(map);
+    planCosts.build(map, planDist, PLAN_SAFETY, PLAN_INFLATION);
+    if (mapScans == 1) {
+      planner.setMap(planCosts);
+      planner.setStart(mapX, mapY);
+#ifndef EXPLORE
+      planner.setGoal(PLAN_GOALX, PLAN_GOALY);
+#endif
+    } else {
+      planner.update(planCosts);
+      planner.setStart(mapX, mapY);
+    }
+#ifdef EXPLORE
+    frontiers.update(map);
+    if (mapScans % EXPLORE_SELECT == 1 || !planValid || !frontiers.isFrontier(exploreX, exploreY))
+      selectFrontier();
+    planValid = exploreTarget && planner.replan() && planner.path(pathX, pathY);
+#else
+    planValid = hypot(PLAN_GOALX - mapX, PLAN_GOALY - mapY) > PLAN_REACHED &&
+      planner.replan() && planner.path(pathX, pathY);
+#endif
+  }
+
+#ifdef EXPLORE
+  /// Heads to the frontier cluster of most frontier per path length. The
+  /// goal is kept while it stays a frontier, between selections. Without a
+  /// reachable frontier the robot falls back to wall following.
+  inline void selectFrontier ( void )
+  {
+    const int best = frontiers.select(planCosts, mapX, mapY);
+    if (best >= 0) {
+      const ts_Frontier & f = frontiers.clusters()[best];
+      if (!exploreTarget || f.cx != exploreX || f.cy != exploreY) planner.setGoal(f.x, f.y);
+      exploreX = f.cx;
+      exploreY = f.cy;
+    }
+    exploreTarget = best >= 0;
+  }
+#endif
+
+  /// Path point PLAN_LOOKAHEAD ahead in robot coordinates
+  inline void pathGoal ( double * x, double * y )
+  {
+    unsigned int i = 1;
+    for (double d=0.; i+1<pathX.size(); i++) {
+      d += hypot(pathX[i] - pathX[i-1], pathY[i] - pathY[i-1]);
+      if (d >= PLAN_LOOKAHEAD) break;
+    }
+    i = PlayerCc::min(i, (unsigned int)pathX.size() - 1);
+    const double dx = pathX[i] - mapX, dy = pathY[i] - mapY;
+    *x =  cos(mapYaw)*dx + sin(mapYaw)*dy;
+    *y = -sin(mapYaw)*dx + cos(mapYaw)*dy;
   }
+#endif
+
+#if defined COVERAGE && defined ENABLE_LASER
+  /// Marks the floor the current scan observed. The pose is the one of the
+  /// online map with MAPPING, else the odometry from the map start pose.
+  /// @param now Time of the scan in seconds
+  inline void coverScan ( double now )
+  {
+#ifdef MAPPING
+    coverage.addScan(scan, LPMIN, mapX, mapY, mapYaw, now);
+#else
+    const double ox = pp->GetXPos(), oy = pp->GetYPos();
+    const double c = cos(dtor(MAP_STARTYAW)), s = sin(dtor(MAP_STARTYAW));
+    coverage.addScan(scan, LPMIN, MAP_STARTX + c*ox - s*oy, MAP_STARTY + s*ox + c*oy,
+        dtor(MAP_STARTYAW) + pp->GetYaw(), now);
+#endif
+#ifdef DEBUG_STATE  // {{{
+    if (now - coverReported >= COVER_REPORT) {
+      std::cout << "covered (m^2, m^2/min, revisits, s to 90%):\t" << coverage.area() << "\t"
+        << coverage.rate() << "\t" << coverage.revisitRatio() << "\t"
+        << coverage.timeTo(0.9*COVER_AREA) << std::endl;
+      coverReported = now;
+    }
+#endif  // }}}
+  }
+#endif
+
+#if defined LOCALIZE && defined ENABLE_LASER
+  /// Moves the particles by the odometry since the last filter update and
+  /// weights them by the current scan. As with amcl the filter is updated
+  /// only after some motion, standing still would make it overconfident.
+  inline void localize ( void )
+  {
+    const double ox = pp->GetXPos(), oy = pp->GetYPos(), oyaw = pp->GetYaw();
+    if (locUpdates > 0) {
+      if (hypot(ox - locOdomX, oy - locOdomY) < LOC_UPDATEDIST &&
+          fabs(normalize(oyaw - locOdomYaw)) < dtor(LOC_UPDATEYAW)) return;
+      localizer.predict(locOdomX, locOdomY, locOdomYaw, ox, oy, oyaw);
+    }
+    localizer.correct(scan, LPMIN, LPMAX);
+    localizer.resample();
+    localizer.estimate(&locX, &locY, &locYaw);
+    locOdomX = ox; locOdomY = oy; locOdomYaw = oyaw;
+    locUpdates++;
+  }
+#endif
 
   inline void update ( void ) {
+      timeval curTime;
       robot->Read(); ///< This blocks until new data comes; 10Hz by default
+      gettimeofday(&curTime, 0);
+      poses.push(curTime.tv_sec + curTime.tv_usec/1e6,
+          pp->GetXPos(), pp->GetYPos(), pp->GetYaw());
+#ifdef ENABLE_LASER
+      scan.setGeometry(lp->GetRangeCount(), -dtor(LMAXANGLE/2), dtor(DEGPROBEAM), LASERMOUNT);
+      for (int i=0; i<scan.size(); i++) scan.ranges()[i] = lp->GetRange(i);
+      scan.convert();
+      laserBalls.detect(scan, LPMIN, LPMAX);
+      lines.detect(scan, LPMIN, LPMAX);
+#ifdef MAPPING
+      mapScan(curTime.tv_sec + curTime.tv_usec/1e6);
+#endif
+#ifdef COVERAGE
+      coverScan(curTime.tv_sec + curTime.tv_usec/1e6);
+#endif
+#ifdef PLANNER
+      planPath();
+#endif
+#ifdef LOCALIZE
+      localize();
+#endif
+#endif
+      // Fuse laser and sonar into the obstacle memory, the collision checks
+      // see everything remembered within reach
+      memory.setPose(pp->GetXPos(), pp->GetYPos(), pp->GetYaw());
+#ifdef ENABLE_LASER
+      memory.addScan(scan, LPMIN, LPMAX);
+#endif
+      for (int i=0; i<PlayerCc::min(SONARCOUNT, (int)sp->GetRangeCount()); i++)
+        memory.addSonar(SONARPOSE[i][0], SONARPOSE[i][1], dtor(SONARPOSE[i][2]),
+            sp->GetRange(i), dtor(SONARFOV), SONARMAX);
+#ifdef DWA
+      memory.occupiedCells(GRID_SIZE/M_SQRT2, obstX, obstY);
+#else
+      memory.occupiedCells(footprint.radius() + FP_REACH, obstX, obstY);
+#endif
+      footprint.clearPoints();
+#ifdef DWA
+      grid.clear();
+#endif
+      for (unsigned int i=0; i<obstX.size(); i++) {
+        footprint.addPoint(obstX[i], obstY[i], FP_REACH);
+#ifdef DWA
+        grid.addPoint(obstX[i], obstY[i]);
+#endif
+      }
+#ifdef DWA
+      grid.update();
+#endif
   }
   inline void plan ( void ) {
 #ifdef DEBUG_SONAR  // {{{
@@ -380,13 +825,47 @@ public:
     for(int i=0; i< 16; i++)
       std::cout << "Sonar " << i << ": " << getSonar(i) << std::endl;
 #endif  // }}}
+#ifdef DWA
+    // The behaviours give the direction to head to, the planner the velocities
+    double goalTurnrate = 0.;
+    double maxSpeed     = DWA_VEL;
+    if ( trackTurnrate == TRACKING_NO ) {
+      goalTurnrate = wallfollow(&currentState);
+    } else {
+      currentState = BALL_TRACKING;
+      goalTurnrate = trackTurnrate;
+      maxSpeed     = trackSpeed > 0 ? DWA_VEL : 0;
+    }
+    // Goal along the direction the behaviour turns to within a second
+    const double goalBearing = limit(goalTurnrate, -M_PI/2, M_PI/2);
+    double goalX = DWA_GOALDIST*cos(goalBearing), goalY = DWA_GOALDIST*sin(goalBearing);
+#ifdef PLANNER
+    // A path to the goal overrides wall following
+    if ( trackTurnrate == TRACKING_NO && planValid ) {
+#ifdef EXPLORE
+      currentState = EXPLORING;
+#else
+      currentState = PATH_FOLLOWING;
+#endif
+      pathGoal(&goalX, &goalY);
+    }
+#endif
+    if (!dwa.plan(speed, turnrate, goalX, goalY, maxSpeed, grid, footprint,
+          &speed, &turnrate)) {
+      // No safe arc: stop and turn right as long we want left wall following
+      currentState = COLLISION_AVOIDANCE;
+      speed    = 0;
+      turnrate = -dtor(STOP_ROT);
+      checkrotate(&turnrate);
+    }
+#else
     if ( trackTurnrate == TRACKING_NO ) { ///< Check if ball is not detected in camera FOV
 
       // (Left) Wall following
       turnrate = wallfollow(&currentState);
       // Collision avoidance overrides other turnrate if neccessary!
       collisionAvoid(&turnrate, &currentState);
-      trackSpeed = VEL; // Disable track speed
+      trackSpeed = TTC_VEL; // Disable track speed
 
     } else {
       // Track the ball
@@ -396,20 +875,27 @@ public:
       speed    = trackSpeed;
     }
 
-    // Set speed dependend on the wall distance
-    speed = calcspeed();
-
-    // Fusion speed with ball tracking: lower wins
-    speed>trackSpeed ? speed=trackSpeed : speed;
-
     // Check if rotating is safe
     checkrotate(&tmp_turnrate);
 
     // Fusion of the vectors makes a smoother trajectory
     turnrate = (tmp_turnrate + turnrate) / 2;
+
+    // Set speed dependend on the obstacles on the resulting arc
+    speed = calcspeed();
+
+    // Fusion speed with ball tracking: lower wins
+    speed>trackSpeed ? speed=trackSpeed : speed;
+#endif
 #ifdef DEBUG_STATE  // {{{
     std::cout << "turnrate/speed/state:\t" << turnrate << "\t" << speed << "\t"
       << currentState << std::endl;
+    std::cout << "speed limited by:\t" << ttcX << "\t" << ttcY << std::endl;
+#ifdef PLANNER
+    std::cout << "path (valid/cost/expanded/changed/ms):\t" << planValid << "\t"
+      << planner.pathCost()*MAP_RES << "\t" << planner.stats().expanded << "\t"
+      << planner.stats().changed << "\t" << planner.stats().usec/1e3 << std::endl;
+#endif
 #endif  // }}}
 #ifdef DEBUG_DIST // {{{
     std::cout << "Laser (l/lf/f/rf/r/rb/b/lb):\t" << getDistanceLas(LMIN, LMAX)-HORZOFFSET << "\t"
@@ -439,6 +925,10 @@ public:
 #endif // }}}
 #ifdef DEBUG_POSITION // {{{
     std::cout << pp->GetXPos() << "\t" << pp->GetYPos() << "\t" << rtod(pp->GetYaw()) << std::endl;
+#ifdef LOCALIZE
+    std::cout << "localized (x/y/yaw/particles):\t" << locX << "\t" << locY << "\t"
+      << rtod(locYaw) << "\t" << localizer.size() << std::endl;
+#endif
 #endif  // }}}
   }
   /// Command the motors
@@ -458,6 +948,54 @@ public:
   void setSpeed ( double vl_speed ) { trackSpeed = vl_speed; }
   /// Get global robot orientation in radians
   double getOrientation ( void ) { return pp->GetYaw(); }
+  /// Get global robot odometry pose
+  /// @param x,y Position in meters
+  /// @param yaw Orientation in radians
+  void getPose ( double * x, double * y, double * yaw )
+  {
+    *x   = pp->GetXPos();
+    *y   = pp->GetYPos();
+    *yaw = pp->GetYaw();
+  }
+  /// Get the global robot odometry pose at a given time, interpolated from
+  /// the poses read in the past
+  /// @param t Time in seconds (gettimeofday)
+  /// @param x,y Position in meters
+  /// @param yaw Orientation in radians
+  /// @return False if t is not covered by the history (pose is clamped)
+  bool getPoseAt ( double t, double * x, double * y, double * yaw ) const
+  {
+    return poses.at(t, x, y, yaw);
+  }
+#ifdef ENABLE_LASER
+  /// Ball sized circles found in the current laser scan
+  const ScanCircles & getLaserBalls ( void ) const { return laserBalls; }
+#endif
+#ifdef BLOBFINDER
+  /// Balls seen by the blobfinder at the last read, time stamped with the
+  /// read time.
+  /// @param balls Filled with the blobs sorted by descending confidence
+  void getBlobBalls ( ts_Ball * balls )
+  {
+    balls->num   = 0;
+    balls->stamp = poses.size() ? poses.newest().t : 0.;
+    for (uint32_t i=0; i<bp->GetCount() && balls->num<BALLBATCH; i++) {
+      const player_blobfinder_blob_t blob = bp->GetBlob(i);
+      double b, d, c;
+      if (!blobBall.measure(bp->GetWidth(), blob.x, blob.left, blob.right,
+            blob.top, blob.bottom, blob.area, blob.range, &b, &d, &c)) continue;
+      int j = balls->num++;
+      for (; j>0 && balls->conf[j-1]<c; j--) {
+        balls->angle[j] = balls->angle[j-1];
+        balls->dist[j]  = balls->dist[j-1];
+        balls->conf[j]  = balls->conf[j-1];
+      }
+      balls->angle[j] = b;
+      balls->dist[j]  = d;
+      balls->conf[j]  = c;
+    }
+  }
+#endif
 }; // Class Robot
 //=================
 #ifndef OPENCV //{{{
@@ -465,8 +1003,9 @@ public:
 struct Ball
 {
   int num;
-  double* dist;
-  double* angle;
+  double dist[BALLBATCH];
+  double angle[BALLBATCH];
+  double conf[BALLBATCH];
 };
 #endif //}}}
 // Simulation of the camera's driver call
@@ -475,162 +1014,201 @@ const int height=960; ///< Camera height resolution definition
 #ifdef OPENCV //{{{
   Single1394 c1394;
   BallFinder fb;
+  ChangeDetector cd;
 #endif //}}}
 
 /// Read the camera driver's ball tracking information
 /// Call of the camera driver may take some time (~1sec)!
+/// The full detection is skipped and the previous result returned if neither
+/// the robot (odometry) nor the scene (frame difference) has moved since.
+/// Without camera the balls come from the robot's blobfinder (simulation).
+/// @param robot Robot providing the blobfinder
+/// @param x,y,yaw Current robot odometry pose
 /// @return Pointer to dynamic ball information object.
-ts_Ball * getBallInfo ( void ) {
+ts_Ball * getBallInfo ( Robot * robot, double x, double y, double yaw ) {
   static ts_Ball ballInfo;
 #ifdef OPENCV //{{{
+  static double lastX = 0., lastY = 0., lastYaw = 0.; // Pose of last detection
   Ball *balls;
+  bool moved = hypot(x - lastX, y - lastY) > EGOMOTION_DIST ||
+    fabs(normalize(yaw - lastYaw)) > dtor(EGOMOTION_YAW);
 
   c1394.captureImage();
+  ballInfo.stamp = c1394.captureTime;
+  if (moved) cd.Reset(); // New view, the frame has to become the reference
+  if (!cd.Changed(c1394.captureBuf)) {
+#ifdef DEBUG_CAM //{{{
+    std::cout << "Scene unchanged, ball detection reused" << std::endl;
+#endif //}}}
+    return &ballInfo;
+  }
+  lastX = x; lastY = y; lastYaw = yaw;
   balls=fb.DetectBall(c1394.captureBuf);
-  if ( balls->num > 0 ) {
-     ballInfo.angle = balls->angle[0];
-     ballInfo.dist  = balls->dist[0];
-     ballInfo.num   = balls->num;
-     delete []balls->angle;
-     delete []balls->dist;
-  } else {
-    ballInfo.num = 0;
+  ballInfo.num = PlayerCc::min(balls->num, BALLBATCH);
+  for (int i=0; i<ballInfo.num; i++) {
+    ballInfo.angle[i] = balls->angle[i];
+    ballInfo.dist[i]  = balls->dist[i];
+    ballInfo.conf[i]  = balls->conf[i];
+    assert( fabs(ballInfo.angle[i]) <= M_PI);
+    assert( ballInfo.dist[i] >= 0 );
   }
-  delete balls;
-
-  assert( abs(ballInfo.angle) <= M_PI);
-  assert( ballInfo.dist >= 0 );
   assert( ballInfo.num >= 0 );
+#elif defined BLOBFINDER
+  robot->getBlobBalls(&ballInfo);
 #endif //}}}
 
   return &ballInfo;
 }
-/// Calculates a relative turnrate towards goal angle
-/// @param curOrientation Current robot global orientation angle
-/// @param goalAngle Relative goal orientation angle
-/// @param newGoalFlag Marks current goal as new or not
-/// @return An estimated goal angle.
-/// Caution returned turnrate is only +/- M_PI bound!!
-/// Expects new goal flag to be set the first call!
-/// Will falsify it immediately and work on that goal until flag is (re-) set
-/// again
-double approxTurnrate(double curOrientation, double goalAngle, bool * newGoalFlag) {
-
-  static double goalYaw = 0.;
-  static double oldGoalAngle = 0.;
-  double approxTurnrate = 0.;
-
-  assert( abs(curOrientation) <= 2*M_PI );
-  assert( abs(goalAngle) <= M_PI );
-
-  // MARK NEW GOAL
-  if (*newGoalFlag == true) { // New goal defined
-    *newGoalFlag = false; // Mark current goal being tracked
-    // Normalized absolute goal angle
-    goalYaw = fmod((curOrientation + goalAngle), 2*M_PI);
-    oldGoalAngle = goalAngle;
-  }
-#ifdef DEBUG_CAM/*{{{*/
-  std::cout << "Goal YAW delta:\t" << fabs(curOrientation - goalYaw) << std::endl;
-#endif/*}}}*/
-
-  // Normalized absolute goal orientation
-  if (fabs(curOrientation - goalYaw) < dtor(YAW_TOLERANCE)){
-    approxTurnrate = 0; // Heading to the goal
-  } else { // Turning towards goal
-    (oldGoalAngle<0) ? (approxTurnrate=-dtor(TRACK_ROT)) : (approxTurnrate=dtor(TRACK_ROT));
-  }
-
-#ifdef DEBUG_CAM/*{{{*/
-  std::cout << "CurPos/GoalPos/Turnrate:\t"
-    << rtod(curOrientation) << "\t"
-    << rtod(goalYaw) << "\t"
-    << rtod(approxTurnrate) << std::endl;
-#endif/*}}}*/
-  assert( abs(approxTurnrate) <= dtor(TRACK_ROT) );
-
-  return approxTurnrate;
-}
 /// Abstraction layer between robot and camera.
 /// Gets goal coordinates from camera device and directs the robot to it
 /// accordingly.
 /// Camera functions are called in here.
+/// Out of all detected balls the tracker chooses the target. The detection is
+/// related to the robot pose at the frame's capture time, so the robot's
+/// motion while the (slow) detection ran is not mistaken for ball motion.
+/// Between camera calls the tracked ball is corrected at laser rate by the
+/// laser circle closest to it; only the camera confirms it is the ball, i.e.
+/// keeps the track alive, the laser refines bearing and distance.
+/// The ball is tracked by a Kalman filter which is propagated with odometry
+/// each cycle, so the turnrate follows the estimated ball bearing between the
+/// (slow) camera driver calls. The driver is called less often while the
+/// tracker is confident.
 /// @param Pointer to robot of type @ref Robot to command.
 void trackBall (Robot * robot)
 {
+  static BallTracker tracker; // Ball estimate relative to the robot
   ts_Ball * ballInfo; // Pointer to the ball coordinates from camera
-  double vl_turnrate = 0; // Local calculated robot write turnrate
-  static double robPrevTurnrate = 0.; // Last turnrate before this one
-  double goalAngle = 0.; // Relative turnrate to goal
-  double goalDist  = LPMAX; // Relative distance to goal
+  int target = -1; // Index of the tracked ball in ballInfo
+  double vl_turnrate = TRACKING_NO; // Local calculated robot write turnrate
   timeval curTime; // Current system time
   double curTimeSec = 0.; // Current time in seconds
-  double curOrientation = 0.; // Robot current global orientation
+  double x, y, yaw; // Robot current odometry pose
+  static double lastX = 0., lastY = 0., lastYaw = 0.; // Pose of the last cycle
+  static double lastCycle = 0.; // Time of the last cycle
   static double lastFound = 0.; // Time when ball was last found
   static double lastBallReq = 0.; // Time when ball was last searched
-  bool newGoalFlag = false;
+  time_t reqInterval = BALLREQINT; // Current driver call interval
 
   // Get current time
   gettimeofday(&curTime, 0);
   curTimeSec = curTime.tv_sec + curTime.tv_usec/1e6;
   assert( curTimeSec >= 1 );
 
-  // Current global orientation of robot
-  curOrientation = robot->getOrientation();
-  assert( abs(curOrientation) <= 2*M_PI );
+  // Propagate the ball estimate by the robot motion since the last cycle
+  robot->getPose(&x, &y, &yaw);
+  if (lastCycle > 0.) {
+    const double dxw = x - lastX;
+    const double dyw = y - lastY;
+    tracker.predict(curTimeSec - lastCycle,
+         cos(lastYaw)*dxw + sin(lastYaw)*dyw,
+        -sin(lastYaw)*dxw + cos(lastYaw)*dyw,
+        normalize(yaw - lastYaw));
+  }
+  lastX = x; lastY = y; lastYaw = yaw;
+  lastCycle = curTimeSec;
+
+  if (tracker.valid() && sqrt(tracker.bearingVar()) < dtor(TRACK_CONFIDENT))
+    reqInterval = BALLREQINT_TRACKED;
 
   assert( curTimeSec >= lastBallReq );
-  // Call driver only once each BALLREQINT
-  if(curTimeSec-lastBallReq >= BALLREQINT) {
+  // Call driver only once each request interval
+  if(curTimeSec-lastBallReq >= reqInterval) {
 
-    ballInfo = getBallInfo(); // Call the camera driver
+    ballInfo = getBallInfo(robot, x, y, yaw); // Call the camera driver
 #ifdef DEBUG_CAM //{{{
-   std::cout << "Ball ctime/dist./angle/num:\t"
-     << curTimeSec << "\t"
-     << ballInfo->dist << "\t"
-     << ballInfo->angle << "\t"
-     << ballInfo->num << std::endl;
+    for (int i=0; i<ballInfo->num; i++)
+      std::cout << "Ball ctime/latency/dist./angle/conf:\t"
+        << curTimeSec << "\t"
+        << curTimeSec - ballInfo->stamp << "\t"
+        << ballInfo->dist[i] << "\t"
+        << ballInfo->angle[i] << "\t"
+        << ballInfo->conf[i] << std::endl;
 #endif //}}}
     lastBallReq = curTimeSec; // Reset request time
 
-    if ( ballInfo->num == 0 ) { // When no balls have been found
+    // Move the detections from the robot frame at capture time into the
+    // current one (the driver's result may be reused, so work on a copy)
+    ts_Ball balls = *ballInfo;
+    {
+      double xc, yc, yawc;
+      robot->getPoseAt(balls.stamp, &xc, &yc, &yawc);
+      for (int i=0; i<balls.num; i++) {
+        const double wx = xc + balls.dist[i]*cos(yawc + balls.angle[i]) - x;
+        const double wy = yc + balls.dist[i]*sin(yawc + balls.angle[i]) - y;
+        balls.angle[i] = normalize(atan2(wy, wx) - yaw);
+        balls.dist[i]  = hypot(wx, wy);
+      }
+    }
+    target = tracker.associate(balls.num, balls.angle, balls.dist, balls.conf);
+    if ( target >= 0 && tracker.update(balls.angle[target], balls.dist[target]) ) {
+      lastFound = curTimeSec; // Reset found time
 #ifdef DEBUG_CAM //{{{
-      std::cout << "NO BALL FOUND" << std::endl;
+      std::cout << "BALL FOUND at angle/time:\t"
+        << balls.angle[target] << "\t"
+        << curTimeSec << std::endl;
 #endif //}}}
-      assert( curTimeSec >= lastFound );
-      if(curTimeSec-lastFound > BALLTIMEOUT) { // When beyond the time out
+    } else {
 #ifdef DEBUG_CAM //{{{
-        std::cout << "  BALLTRACKING TIMEOUT (sec)\t" << BALLTIMEOUT << std::endl;
+      std::cout << "NO BALL FOUND (or gated out)" << std::endl;
 #endif //}}}
-        vl_turnrate = TRACKING_NO; // Robot will do another task
-      }
-    } else { // A ball has been found
-      lastFound = curTimeSec; // Reset found time
-      goalAngle = ballInfo->angle;
-      goalDist  = ballInfo->dist;
-      if (goalDist < DIST_TOLERANCE) {
-        robot->setSpeed(0); // stop
-      } else {
-        robot->setSpeed(VEL); // cruise
+    }
+  }
+
+#ifdef ENABLE_LASER
+  if (tracker.valid()) {
+    const ScanCircles & circles = robot->getLaserBalls();
+    int best = -1;
+    double bestGate = tracker.gateThreshold();
+    for (int i=0; i<circles.size(); i++) {
+      const double g = tracker.gate(circles[i].bearing, circles[i].dist);
+      if (g < bestGate) {
+        bestGate = g;
+        best = i;
       }
-      newGoalFlag = true; // Mark as new goal angle
+    }
+    if (best >= 0) {
+      tracker.update(circles[best].bearing, circles[best].dist,
+          dtor(LBALL_STD_YAW), LBALL_STD_DIST);
 #ifdef DEBUG_CAM //{{{
-      std::cout << "BALL FOUND at angle/time:\t"
-        << goalAngle << "\t"
-        << curTimeSec << std::endl;
+      std::cout << "LASER BALL at angle/dist:\t"
+        << circles[best].bearing << "\t"
+        << circles[best].dist << std::endl;
 #endif //}}}
     }
-  } else { // else estimate to old goal position
-    std::cout << "Not yet ball request" << std::endl;
   }
+#endif
 
-  // Calculate track turnrate always except when not tracking the goal
-  if (vl_turnrate != TRACKING_NO) {
-    vl_turnrate = limit(approxTurnrate(curOrientation, goalAngle, &newGoalFlag),
-        -dtor(TRACK_ROT), dtor(TRACK_ROT));
+  assert( curTimeSec >= lastFound );
+  if (curTimeSec-lastFound > BALLTIMEOUT) { // When beyond the time out
+    if (tracker.valid()) {
+#ifdef DEBUG_CAM //{{{
+      std::cout << "  BALLTRACKING TIMEOUT (sec)\t" << BALLTIMEOUT << std::endl;
+#endif //}}}
+      tracker.reset();
+    }
+  } else if (tracker.valid()) {
+    // Head to the estimated bearing
+    if (fabs(tracker.bearing()) < dtor(YAW_TOLERANCE)) {
+      vl_turnrate = 0;
+    } else {
+      vl_turnrate = limit(TRACK_GAIN * tracker.bearing(),
+          -dtor(TRACK_ROT), dtor(TRACK_ROT));
+    }
+    if (tracker.dist() < DIST_TOLERANCE) {
+      robot->setSpeed(0); // stop
+    } else {
+      robot->setSpeed(VEL); // cruise
+    }
+#ifdef DEBUG_CAM/*{{{*/
+    std::cout << "Tracked bearing/dist/bearing std/dist std:\t"
+      << rtod(tracker.bearing()) << "\t"
+      << tracker.dist() << "\t"
+      << rtod(sqrt(tracker.bearingVar())) << "\t"
+      << sqrt(tracker.distVar()) << std::endl;
+#endif/*}}}*/
   }
-  robPrevTurnrate = vl_turnrate; // Remember turnrate for next cycle
-  // Give the robot a new target, '0' for doing default task
+
+  // Give the robot a new target, TRACKING_NO for doing default task
   robot->setTurnrate(vl_turnrate);
 #ifdef DEBUG_CAM //{{{
   std::cout << "SET TURNRATE: " << vl_turnrate << std::endl;
@@ -650,13 +1228,18 @@ int main ( void ) {
     std::cout.precision(2);
 
 #ifdef OPENCV //{{{
-    c1394.initFocus();
     fb.Init(width,height);
+    {
+      int cx, cy, rmin, rmax;
+      fb.Annulus(&cx, &cy, &rmin, &rmax);
+      c1394.initFocus(cx, cy, rmin, rmax);
+      cd.Init(width, height, cx, cy, rmin, rmax);
+    }
 #endif //}}}
 
     while (true) {
       r0.go();
-#ifdef OPENCV //{{{
+#if defined OPENCV || defined BLOBFINDER //{{{
       trackBall(&r0); ///< Let the robot trace the ball if any
 #endif //}}}
     }